@@ -1,80 +1,145 @@
 #include "entity.hpp"
 #include <vector>
-
-Entity::Entity(const std::string& objModel) {
+#include <algorithm>
+#include <r2tk/r2-exception.hpp>
+
+// The largest screen space error, in pixels, a level of detail may have to be selected
+static const float LOD_PIXEL_ERROR = 1.0f;
+// A coarser level than the current one has to be this much below the threshold, so levels don't flicker at the boundary
+static const float LOD_HYSTERESIS = 0.25f;
+
+Entity::Entity(const std::string& objModel, TextureUnits& textureUnits, TextureLoader* textureLoader, const ShaderDefines& defines)
+	: m_bindless(GLExtensions::hasBindlessTexture())
+	, m_atlas(NULL)
+	, m_atlasRegion(0)
+	, m_lodLevel(0) {
 	// load the mesh
-    m_mesh = Mesh::loadOBJ(objModel);
+    m_mesh = Mesh::load(objModel);
     m_materialLibrary = Material::loadMTL("resources/meshes/" + m_mesh->m_mtlLibrary);
 
-	// load the shaders
-    std::vector<std::shared_ptr<Shader> > shaders;
-
-    shaders.push_back(Shader::loadShader("resources/shaders/basic.vs", GL_VERTEX_SHADER));
-    shaders.push_back(Shader::loadShader("resources/shaders/basic.fs", GL_FRAGMENT_SHADER));
-
-    m_program = std::shared_ptr<Program>(new Program(shaders));
+	// load the shaders, every entity shares the same permutation
+	ShaderDefines permutation = defines;
+	if (m_bindless)
+		permutation["BINDLESS"] = "";
+    m_program = ProgramCache::load("resources/shaders/basic.vs", "resources/shaders/basic.fs", permutation);
+
+	// the camera and lights come from the Frame block, the transforms from the Object block
+	m_program->bindUniformBlock("Frame", UNIFORM_BINDING_FRAME);
+	m_program->bindUniformBlock("Object", UNIFORM_BINDING_OBJECT);
+	setLightGridUnits(*m_program);
+
+	ShaderDefines depthPermutation = defines;
+	depthPermutation["DEPTH_ONLY"] = "";
+	m_depthProgram = ProgramCache::load("resources/shaders/basic.vs", "resources/shaders/depth.fs", depthPermutation);
+	m_depthProgram->bindUniformBlock("Frame", UNIFORM_BINDING_FRAME);
+	m_depthProgram->bindUniformBlock("Object", UNIFORM_BINDING_OBJECT);
+
+	// load the texture, it is bound to its unit when the entity is drawn, or passed by handle in the Object block if bindless
+    m_textureFile = "resources/textures/" + m_materialLibrary[m_mesh->m_groups["default"]->m_material].m_mapKd;
+    m_texture = textureLoader ? textureLoader->load(m_textureFile) : Texture::loadTexture(m_textureFile);
+
+    // the material samples only its diffuse map, so it gets the first unit; further maps would take the next ones
+    textureUnits.reset();
+    m_textureUnit = textureUnits.allocate();
+    m_sampler = SamplerCache::get(SamplerState::createTrilinear());
+
+    // set once the program has linked, so creating entities doesn't wait for the driver
+    m_program->setSamplerUnit("Texture", m_textureUnit);
+}
 
-	// load and bind the texture
-    m_texture = Texture::loadTexture("resources/textures/" + m_materialLibrary[m_mesh->m_groups["default"]->m_material].m_mapKd);
+void Entity::setModelMatrix(const glm::mat4& modelMatrix) {
+	m_modelMatrix = modelMatrix;
+}
 
-    {
-        glUseProgramState programBinding(m_program->getId());
+void Entity::setAtlas(const TextureAtlas& atlas, GLuint textureUnit, GLuint sampler) {
+	int region = atlas.find(m_textureFile);
+	if (region < 0)
+		throw r2ExceptionArgumentM("The entity's texture isn't in the atlas: " + m_textureFile);
 
-        GLint samplerUniform = GLCheck(glGetUniformLocation(m_program->getId(), "Texture"));
-        GLCheck(glUniform1i(samplerUniform, m_texture->getUnitId()));
-        GLCheck(glActiveTexture(GL_TEXTURE0 + m_texture->getUnitId()));
-        GLCheck(glBindTexture(GL_TEXTURE_2D, m_texture->getId()));
+	m_atlas = &atlas;
+	m_atlasRegion = region;
+	m_atlasUnit = textureUnit;
+	m_atlasSampler = sampler;
+}
 
-        GLCheck(glSamplerParameteri(m_texture->getSamplerId(), GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        GLCheck(glSamplerParameteri(m_texture->getSamplerId(), GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
-        GLCheck(glGenerateMipmap(GL_TEXTURE_2D));
-        GLCheck(glSamplerParameteri(m_texture->getSamplerId(), GL_TEXTURE_WRAP_S, GL_REPEAT));
-        GLCheck(glSamplerParameteri(m_texture->getSamplerId(), GL_TEXTURE_WRAP_T, GL_REPEAT));
-        GLCheck(glBindSampler(m_texture->getUnitId(), m_texture->getSamplerId()));
-    }
+size_t Entity::selectLod(const Mesh::Group& group, const Camera& camera, const glm::mat4& modelMatrix, size_t currentLevel) {
+	if (camera.getViewportHeight() <= 0 || group.m_lods.empty())
+		return 0;
+
+	// object space units to pixels at the distance of the group's center; the sphere radius carries the largest scale of the model matrix
+	BoundingSphere bounds = group.m_boundingSphere.transform(modelMatrix);
+	float scale = (group.m_boundingSphere.m_radius > 0.0f) ? bounds.m_radius / group.m_boundingSphere.m_radius : 1.0f;
+	float distance = std::max(glm::length(bounds.m_center - camera.getPosition()), 1e-3f);
+	float pixelsPerUnit = scale * camera.getProjection()[1][1] * 0.5f * camera.getViewportHeight() / distance;
+
+	size_t level = 0;
+	for (size_t i = 1; i < group.m_lods.size(); ++i) {
+		float threshold = (i > currentLevel) ? LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS) : LOD_PIXEL_ERROR;
+		if (group.m_lods[i].m_error * pixelsPerUnit > threshold)
+			break;
+		level = i;
+	}
+
+	return level;
 }
 
-void Entity::setModelMatrix(const glm::mat4& modelMatrix) {
-	m_modelMatrix = modelMatrix;
+BoundingSphere Entity::getWorldBounds() const {
+	return m_mesh->m_boundingSphere.transform(m_modelMatrix);
 }
 
-void Entity::render(const Camera& camera, const PointLight& pointLight, const glm::vec3& ambientLightIntensity) {
-	glUseProgramState programBinding(m_program->getId());
+AABB Entity::getWorldBox() const {
+	return m_mesh->m_bounds.transform(m_modelMatrix);
+}
 
-	// activate the texture unit, bind the texture and bind the sampler
-	GLCheck(glActiveTexture(GL_TEXTURE0 + m_texture->getUnitId()));
-	GLCheck(glBindTexture(GL_TEXTURE_2D, m_texture->getId()));
-	GLCheck(glBindSampler(m_texture->getUnitId(), m_texture->getSamplerId()));
+void Entity::submit(const Camera& camera, DrawList& drawList) {
+    const Mesh::Group& group = *m_mesh->m_groups["default"];
+	m_lodLevel = selectLod(group, camera, m_modelMatrix, m_lodLevel);
 
 	// create the matrices we need
-	const glm::mat4& view = camera.getView();
-    const glm::mat4& projection = camera.getProjection();
-
-	glm::mat4 viewWorld = view * m_modelMatrix;
+	glm::mat4 viewWorld = camera.getView() * m_modelMatrix;
 	glm::mat3 normalViewWorld = glm::transpose(glm::inverse(glm::mat3(viewWorld)));
-	glm::mat3 normalView = glm::transpose(glm::inverse(glm::mat3(view)));
-
-	// pass the matrices to the shader
-    GLint projectionUniform = GLCheck(glGetUniformLocation(m_program->getId(), "g_Projection"));
-    GLint viewWorldUniform = GLCheck(glGetUniformLocation(m_program->getId(), "g_ViewWorld"));
-    GLint normalViewWorldUniform = GLCheck(glGetUniformLocation(m_program->getId(), "g_NormalViewWorld"));
-        
-    GLCheck(glUniformMatrix4fv(projectionUniform, 1, GL_FALSE, &projection[0][0]));
-    GLCheck(glUniformMatrix4fv(viewWorldUniform, 1, GL_FALSE, &viewWorld[0][0]));
-    GLCheck(glUniformMatrix3fv(normalViewWorldUniform, 1, GL_FALSE, &normalViewWorld[0][0]));
-
-	// transform the point light position to view space and pass the light attributes to the shader
-	glm::vec4 lightPositionV = view * pointLight.m_position;
-
-	GLint ambientIntensityUniform = GLCheck(glGetUniformLocation(m_program->getId(), "g_AmbientIntensity"));
-    GLint directionalIntensityUniform = GLCheck(glGetUniformLocation(m_program->getId(), "g_LightIntensity"));
-	GLint lightPositionUniform = GLCheck(glGetUniformLocation(m_program->getId(), "g_LightPositionV"));
-
-	GLCheck(glUniform3fv(ambientIntensityUniform, 1, &ambientLightIntensity[0]));
-	GLCheck(glUniform3fv(directionalIntensityUniform, 1, &pointLight.m_intensity[0]));
-	GLCheck(glUniform4fv(lightPositionUniform, 1, &lightPositionV[0]));
-
-	// render the mesh
-    glBindVertexArrayState vaoBinding(m_mesh->m_groups["default"]->m_VAO.getId());
-    GLCheck(glDrawArrays(GL_TRIANGLES, 0, m_mesh->m_groups["default"]->m_vertexCount));
+
+	ObjectUniforms block;
+	block.m_viewWorld = viewWorld;
+	for (int i = 0; i < 3; ++i) {
+		block.m_normalViewWorld[i] = glm::vec4(normalViewWorld[i], 0.0f);
+	}
+	block.m_textureHandle = m_bindless ? m_texture->getBindlessHandle(m_sampler) : 0;
+	block.m_padding = 0;
+
+	// bindless draws bind no texture, so they only sort by program and vertex array
+	GLuint texture = m_bindless ? 0 : m_texture->getId();
+
+	// sort by state first, then by the depth of the group's center
+	glm::vec4 centerC = camera.getProjectionView() * m_modelMatrix * glm::vec4(group.m_boundingSphere.m_center, 1.0f);
+	float depth = (centerC.w > 0.0f) ? centerC.z / centerC.w * 0.5f + 0.5f : 0.0f;
+
+    const Mesh::Group::Lod& lod = group.m_lods[m_lodLevel];
+
+	DrawPacket packet;
+	packet.m_key = RenderQueue::makeKey(0, m_program->getId(), texture, group.m_VAO.getId(), depth);
+	packet.m_program = m_program->getId();
+	packet.m_depthProgram = m_depthProgram->getId();
+	packet.m_vertexArray = group.m_VAO.getId();
+	packet.m_texture = texture;
+	packet.m_textureUnit = m_textureUnit;
+	packet.m_sampler = m_sampler;
+	packet.m_indexType = group.m_indexType;
+	packet.m_indexCount = lod.m_indexCount;
+	packet.m_indexOffset = lod.m_indexOffset * group.getIndexSize();
+	packet.m_instanceCount = 1;
+	packet.m_uniformOffset = drawList.pushUniforms(block);
+	packet.m_uniformSize = sizeof(ObjectUniforms);
+
+	drawList.submit(packet);
+}
+
+void Entity::submit(const Camera& camera, MultiDraw& multiDraw) {
+	if (m_atlas == NULL)
+		throw r2ExceptionRuntimeM("Multi-draws sample an atlas, which the entity hasn't been given");
+
+    const Mesh::Group& group = *m_mesh->m_groups["default"];
+	m_lodLevel = selectLod(group, camera, m_modelMatrix, m_lodLevel);
+
+	multiDraw.add(group, m_lodLevel, m_modelMatrix, *m_atlas, m_atlasRegion, m_atlasUnit, m_atlasSampler);
 }
\ No newline at end of file
@@ -4,27 +4,73 @@
 #include <memory>
 #include <map>
 #include <util\util.hpp>
+#include "uniforms.hpp"
 
 /** Holds the data describing a point light */
 struct PointLight {
 	glm::vec4 m_position;
 	glm::vec3 m_intensity;
+	float m_radius;         // Where the light ends, when drawn through the light grid
 };
 
 /** Manages an entity in the 3D scene */
 class Entity {
 public:
-	Entity(const std::string& objModel);
+	/**
+	 * The texture is loaded in the background if a loader is given. It is sampled bindless if the context supports it,
+	 * otherwise from a unit handed out by the texture units, which are reset for the entity's material.
+	 * The defines select the shader permutation, such as CLUSTERED for the light grid.
+	 */
+	Entity(const std::string& objModel, TextureUnits& textureUnits, TextureLoader* textureLoader = NULL, const ShaderDefines& defines = ShaderDefines());
 
 	void setModelMatrix(const glm::mat4& modelMatrix);
-	void render(const Camera& camera, const PointLight& pointLight, const glm::vec3& ambientLightIntensity);
+
+	/** Sample the entity's texture out of an atlas, bound to the unit, when drawn by a multi-draw. The atlas must outlive the entity. */
+	void setAtlas(const TextureAtlas& atlas, GLuint textureUnit, GLuint sampler);
+
+	/** The bounding sphere of the mesh, transformed by the model matrix */
+	BoundingSphere getWorldBounds() const;
+
+	/** The bounding box of the mesh, transformed by the model matrix */
+	AABB getWorldBox() const;
+
+	/**
+	 * Select the level of detail and submit a draw packet, with the per-object uniforms, to the list.
+	 * Must run on the context thread, since resolving the programs and the bindless handle calls GL.
+	 */
+	void submit(const Camera& camera, DrawList& drawList);
+
+	/** Select the level of detail and queue the entity for a multi-draw, which culls it on the GPU. Needs an atlas. */
+	void submit(const Camera& camera, MultiDraw& multiDraw);
+
+	const std::shared_ptr<Mesh>& getMesh() const { return m_mesh; }
+	const std::string& getTextureFile() const { return m_textureFile; }
+	bool isBindless() const { return m_bindless; }
+
+	/**
+	 * Pick the coarsest level of detail of the group, drawn with the model matrix, whose error projects to less
+	 * than a pixel. Levels coarser than the current one need some margin, so the choice doesn't flicker.
+	 */
+	static size_t selectLod(const Mesh::Group& group, const Camera& camera, const glm::mat4& modelMatrix, size_t currentLevel);
 private:
 	std::shared_ptr<Program> m_program;
+	std::shared_ptr<Program> m_depthProgram;    // Position only, for the render queue's depth prepass
+
+	std::string m_textureFile;
 	std::shared_ptr<Texture> m_texture;
+	GLuint m_textureUnit;
+	GLuint m_sampler;       // Shared through the SamplerCache
+	bool m_bindless;
+
+	const TextureAtlas* m_atlas;
+	size_t m_atlasRegion;
+	GLuint m_atlasUnit;
+	GLuint m_atlasSampler;
 	std::shared_ptr<Mesh> m_mesh;
 	std::map<std::string, Material> m_materialLibrary;
 
 	glm::mat4 m_modelMatrix;
+	size_t m_lodLevel;
 };
 
 #endif
\ No newline at end of file
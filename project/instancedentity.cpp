@@ -0,0 +1,137 @@
+#include "instancedentity.hpp"
+#include "entity.hpp"
+#include <algorithm>
+#include <cstring>
+
+InstancedEntity::InstancedEntity(const std::string& objModel, TextureUnits& textureUnits, TextureLoader* textureLoader, const ShaderDefines& defines) {
+	// load the mesh
+	m_mesh = Mesh::load(objModel);
+	m_materialLibrary = Material::loadMTL("resources/meshes/" + m_mesh->m_mtlLibrary);
+
+	// load the shaders, the transforms come from the instance buffer instead of the Object block
+	ShaderDefines permutation = defines;
+	permutation["INSTANCED"] = "";
+	m_program = ProgramCache::load("resources/shaders/basic.vs", "resources/shaders/basic.fs", permutation);
+	m_program->bindUniformBlock("Frame", UNIFORM_BINDING_FRAME);
+	setLightGridUnits(*m_program);
+
+	permutation["DEPTH_ONLY"] = "";
+	m_depthProgram = ProgramCache::load("resources/shaders/basic.vs", "resources/shaders/depth.fs", permutation);
+	m_depthProgram->bindUniformBlock("Frame", UNIFORM_BINDING_FRAME);
+
+	// load the texture, it is bound to its unit when the instances are drawn
+	std::string textureFile = "resources/textures/" + m_materialLibrary[m_mesh->m_groups["default"]->m_material].m_mapKd;
+	m_texture = textureLoader ? textureLoader->load(textureFile) : Texture::loadTexture(textureFile);
+
+	// the first unit, as for Entity, since the material samples only its diffuse map
+	textureUnits.reset();
+	m_textureUnit = textureUnits.allocate();
+	m_sampler = SamplerCache::get(SamplerState::createTrilinear());
+
+	m_program->setSamplerUnit("Texture", m_textureUnit);
+
+	// every level of detail gets its own vertex array, since the instances of each are in a different place every frame
+	const Mesh::Group& group = *m_mesh->m_groups["default"];
+	for (size_t i = 0; i < std::max<size_t>(group.m_lods.size(), 1); ++i) {
+		std::unique_ptr<Level> level(new Level);
+
+		glBindVertexArrayState vaoState(level->m_VAO.getId());
+
+		{
+			glBindBufferState vboState(GL_ARRAY_BUFFER, group.m_vertices.getId());
+			group.m_format.setupAttributes();
+		}
+
+		glBindBufferState iboState(GL_ELEMENT_ARRAY_BUFFER, group.m_indices.getId());
+
+		m_levels.push_back(std::move(level));
+	}
+}
+
+size_t InstancedEntity::addInstance(const glm::mat4& modelMatrix) {
+	m_instances.push_back(modelMatrix);
+	m_lodLevels.push_back(0);
+
+	return m_instances.size() - 1;
+}
+
+void InstancedEntity::setInstanceMatrix(size_t index, const glm::mat4& modelMatrix) {
+	m_instances[index] = modelMatrix;
+}
+
+void InstancedEntity::clearInstances() {
+	m_instances.clear();
+	m_lodLevels.clear();
+}
+
+CullStats InstancedEntity::submit(const Camera& camera, DrawList& drawList, StreamBuffer& stream) {
+	const Mesh::Group& group = *m_mesh->m_groups["default"];
+
+	// cull all instances at once
+	m_culler.clear();
+	for (size_t i = 0; i < m_instances.size(); ++i) {
+		m_culler.add(group.m_boundingSphere.transform(m_instances[i]));
+	}
+	CullStats stats = m_culler.cull(camera.getFrustum());
+
+	// compact the visible instances into their levels of detail
+	for (size_t l = 0; l < m_levels.size(); ++l) {
+		m_levels[l]->m_visible.clear();
+		m_levels[l]->m_nearestDepth = 1.0f;
+	}
+
+	for (size_t i = 0; i < m_instances.size(); ++i) {
+		if (!m_culler.isVisible(i))
+			continue;
+
+		m_lodLevels[i] = Entity::selectLod(group, camera, m_instances[i], m_lodLevels[i]);
+		Level& level = *m_levels[m_lodLevels[i]];
+		level.m_visible.push_back(m_instances[i]);
+
+		// a level sorts by its nearest instance, like an entity by its center
+		glm::vec4 centerC = camera.getProjectionView() * m_instances[i] * glm::vec4(group.m_boundingSphere.m_center, 1.0f);
+		float depth = (centerC.w > 0.0f) ? centerC.z / centerC.w * 0.5f + 0.5f : 0.0f;
+		level.m_nearestDepth = std::min(level.m_nearestDepth, depth);
+	}
+
+	// one instanced draw per level in use
+	for (size_t l = 0; l < m_levels.size(); ++l) {
+		Level& level = *m_levels[l];
+		if (level.m_visible.empty())
+			continue;
+
+		upload(level, stream);
+
+		size_t indexOffset = group.m_lods.empty() ? 0 : group.m_lods[l].m_indexOffset;
+		size_t indexCount = group.m_lods.empty() ? group.m_indexCount : group.m_lods[l].m_indexCount;
+
+		DrawPacket packet;
+		packet.m_key = RenderQueue::makeKey(0, m_program->getId(), m_texture->getId(), level.m_VAO.getId(), level.m_nearestDepth);
+		packet.m_program = m_program->getId();
+		packet.m_depthProgram = m_depthProgram->getId();
+		packet.m_vertexArray = level.m_VAO.getId();
+		packet.m_texture = m_texture->getId();
+		packet.m_textureUnit = m_textureUnit;
+		packet.m_sampler = m_sampler;
+		packet.m_indexType = group.m_indexType;
+		packet.m_indexCount = indexCount;
+		packet.m_indexOffset = indexOffset * group.getIndexSize();
+		packet.m_instanceCount = level.m_visible.size();
+		packet.m_uniformOffset = 0;
+		packet.m_uniformSize = 0;
+
+		drawList.submit(packet);
+	}
+
+	return stats;
+}
+
+void InstancedEntity::upload(Level& level, StreamBuffer& stream) {
+	size_t size = level.m_visible.size() * sizeof(glm::mat4);
+	StreamBuffer::Allocation allocation = stream.allocate(size);
+	memcpy(allocation.m_data, &level.m_visible[0], size);
+
+	glBindVertexArrayState vaoState(level.m_VAO.getId());
+	glBindBufferState bufferState(GL_ARRAY_BUFFER, allocation.m_buffer);
+	VertexFormat::setupInstanceMatrix(allocation.m_offset);
+}
@@ -0,0 +1,58 @@
+#ifndef INSTANCEDENTITY_HPP
+#define INSTANCEDENTITY_HPP
+
+#include <memory>
+#include <map>
+#include <vector>
+#include <util\util.hpp>
+#include "uniforms.hpp"
+
+/**
+ * Many copies of one mesh with one material, drawn with a single instanced draw per level of detail.
+ * The instances are culled and sorted into levels on the CPU every frame, and only the visible
+ * transforms are written to a stream buffer. Instances may not be scaled non-uniformly.
+ */
+class InstancedEntity {
+public:
+	/** The texture is loaded in the background if a loader is given. Its unit and the defines are chosen as for Entity. */
+	InstancedEntity(const std::string& objModel, TextureUnits& textureUnits, TextureLoader* textureLoader = NULL, const ShaderDefines& defines = ShaderDefines());
+
+	/** Add an instance and return its index */
+	size_t addInstance(const glm::mat4& modelMatrix);
+	void setInstanceMatrix(size_t index, const glm::mat4& modelMatrix);
+	void clearInstances();
+
+	size_t getInstanceCount() const { return m_instances.size(); }
+
+	/**
+	 * Cull the instances, write the visible ones to the stream buffer and submit a draw packet per level of detail
+	 * in use. The stream buffer has to be flushed before the packets are drawn. Must run on the context thread.
+	 */
+	CullStats submit(const Camera& camera, DrawList& drawList, StreamBuffer& stream);
+private:
+	/** The visible instances drawn at one level of detail */
+	struct Level {
+		std::vector<glm::mat4> m_visible;
+		float m_nearestDepth;  // Of the visible instances, 0 to 1, for sorting front to back
+		VAO m_VAO;             // The mesh's vertices and indices, plus this frame's instances
+	};
+
+	std::shared_ptr<Program> m_program;
+	std::shared_ptr<Program> m_depthProgram;    // Position only, for the render queue's depth prepass
+
+	std::shared_ptr<Texture> m_texture;
+	GLuint m_textureUnit;
+	GLuint m_sampler;       // Shared through the SamplerCache
+	std::shared_ptr<Mesh> m_mesh;
+	std::map<std::string, Material> m_materialLibrary;
+
+	std::vector<glm::mat4> m_instances;
+	std::vector<size_t> m_lodLevels;
+	std::vector<std::unique_ptr<Level> > m_levels;
+	SphereCuller m_culler;
+
+	/** Write the visible instances of the level to the stream buffer and point the vertex array at them */
+	void upload(Level& level, StreamBuffer& stream);
+};
+
+#endif
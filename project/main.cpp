@@ -6,9 +6,15 @@
 #include <fstream>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <set>
 #include <r2tk\r2-data-types.hpp>
 #include "sound.hpp"
 #include "entity.hpp"
+#include "scene.hpp"
+#include "instancedentity.hpp"
 
 class Lab : public LabTemplate {
 public:
@@ -18,18 +24,62 @@ public:
     void onUpdate(float dt, const InputState& currentInput, const InputState& previousInput);
     void onRender(float dt, float interpolation);
     void onResize(int width, int height);
+    void onKey(int key, int action);
 private:
+	// decodes textures in the background; the loader uploads them a few at a time in onRender
+	ThreadPool m_threadPool;
+	TextureLoader m_textureLoader;
+
+	// hands out the texture units of each material and of the multi-draw, reset for every one of them, so the
+	// textures of one draw get distinct units; every material samples a single texture yet, which lands on unit 0
+	// only units below the light grid's are handed out, since those stay bound for the whole frame
+	TextureUnits m_textureUnits;
+
 	Listener m_listener;
 	std::shared_ptr<WAVHandle> m_sound;
 	std::shared_ptr<SoundSource> m_source;
 
+	// the key light and a number of small colored ones circling the scene, cycled through LIGHT_COUNTS with L
+	// all of them are binned into the light grid every frame and the CLUSTERED programs loop over those of their cluster
 	PointLight m_pointLight;
 	glm::vec3 m_ambientLight;
-
-	std::shared_ptr<Entity> m_planeEntity;
+	std::vector<PointLight> m_lights;
+	size_t m_lightCountIndex;
+	float m_lightOrbit;
+	LightGrid m_lightGrid;
+	ShaderDefines m_lightingDefines;
+
+	Scene m_scene;
+	std::vector<Scene::Handle> m_visibleEntities;
+	CullStats m_cullStats;
+	GLState::Stats m_stateStats;
+
+	// the Frame block is rewritten once per frame; the Object blocks, instances and debug lines are written to the stream buffer
+	VBO m_frameUniforms;
+	StreamBuffer m_streamBuffer;
+	UniformRing m_objectUniforms;
+	RenderQueue m_renderQueue;
+	size_t m_depthMode;             // How the queue orders and draws, cycled through DEPTH_MODE_COUNT with Z
+	GLint m_samplesPerPixel;        // Of the framebuffer, to turn sample counts into overdraw
+	DebugDraw m_debugDraw;
+	bool m_drawBounds;
+
+	// with GL 4.3 the scene is culled on the GPU and drawn out of a mesh pool with a few multi-draws, toggled with M
+	// the entities' textures are packed into one atlas for it, so every entity can share a draw; its sources are
+	// decoded on the thread pool and the multi-draw is finished once they are all in
+	std::unique_ptr<MeshPool> m_meshPool;
+	std::vector<std::pair<std::string, std::future<Texture::Image> > > m_atlasSources;
+	std::unique_ptr<TextureAtlas> m_atlas;
+	std::unique_ptr<MultiDraw> m_multiDraw;
+	std::shared_ptr<Program> m_multiDrawProgram;
+	std::unique_ptr<Uniform<GLint> > m_multiDrawTexture;
+	std::vector<std::pair<float, Scene::Handle> > m_multiDrawOrder;    // View depth and entity, sorted for front to back
+	bool m_useMultiDraw;            // Never with the depth prepass, which needs the entities in the render queue
+
+	Scene::Handle m_planeEntity;
 	glm::mat4 m_planeModelMatrix;
 
-	std::shared_ptr<Entity> m_boxEntity;
+	Scene::Handle m_boxEntity;
 	float m_boxModelOrientation;
 	glm::mat4 m_boxModelMatrix;
 
@@ -37,8 +87,42 @@ private:
     glm::vec3 m_cameraPosition;
     Camera m_camera;
 
+	// a grid of crates drawn instanced, cycled through INSTANCE_COUNTS with I
+	std::unique_ptr<InstancedEntity> m_crates;
+	size_t m_crateCountIndex;
+	CullStats m_crateCullStats;
+
+	// the CPU time spent in onRender, averaged over FRAME_TIME_SAMPLES frames
+	double m_frameTimeAccumulator;
+	size_t m_frameTimeSamples;
+	double m_frameTime;
+	size_t m_glCalls;       // Per frame, only counted with UTIL_GL_PROFILE
+	double m_binTimeAccumulator;
+	double m_binTime;       // Light grid binning and upload, averaged like the frame time
+
 	glm::vec3 getCameraOrientation(float orientation) const;
+	void setCrateCount(size_t count);
+	void setLightCount(size_t count);
+	void setDepthMode(size_t mode);
+	void createMultiDraw();
+	void finishMultiDraw();
+};
+
+static const size_t INSTANCE_COUNTS[] = { 0, 100, 1000, 10000 };
+static const size_t INSTANCE_COUNT_COUNT = sizeof(INSTANCE_COUNTS) / sizeof(INSTANCE_COUNTS[0]);
+enum DepthMode {
+	DEPTH_MODE_STATE = 0,
+	DEPTH_MODE_FRONT_TO_BACK,
+	DEPTH_MODE_PREPASS,
+	DEPTH_MODE_COUNT
 };
+static const char* DEPTH_MODE_NAMES[] = { "sorted by state", "front to back", "front to back after a depth prepass" };
+
+static const size_t LIGHT_COUNTS[] = { 1, 64, 1024, 4096 };
+static const size_t LIGHT_COUNT_COUNT = sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0]);
+static const size_t FRAME_TIME_SAMPLES = 60;
+
+typedef std::chrono::high_resolution_clock Clock;
 
 int main(int argc, char* argv[]) {
     try {
@@ -67,9 +151,26 @@ int main(int argc, char* argv[]) {
 
 
 Lab::Lab()
-    : m_cameraOrientation(-M_PI * 0.5f)
+    : m_textureLoader(m_threadPool)
+	, m_textureUnits(TEXTURE_BINDING_LIGHTS)
+	, m_lightCountIndex(0)
+	, m_lightOrbit(0.0f)
+	, m_objectUniforms(m_streamBuffer)
+	, m_depthMode(DEPTH_MODE_FRONT_TO_BACK)
+	, m_samplesPerPixel(1)
+	, m_debugDraw(m_streamBuffer)
+	, m_drawBounds(false)
+	, m_useMultiDraw(false)
+	, m_boxModelOrientation(0.0f)
+	, m_cameraOrientation(-M_PI * 0.5f)
 	, m_cameraPosition(0.0f, 0.0f, 10.0f)
-	, m_boxModelOrientation(0.0f) {
+	, m_crateCountIndex(0)
+	, m_frameTimeAccumulator(0.0)
+	, m_frameTimeSamples(0)
+	, m_frameTime(0.0)
+	, m_glCalls(0)
+	, m_binTimeAccumulator(0.0)
+	, m_binTime(0.0) {
 
     // set state
     GLCheck(glEnable(GL_DEPTH_TEST));
@@ -78,19 +179,37 @@ Lab::Lab()
     GLCheck(glCullFace(GL_BACK));
     GLCheck(glFrontFace(GL_CCW));
 
-	// load entities
+	GLCheck(glGetIntegerv(GL_SAMPLES, &m_samplesPerPixel));
+	m_samplesPerPixel = std::max(m_samplesPerPixel, 1);
+	setDepthMode(m_depthMode);
+
+	// load entities, lit through the light grid
+	m_lightingDefines["CLUSTERED"] = "";
 	m_planeModelMatrix = glm::mat4(1, 0, 0, 0,
 								   0, 1, 0, 0,
 								   0, 0, 1, 0,
 								   0, -3, 0, 1);
-	m_planeEntity = std::shared_ptr<Entity>(new Entity("resources/meshes/cobblestone-plane.obj"));
-	m_planeEntity->setModelMatrix(m_planeModelMatrix);
-	m_boxEntity = std::shared_ptr<Entity>(new Entity("resources/meshes/crate.obj"));
+	std::shared_ptr<Entity> planeEntity(new Entity("resources/meshes/cobblestone-plane.obj", m_textureUnits, &m_textureLoader, m_lightingDefines));
+	planeEntity->setModelMatrix(m_planeModelMatrix);
+	m_planeEntity = m_scene.add(planeEntity);
+	m_boxEntity = m_scene.add(std::shared_ptr<Entity>(new Entity("resources/meshes/crate.obj", m_textureUnits, &m_textureLoader, m_lightingDefines)));
+	m_crates.reset(new InstancedEntity("resources/meshes/crate.obj", m_textureUnits, &m_textureLoader, m_lightingDefines));
+
+	if (MultiDraw::isSupported()) {
+		createMultiDraw();
+	}
+
+	const ProgramCache::Stats& programStats = ProgramCache::getStats();
+	std::cout << "INFO: Programs: " << programStats.m_binaries << " restored from binaries, " << programStats.m_linked << " linked from "
+			  << programStats.m_compiled << " compiled shaders, " << programStats.m_shared << " shared, "
+			  << programStats.m_rejected << " stale binaries" << std::endl;
 
 	// setup the lights
 	m_pointLight.m_intensity = glm::vec3(0.8, 0.8, 0.8);
 	m_pointLight.m_position = glm::vec4(0.0f, 3.0, 6.0, 1.0);
+	m_pointLight.m_radius = 50.0f;
 	m_ambientLight = glm::vec3(0.2, 0.2, 0.2);
+	setLightCount(LIGHT_COUNTS[m_lightCountIndex]);
 
     // setup the camera
     m_camera.setUp(glm::vec3(0.0f, 1.0f, 0.0f));
@@ -153,7 +272,13 @@ void Lab::onUpdate(float dt, const InputState& currentInput, const InputState& p
 								 0,						   1, 0,						     0,
 								 -sin(m_boxModelOrientation), 0, cos(m_boxModelOrientation), 0,
 								 0,						   0, 0,						     1);
-	m_boxEntity->setModelMatrix(m_boxModelMatrix);
+	m_scene.setModelMatrix(m_boxEntity, m_boxModelMatrix);
+
+	// the small lights circle the origin, so the grid is rebinned as they cross clusters
+	m_lightOrbit += M_PI * 0.05f * dt;
+
+	// apply all of this tick's moves to the scene at once
+	m_scene.commitUpdates();
 
 	// update sound source
 	m_source->update();
@@ -168,16 +293,296 @@ glm::vec3 Lab::getCameraOrientation(float orientation) const {
 	return cameraOrientation;
 }
 
+void Lab::createMultiDraw() {
+	// the model matrices and atlas regions come in per instance. Issued first, so the driver compiles it while the atlas is built.
+	ShaderDefines defines = m_lightingDefines;
+	defines["INSTANCED"] = "";
+	defines["ATLAS"] = "";
+	m_multiDrawProgram = ProgramCache::load("resources/shaders/basic.vs", "resources/shaders/basic.fs", defines);
+	m_multiDrawProgram->bindUniformBlock("Frame", UNIFORM_BINDING_FRAME);
+	setLightGridUnits(*m_multiDrawProgram);
+
+	m_meshPool.reset(new MeshPool(VertexFormat::createCompact()));
+	for (Scene::Handle handle = 0; handle < m_scene.getHandleCount(); ++handle) {
+		if (m_scene.getEntity(handle))
+			m_meshPool->add(*m_scene.getEntity(handle)->getMesh());
+	}
+
+	// the atlas decodes the sources itself, since the baked textures are block compressed
+	std::set<std::string> sources;
+	for (Scene::Handle handle = 0; handle < m_scene.getHandleCount(); ++handle) {
+		if (m_scene.getEntity(handle) && sources.insert(m_scene.getEntity(handle)->getTextureFile()).second) {
+			std::string source = m_scene.getEntity(handle)->getTextureFile();
+			m_atlasSources.push_back(std::make_pair(source, m_threadPool.submit([source]() { return Texture::decodeImage(source); })));
+		}
+	}
+}
+
+void Lab::finishMultiDraw() {
+	for (size_t i = 0; i < m_atlasSources.size(); ++i) {
+		if (m_atlasSources[i].second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+	}
+
+	m_atlas.reset(new TextureAtlas);
+	for (size_t i = 0; i < m_atlasSources.size(); ++i) {
+		m_atlas->add(m_atlasSources[i].first, m_atlasSources[i].second.get());
+	}
+	m_atlasSources.clear();
+	m_atlas->build();
+
+	m_textureUnits.reset();
+	GLuint atlasUnit = m_textureUnits.allocate();
+	GLuint atlasSampler = SamplerCache::get(SamplerState::createTrilinear());
+	for (Scene::Handle handle = 0; handle < m_scene.getHandleCount(); ++handle) {
+		if (m_scene.getEntity(handle))
+			m_scene.getEntity(handle)->setAtlas(*m_atlas, atlasUnit, atlasSampler);
+	}
+
+	m_multiDraw.reset(new MultiDraw(*m_meshPool, m_streamBuffer));
+	m_multiDrawTexture.reset(new Uniform<GLint>(*m_multiDrawProgram, "Texture"));
+	m_useMultiDraw = (m_depthMode != DEPTH_MODE_PREPASS);
+}
+
+void Lab::setCrateCount(size_t count) {
+	// a square grid behind the plane's origin, two units apart
+	size_t side = (size_t) std::ceil(std::sqrt((float) count));
+	m_crates->clearInstances();
+	for (size_t i = 0; i < count; ++i) {
+		float x = 2.0f * ((float) (i % side) - side * 0.5f);
+		float z = -2.0f * (float) (i / side) - 10.0f;
+		m_crates->addInstance(glm::mat4(1, 0, 0, 0,
+										0, 1, 0, 0,
+										0, 0, 1, 0,
+										x, -2, z, 1));
+	}
+}
+
+void Lab::setLightCount(size_t count) {
+	// the key light first, then the same random lights every time, so the counts are comparable
+	m_lights.assign(1, m_pointLight);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> x(-40.0f, 40.0f);
+	std::uniform_real_distribution<float> y(-2.5f, 2.0f);
+	std::uniform_real_distribution<float> z(-90.0f, 20.0f);
+	std::uniform_real_distribution<float> radius(2.0f, 6.0f);
+	std::uniform_real_distribution<float> color(0.2f, 1.0f);
+	for (size_t i = 1; i < count; ++i) {
+		PointLight light;
+		light.m_position = glm::vec4(x(random), y(random), z(random), 1.0f);
+		light.m_intensity = glm::vec3(color(random), color(random), color(random));
+		light.m_radius = radius(random);
+		m_lights.push_back(light);
+	}
+
+	m_lightGrid.clear();
+	for (size_t i = 0; i < m_lights.size(); ++i) {
+		m_lightGrid.add(glm::vec3(m_lights[i].m_position), m_lights[i].m_radius, m_lights[i].m_intensity);
+	}
+}
+
+void Lab::setDepthMode(size_t mode) {
+	// front to back lets early depth testing skip most hidden fragments; the prepass skips them all, for drawing everything twice
+	m_depthMode = mode;
+	m_renderQueue.setOrder((mode == DEPTH_MODE_STATE) ? RenderQueue::ORDER_STATE : RenderQueue::ORDER_FRONT_TO_BACK);
+	m_renderQueue.setDepthPrepass(mode == DEPTH_MODE_PREPASS);
+
+	// the multi-draw has no depth pass, so the entities go back through the queue
+	if (mode == DEPTH_MODE_PREPASS && m_useMultiDraw) {
+		m_useMultiDraw = false;
+		std::cout << "Multi-draw off, the depth prepass draws the entities through the render queue" << std::endl;
+	}
+}
+
 void Lab::onRender(float dt, float interpolation) {
+	Clock::time_point frameStart = Clock::now();
+
+	// textures that finished decoding replace their placeholders, and the multi-draw starts once its atlas is in
+	m_textureLoader.update();
+	if (m_meshPool && !m_multiDraw)
+		finishMultiDraw();
+
     GLCheck(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
-	m_planeEntity->render(m_camera, m_pointLight, m_ambientLight);
-	m_boxEntity->render(m_camera, m_pointLight, m_ambientLight);
+	// cull all entities before issuing any GL calls, unless the GPU does it
+	m_visibleEntities.clear();
+	if (m_useMultiDraw) {
+		m_cullStats = CullStats();
+	} else {
+		m_cullStats = m_scene.cull(m_camera.getFrustum(), m_visibleEntities);
+	}
+
+	// upload the camera and lights once for all entities
+	FrameUniforms frame;
+	frame.m_projection = m_camera.getProjection();
+	frame.m_view = m_camera.getView();
+	frame.m_lightPositionV = m_camera.getView() * m_pointLight.m_position;
+	frame.m_lightIntensity = glm::vec4(m_pointLight.m_intensity, 0.0f);
+	frame.m_ambientIntensity = glm::vec4(m_ambientLight, 0.0f);
+
+	// move the small lights and bin every light into the clusters of the camera
+	Clock::time_point binStart = Clock::now();
+	float orbitCos = std::cos(m_lightOrbit);
+	float orbitSin = std::sin(m_lightOrbit);
+	for (size_t i = 1; i < m_lights.size(); ++i) {
+		const glm::vec4& position = m_lights[i].m_position;
+		m_lightGrid.setPosition(i, glm::vec3(orbitCos * position.x - orbitSin * position.z, position.y, orbitSin * position.x + orbitCos * position.z));
+	}
+	m_lightGrid.update(m_camera);
+	m_binTimeAccumulator += std::chrono::duration<double, std::milli>(Clock::now() - binStart).count();
+
+	m_lightGrid.bind(TEXTURE_BINDING_LIGHTS, TEXTURE_BINDING_LIGHT_CLUSTERS, TEXTURE_BINDING_LIGHT_INDICES);
+	frame.m_clusterScale = m_lightGrid.getClusterScale();
+	frame.m_clusterCount = glm::uvec4(m_lightGrid.getTilesX(), m_lightGrid.getTilesY(), m_lightGrid.getSlices(), 0);
+	{
+		glBindBufferState bufferState(GL_UNIFORM_BUFFER, m_frameUniforms.getId());
+		GLCheck(glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), &frame, GL_STREAM_DRAW));
+	}
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING_FRAME, m_frameUniforms.getId());
+
+	// with multi-draw, every entity is queued and the GPU writes the draws of the visible ones
+	// the commands keep the order they are queued in, so unless the depth mode orders by state they are queued front to back
+	if (m_useMultiDraw) {
+		m_multiDrawOrder.clear();
+		for (Scene::Handle handle = 0; handle < m_scene.getHandleCount(); ++handle) {
+			if (m_scene.getEntity(handle)) {
+				glm::vec4 centerV = m_camera.getView() * glm::vec4(m_scene.getEntity(handle)->getWorldBounds().m_center, 1.0f);
+				m_multiDrawOrder.push_back(std::make_pair(-centerV.z, handle));
+			}
+		}
+		if (m_depthMode != DEPTH_MODE_STATE)
+			std::sort(m_multiDrawOrder.begin(), m_multiDrawOrder.end());
+
+		for (size_t i = 0; i < m_multiDrawOrder.size(); ++i) {
+			m_scene.getEntity(m_multiDrawOrder[i].second)->submit(m_camera, *m_multiDraw);
+		}
+		m_multiDraw->execute(m_camera.getFrustum(), *m_multiDrawProgram, *m_multiDrawTexture);
+	}
+
+	// the visible entities submit their draws, which are then sorted by state and drawn
+	DrawList& drawList = m_renderQueue.getList(0);
+	for (size_t i = 0; i < m_visibleEntities.size(); ++i) {
+		m_scene.getEntity(m_visibleEntities[i])->submit(m_camera, drawList);
+	}
+	m_crateCullStats = m_crates->submit(m_camera, drawList, m_streamBuffer);
+	m_streamBuffer.flush();
+	m_renderQueue.execute(m_objectUniforms, UNIFORM_BINDING_OBJECT);
+
+	if (m_drawBounds) {
+		for (Scene::Handle handle = 0; handle < m_scene.getHandleCount(); ++handle) {
+			if (m_scene.getEntity(handle))
+				m_debugDraw.addAABB(m_scene.getEntity(handle)->getWorldBox(), glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		m_debugDraw.draw(m_camera.getProjectionView());
+	}
+
+	m_stateStats = GLState::getStats();
+	GLState::resetStats();
+
+#ifdef UTIL_GL_PROFILE
+	m_glCalls = GLDebug::getCallCount();
+	GLDebug::resetCallCount();
+#endif
+
+	// time the CPU side only, the swap waits for the GPU
+	m_frameTimeAccumulator += std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+	if (++m_frameTimeSamples == FRAME_TIME_SAMPLES) {
+		m_frameTime = m_frameTimeAccumulator / FRAME_TIME_SAMPLES;
+		m_frameTimeAccumulator = 0.0;
+		m_binTime = m_binTimeAccumulator / FRAME_TIME_SAMPLES;
+		m_binTimeAccumulator = 0.0;
+		m_frameTimeSamples = 0;
+	}
 
     glfwSwapBuffers();
+
+	// the GPU may still be reading this frame's region, so move on to the next
+	m_streamBuffer.endFrame();
+}
+
+void Lab::onKey(int key, int action) {
+	if (key == 'C' && action == GLFW_PRESS) {
+		std::cout << "Culling: " << m_cullStats.m_visible << "/" << m_cullStats.m_tested << " visible, "
+				  << m_cullStats.getCulled() << " culled" << std::endl;
+		const RenderQueue::Stats& queueStats = m_renderQueue.getStats();
+		std::cout << "Draws: " << queueStats.m_packets << " packets, " << queueStats.m_programChanges << " program, "
+				  << queueStats.m_textureChanges << " texture and " << queueStats.m_vertexArrayChanges << " vertex array changes" << std::endl;
+		double pixelSamples = std::max((double) m_camera.getViewportWidth() * m_camera.getViewportHeight() * m_samplesPerPixel, 1.0);
+		std::cout << "Depth: " << DEPTH_MODE_NAMES[m_depthMode] << ", " << queueStats.m_shadedSamples / pixelSamples << " samples shaded per pixel sample";
+		if (m_renderQueue.hasDepthPrepass()) {
+			std::cout << " (" << queueStats.m_prepassSamples / pixelSamples << " without the prepass, "
+					  << queueStats.m_depthPackets << " packets drawn twice)";
+		}
+		std::cout << std::endl;
+		std::cout << "State changes: " << m_stateStats.m_issued << " issued, " << m_stateStats.m_filtered << " filtered" << std::endl;
+		std::cout << "Instances: " << m_crateCullStats.m_visible << "/" << m_crateCullStats.m_tested << " visible, "
+				  << queueStats.m_instances << " drawn in " << queueStats.m_packets << " draw calls" << std::endl;
+		if (m_useMultiDraw) {
+			const MultiDraw::Stats& multiDrawStats = m_multiDraw->getStats();
+			std::cout << "Multi-draw: " << multiDrawStats.m_objects << " objects culled on the GPU, " << multiDrawStats.m_dispatches << " dispatches and "
+					  << multiDrawStats.m_drawCalls << " draw calls, " << m_atlas->getRegionCount() << " textures in "
+					  << m_atlas->getLayerCount() << " atlas layers of " << m_atlas->getLayerSize() << "x" << m_atlas->getLayerSize() << std::endl;
+		}
+		const StreamBuffer::Stats& streamStats = m_streamBuffer.getStats();
+		std::cout << "Stream buffer (" << (m_streamBuffer.isPersistent() ? "persistent" : "orphaning") << ", "
+				  << m_streamBuffer.getRegionSize() / 1024 << " KB regions): " << streamStats.m_allocated / 1024 << " KB streamed, "
+				  << streamStats.m_fenceWaits << " fence waits, " << streamStats.m_orphans << " orphans, "
+				  << streamStats.m_reallocations << " reallocations" << std::endl;
+		const TextureLoader::Stats& loaderStats = m_textureLoader.getStats();
+		std::cout << "Textures: " << loaderStats.m_pending << " loading, " << loaderStats.m_failed << " failed, "
+				  << SamplerCache::getCount() << " sampler objects, "
+				  << (GLExtensions::hasBindlessTexture() ? "bindless" : "bound to units") << std::endl;
+		const LightGrid::Stats& lightStats = m_lightGrid.getStats();
+		std::cout << "Lights: " << lightStats.m_visible << "/" << lightStats.m_lights << " visible, binned in " << m_binTime << " ms, "
+				  << (float) lightStats.m_indices / m_lightGrid.getClusterCount() << " per cluster ("
+				  << (lightStats.m_occupied ? (float) lightStats.m_indices / lightStats.m_occupied : 0.0f) << " per lit cluster, "
+				  << lightStats.m_maxPerCluster << " at most, " << lightStats.m_occupied << "/" << m_lightGrid.getClusterCount() << " clusters lit)" << std::endl;
+		std::cout << "CPU frame time: " << m_frameTime << " ms" << std::endl;
+#ifdef UTIL_GL_PROFILE
+		std::cout << "GL calls: " << m_glCalls << std::endl;
+#endif
+	}
+
+	if (key == 'B' && action == GLFW_PRESS) {
+		m_drawBounds = !m_drawBounds;
+	}
+
+	if (key == 'M' && action == GLFW_PRESS) {
+		if (m_multiDraw) {
+			m_useMultiDraw = !m_useMultiDraw;
+			std::cout << "Multi-draw " << (m_useMultiDraw ? "on" : "off") << std::endl;
+			if (m_useMultiDraw && m_depthMode == DEPTH_MODE_PREPASS) {
+				setDepthMode(DEPTH_MODE_FRONT_TO_BACK);
+				std::cout << "Depth: " << DEPTH_MODE_NAMES[m_depthMode] << ", the multi-draw has no depth prepass" << std::endl;
+			}
+		} else if (m_meshPool) {
+			std::cout << "Multi-draw is waiting for its atlas" << std::endl;
+		} else {
+			std::cout << "Multi-draw needs OpenGL 4.3" << std::endl;
+		}
+	}
+
+	if (key == 'I' && action == GLFW_PRESS) {
+		m_crateCountIndex = (m_crateCountIndex + 1) % INSTANCE_COUNT_COUNT;
+		setCrateCount(INSTANCE_COUNTS[m_crateCountIndex]);
+		std::cout << "Crates: " << INSTANCE_COUNTS[m_crateCountIndex] << std::endl;
+	}
+
+	if (key == 'Z' && action == GLFW_PRESS) {
+		setDepthMode((m_depthMode + 1) % DEPTH_MODE_COUNT);
+		std::cout << "Depth: " << DEPTH_MODE_NAMES[m_depthMode] << std::endl;
+	}
+
+	if (key == 'L' && action == GLFW_PRESS) {
+		m_lightCountIndex = (m_lightCountIndex + 1) % LIGHT_COUNT_COUNT;
+		setLightCount(LIGHT_COUNTS[m_lightCountIndex]);
+		std::cout << "Lights: " << LIGHT_COUNTS[m_lightCountIndex] << std::endl;
+	}
 }
 
 void Lab::onResize(int width, int height) {
+    m_camera.setViewport(width, height);
     m_camera.setProjection(Camera::createPerspectiveProjection(1.0f, 100.0f, M_PI * 0.25f, (float)width / height));
 }
 
@@ -1,21 +1,46 @@
 #version 400
 
+// Permutations, defined by the application:
+//   BINDLESS   The texture is a handle in the Object block, so nothing is bound between draws
+//   ATLAS      The texture is a region of an array atlas, given per instance
+//   CLUSTERED  Lit by the lights of the light grid, see lighting.glsl
+// Otherwise the texture is bound to the unit of the Texture sampler.
+
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+#include "uniforms.glsl"
+#include "lighting.glsl"
+
 in vec2 ex_TexCoord;
 in vec3 ex_NormalV;
 in vec4 ex_PositionV;
+#ifdef ATLAS
+flat in vec4 ex_TextureTransform;
+flat in uint ex_TextureLayer;
+#endif
 out vec4 out_Color;
 
+#if defined(ATLAS)
+uniform sampler2DArray Texture;
+#elif !defined(BINDLESS)
 uniform sampler2D Texture;
+#endif
 
-uniform vec4 g_LightPositionV;
-uniform vec3 g_LightIntensity;
-uniform vec3 g_AmbientIntensity;
+vec4 sampleTexture() {
+#if defined(BINDLESS)
+    return texture(sampler2D(g_TextureHandle), ex_TexCoord);
+#elif defined(ATLAS)
+    // wrap into the region; the gradients come from the unwrapped coordinates, so the mip level doesn't jump at the wrap
+    vec2 scale = ex_TextureTransform.xy;
+    vec2 texCoord = fract(ex_TexCoord) * scale + ex_TextureTransform.zw;
+    return textureGrad(Texture, vec3(texCoord, float(ex_TextureLayer)), dFdx(ex_TexCoord) * scale, dFdy(ex_TexCoord) * scale);
+#else
+    return texture(Texture, ex_TexCoord);
+#endif
+}
 
 void main(void) {
-    out_Color = texture(Texture, ex_TexCoord).rgba;
-    
-    float incidence = dot(normalize(g_LightPositionV - ex_PositionV).xyz, ex_NormalV);
-    incidence = clamp(incidence, 0, 1);
-    
-    out_Color *= vec4(g_LightIntensity * incidence + g_AmbientIntensity, 1.0f);
+    out_Color = sampleTexture() * vec4(shade(ex_PositionV, ex_NormalV), 1.0f);
 }
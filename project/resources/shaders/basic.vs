@@ -1,19 +1,54 @@
 #version 400
 
-layout(location=0) in vec4 in_PositionM;
-layout(location=1) in vec4 in_NormalM;
+// Permutations, defined by the application:
+//   INSTANCED  The world matrix comes per instance instead of from the Object block
+//   ATLAS      The texture is a region of an array atlas, given per instance
+//   DEPTH_ONLY Only the position, for the depth prepass with depth.fs
+
+#include "uniforms.glsl"
+
+// the depth prepass and the shading pass must compute the same depths, or GL_EQUAL testing drops fragments
+invariant gl_Position;
+
+layout(location=0) in vec3 in_PositionM;
+layout(location=1) in vec3 in_NormalM;
 layout(location=2) in vec2 in_TexCoord;
+#ifdef INSTANCED
+layout(location=3) in mat4 in_World;                // Per instance, occupies locations 3 to 6
+#endif
+#ifdef ATLAS
+layout(location=7) in vec4 in_TextureTransform;     // Per instance, the atlas region
+layout(location=8) in uint in_TextureLayer;
+#endif
+#ifndef DEPTH_ONLY
 out vec2 ex_TexCoord;
 out vec3 ex_NormalV;
 out vec4 ex_PositionV;
-
-uniform mat4 g_Projection;
-uniform mat4 g_ViewWorld;
-uniform mat3 g_NormalViewWorld;
+#endif
+#if defined(ATLAS) && !defined(DEPTH_ONLY)
+flat out vec4 ex_TextureTransform;
+flat out uint ex_TextureLayer;
+#endif
 
 void main(void) {
-    gl_Position = g_Projection * g_ViewWorld * in_PositionM;
+    vec4 positionM = vec4(in_PositionM, 1.0);
+#ifdef INSTANCED
+    // instances are only rotated, translated and uniformly scaled, so the normals need no inverse transpose
+    mat4 viewWorld = g_View * in_World;
+    mat3 normalViewWorld = mat3(viewWorld);
+#else
+    mat4 viewWorld = g_ViewWorld;
+    mat3 normalViewWorld = g_NormalViewWorld;
+#endif
+
+    gl_Position = g_Projection * viewWorld * positionM;
+#ifndef DEPTH_ONLY
     ex_TexCoord = in_TexCoord;
-    ex_NormalV = normalize(g_NormalViewWorld * in_NormalM.xyz);
-    ex_PositionV = g_ViewWorld * in_PositionM;
+    ex_NormalV = normalize(normalViewWorld * in_NormalM);
+    ex_PositionV = viewWorld * positionM;
+#endif
+#if defined(ATLAS) && !defined(DEPTH_ONLY)
+    ex_TextureTransform = in_TextureTransform;
+    ex_TextureLayer = in_TextureLayer;
+#endif
 }
@@ -0,0 +1,6 @@
+#version 400
+
+// Writes nothing but depth, for the depth prepass. The vertex shader is basic.vs with DEPTH_ONLY.
+
+void main(void) {
+}
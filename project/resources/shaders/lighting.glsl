@@ -0,0 +1,38 @@
+// The light and ambient intensity reaching a point, needs uniforms.glsl
+//   CLUSTERED  Sum the point lights of the fragment's cluster in the light grid, instead of the one light of the Frame block
+
+#ifdef CLUSTERED
+uniform samplerBuffer g_Lights;             // Two texels per light: view space position and radius, then intensity
+uniform usamplerBuffer g_LightClusters;     // The first index and count of each cluster's lights
+uniform usamplerBuffer g_LightIndices;
+
+vec3 shade(vec4 positionV, vec3 normalV) {
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * g_ClusterScale.xy), g_ClusterCount.xy - 1u);
+    uint slice = uint(clamp(log(-positionV.z) * g_ClusterScale.z + g_ClusterScale.w, 0.0, float(g_ClusterCount.z - 1u)));
+    uvec2 cluster = texelFetch(g_LightClusters, int(tile.x + g_ClusterCount.x * (tile.y + g_ClusterCount.y * slice))).xy;
+
+    vec3 intensity = g_AmbientIntensity;
+    for (uint i = 0u; i < cluster.y; ++i) {
+        int light = int(texelFetch(g_LightIndices, int(cluster.x + i)).x);
+        vec4 positionRadius = texelFetch(g_Lights, light * 2);
+
+        vec3 toLight = positionRadius.xyz - positionV.xyz;
+        float distance = max(length(toLight), 1e-4);
+        float incidence = clamp(dot(toLight / distance, normalV), 0, 1);
+
+        // nearly constant up close and zero at the radius, so a light ends where its clusters do
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+
+        intensity += texelFetch(g_Lights, light * 2 + 1).rgb * incidence * window * window;
+    }
+
+    return intensity;
+}
+#else
+vec3 shade(vec4 positionV, vec3 normalV) {
+    float incidence = dot(normalize(g_LightPositionV - positionV).xyz, normalV);
+    incidence = clamp(incidence, 0, 1);
+
+    return g_LightIntensity * incidence + g_AmbientIntensity;
+}
+#endif
@@ -0,0 +1,20 @@
+// The uniform blocks shared by all programs, mirroring project/uniforms.hpp
+
+layout(std140) uniform Frame {
+    mat4 g_Projection;
+    mat4 g_View;
+    vec4 g_LightPositionV;
+    vec3 g_LightIntensity;
+    vec3 g_AmbientIntensity;
+    vec4 g_ClusterScale;        // Tiles per pixel in xy, the slice of a depth is log(depth) * z + w
+    uvec4 g_ClusterCount;       // Tiles across and up, and slices
+};
+
+// instanced programs take their transforms per instance instead
+#ifndef INSTANCED
+layout(std140) uniform Object {
+    mat4 g_ViewWorld;
+    mat3 g_NormalViewWorld;
+    uvec2 g_TextureHandle;      // Only read by BINDLESS programs
+};
+#endif
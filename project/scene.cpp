@@ -0,0 +1,105 @@
+#include "scene.hpp"
+#include <limits>
+
+/** Narrows the leaf hits of a ray cast down to the closest entity */
+struct ClosestHit {
+	const std::vector<std::shared_ptr<Entity> >* m_entities;
+	glm::vec3 m_origin;
+	glm::vec3 m_inverseDirection;
+	Scene::Handle m_hit;
+	float m_distance;
+
+	float operator()(size_t handle, float distance) {
+		float entityDistance;
+		if ((*m_entities)[handle]->getWorldBox().intersectsRay(m_origin, m_inverseDirection, m_distance, entityDistance)) {
+			m_hit = handle;
+			m_distance = entityDistance;
+		}
+
+		return m_distance;
+	}
+};
+
+Scene::Scene()
+	: m_entityCount(0) {}
+
+Scene::Handle Scene::add(const std::shared_ptr<Entity>& entity) {
+	Handle handle;
+	if (m_freeHandles.empty()) {
+		handle = m_entities.size();
+		m_entities.push_back(entity);
+		m_proxies.push_back(DynamicAABBTree::NULL_NODE);
+	} else {
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+		m_entities[handle] = entity;
+	}
+
+	m_proxies[handle] = m_tree.insert(entity->getWorldBox(), handle);
+	++m_entityCount;
+
+	return handle;
+}
+
+void Scene::remove(Handle handle) {
+	m_tree.remove(m_proxies[handle]);
+	m_proxies[handle] = DynamicAABBTree::NULL_NODE;
+	m_entities[handle].reset();
+	m_freeHandles.push_back(handle);
+	--m_entityCount;
+}
+
+void Scene::setModelMatrix(Handle handle, const glm::mat4& modelMatrix) {
+	m_entities[handle]->setModelMatrix(modelMatrix);
+	m_tree.deferUpdate(m_proxies[handle], m_entities[handle]->getWorldBox());
+}
+
+void Scene::commitUpdates() {
+	m_tree.commitUpdates();
+}
+
+CullStats Scene::cull(const Frustum& frustum, std::vector<Handle>& visible) const {
+	// the tree works on fattened boxes, so test the exact box of each candidate too
+	size_t first = visible.size();
+	m_candidates.clear();
+	m_tree.queryFrustum(frustum, m_candidates);
+
+	for (size_t i = 0; i < m_candidates.size(); ++i) {
+		if (frustum.intersects(m_entities[m_candidates[i]]->getWorldBox()))
+			visible.push_back(m_candidates[i]);
+	}
+
+	CullStats stats;
+	stats.m_tested = m_entityCount;
+	stats.m_visible = visible.size() - first;
+
+	return stats;
+}
+
+bool Scene::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Handle& hit, float& distance) const {
+	ClosestHit closest;
+	closest.m_entities = &m_entities;
+	closest.m_origin = origin;
+	closest.m_inverseDirection = 1.0f / direction;
+	closest.m_hit = std::numeric_limits<Handle>::max();
+	closest.m_distance = maxDistance;
+
+	m_tree.raycast(origin, direction, maxDistance, closest);
+	if (closest.m_hit == std::numeric_limits<Handle>::max())
+		return false;
+
+	hit = closest.m_hit;
+	distance = closest.m_distance;
+
+	return true;
+}
+
+void Scene::querySphere(const BoundingSphere& sphere, std::vector<Handle>& results) const {
+	m_candidates.clear();
+	m_tree.querySphere(sphere, m_candidates);
+
+	for (size_t i = 0; i < m_candidates.size(); ++i) {
+		if (m_entities[m_candidates[i]]->getWorldBox().intersects(sphere))
+			results.push_back(m_candidates[i]);
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <memory>
+#include <vector>
+#include <util\util.hpp>
+#include "entity.hpp"
+
+/** Owns the entities of the scene and keeps their world bounds in a dynamic AABB tree for culling and queries */
+class Scene {
+public:
+	typedef size_t Handle;
+
+	Scene();
+
+	/** Add an entity with its current model matrix */
+	Handle add(const std::shared_ptr<Entity>& entity);
+	void remove(Handle handle);
+
+	const std::shared_ptr<Entity>& getEntity(Handle handle) const { return m_entities[handle]; }
+	size_t getEntityCount() const { return m_entityCount; }
+
+	/** Handles run from 0 to the handle count. Removed handles map to null entities. */
+	size_t getHandleCount() const { return m_entities.size(); }
+
+	/** Move an entity. The tree is only updated in commitUpdates, so call it once all entities for the tick have moved. */
+	void setModelMatrix(Handle handle, const glm::mat4& modelMatrix);
+	void commitUpdates();
+
+	/** Collect the entities intersecting the frustum */
+	CullStats cull(const Frustum& frustum, std::vector<Handle>& visible) const;
+
+	/** Find the closest entity whose bounding box the ray hits. Returns false on a miss. */
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Handle& hit, float& distance) const;
+
+	/** Collect the entities whose bounding boxes overlap the sphere */
+	void querySphere(const BoundingSphere& sphere, std::vector<Handle>& results) const;
+private:
+	DynamicAABBTree m_tree;
+
+	// indexed by handle; removed handles are null and reused
+	std::vector<std::shared_ptr<Entity> > m_entities;
+	std::vector<int> m_proxies;
+	std::vector<Handle> m_freeHandles;
+	size_t m_entityCount;
+
+	mutable std::vector<size_t> m_candidates;
+};
+
+#endif
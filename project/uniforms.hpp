@@ -0,0 +1,47 @@
+#ifndef UNIFORMS_HPP
+#define UNIFORMS_HPP
+
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include <util/shader.hpp>
+
+/** The uniform block binding points shared by all programs */
+enum UniformBinding {
+	UNIFORM_BINDING_FRAME = 0,
+	UNIFORM_BINDING_OBJECT = 1
+};
+
+/** The texture units of the light grid, bound once per frame above the units a draw hands out to its own textures */
+enum TextureBinding {
+	TEXTURE_BINDING_LIGHTS = 8,
+	TEXTURE_BINDING_LIGHT_CLUSTERS = 9,
+	TEXTURE_BINDING_LIGHT_INDICES = 10
+};
+
+/** Mirrors the std140 Frame block, updated once per frame. vec3 members are padded to vec4. */
+struct FrameUniforms {
+	glm::mat4 m_projection;
+	glm::mat4 m_view;
+	glm::vec4 m_lightPositionV;
+	glm::vec4 m_lightIntensity;
+	glm::vec4 m_ambientIntensity;
+	glm::vec4 m_clusterScale;       // LightGrid::getClusterScale
+	glm::uvec4 m_clusterCount;      // Tiles across and up, and slices
+};
+
+/** Mirrors the std140 Object block, ring allocated per drawn entity. A std140 mat3 is three vec4 columns. */
+struct ObjectUniforms {
+	glm::mat4 m_viewWorld;
+	glm::vec4 m_normalViewWorld[3];
+	GLuint64 m_textureHandle;       // A uvec2, the bindless handle of the diffuse texture if the entity draws bindless
+	GLuint64 m_padding;             // The block is rounded up to a vec4
+};
+
+/** Point the light grid samplers of a CLUSTERED program at their units. Does nothing to other programs. */
+inline void setLightGridUnits(Program& program) {
+	program.setSamplerUnit("g_Lights", TEXTURE_BINDING_LIGHTS);
+	program.setSamplerUnit("g_LightClusters", TEXTURE_BINDING_LIGHT_CLUSTERS);
+	program.setSamplerUnit("g_LightIndices", TEXTURE_BINDING_LIGHT_INDICES);
+}
+
+#endif
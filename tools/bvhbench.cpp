@@ -0,0 +1,182 @@
+#define _USE_MATH_DEFINES
+
+#include <util/bvh.hpp>
+#include <util/camera.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Benchmarks the dynamic AABB tree used by the scene: inserting, moving and querying a
+ * number of randomly placed boxes at a constant density. Brute force frustum culling over
+ * the same boxes is timed for comparison.
+ *
+ * Usage: bvhbench [count]...  (defaults to 10000 and 100000)
+ */
+
+static const int FRUSTUM_QUERIES = 100;
+static const int RAY_QUERIES = 1000;
+static const int SPHERE_QUERIES = 1000;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void report(const std::string& name, double totalMs, size_t operations) {
+    std::cout << "  " << name << ": " << totalMs << " ms (" << totalMs * 1000.0 / operations << " us/op)" << std::endl;
+}
+
+/** Keeps the closest hit, like the scene does */
+struct ClosestHit {
+    size_t m_hits;
+
+    float operator()(size_t userData, float distance) {
+        ++m_hits;
+        return distance;
+    }
+};
+
+static void benchmark(size_t count) {
+    std::mt19937 random(1234);
+
+    // keep the density constant, about one box per 1000 cubic units
+    float extent = std::pow((float) count * 1000.0f, 1.0f / 3.0f) * 0.5f;
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> size(0.5f, 2.0f);
+    std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<AABB> boxes(count);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 halfSize(size(random) * 0.5f);
+        boxes[i] = AABB(center - halfSize, center + halfSize);
+    }
+
+    std::cout << count << " boxes in a " << extent * 2.0f << " unit cube" << std::endl;
+
+    // insert
+    DynamicAABBTree tree;
+    std::vector<int> proxies(count);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        proxies[i] = tree.insert(boxes[i], i);
+    }
+    report("insert", elapsedMs(start), count);
+    std::cout << "  height: " << tree.getHeight() << std::endl;
+
+    // move a tenth of the boxes one at a time, then all of them batched
+    size_t moved = count / 10;
+    start = Clock::now();
+    for (size_t i = 0; i < moved; ++i) {
+        glm::vec3 offset(step(random), step(random), step(random));
+        boxes[i] = AABB(boxes[i].m_min + offset, boxes[i].m_max + offset);
+        tree.update(proxies[i], boxes[i]);
+    }
+    report("update 10% immediate", elapsedMs(start), moved);
+
+    start = Clock::now();
+    for (size_t i = 0; i < moved; ++i) {
+        glm::vec3 offset(step(random), step(random), step(random));
+        boxes[i] = AABB(boxes[i].m_min + offset, boxes[i].m_max + offset);
+        tree.deferUpdate(proxies[i], boxes[i]);
+    }
+    tree.commitUpdates();
+    report("update 10% batched (reinsert)", elapsedMs(start), moved);
+
+    start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 offset(step(random), step(random), step(random));
+        boxes[i] = AABB(boxes[i].m_min + offset, boxes[i].m_max + offset);
+        tree.deferUpdate(proxies[i], boxes[i]);
+    }
+    tree.commitUpdates();
+    report("update 100% batched (refit)", elapsedMs(start), count);
+
+    // frustum culling from the center of the cube, turning around
+    Camera camera;
+    camera.setUp(glm::vec3(0.0f, 1.0f, 0.0f));
+    camera.setPosition(glm::vec3(0.0f));
+    camera.setProjection(Camera::createPerspectiveProjection(1.0f, extent, M_PI * 0.25f, 4.0f / 3.0f));
+
+    std::vector<Frustum> frustums(FRUSTUM_QUERIES);
+    for (int i = 0; i < FRUSTUM_QUERIES; ++i) {
+        float angle = 2.0f * M_PI * i / FRUSTUM_QUERIES;
+        camera.setFacing(glm::vec3(std::cos(angle), 0.0f, std::sin(angle)));
+        camera.commit();
+        frustums[i] = camera.getFrustum();
+    }
+
+    std::vector<size_t> results;
+    size_t treeVisible = 0;
+    start = Clock::now();
+    for (int i = 0; i < FRUSTUM_QUERIES; ++i) {
+        results.clear();
+        tree.queryFrustum(frustums[i], results);
+        treeVisible += results.size();
+    }
+    report("frustum query", elapsedMs(start), FRUSTUM_QUERIES);
+
+    size_t bruteVisible = 0;
+    start = Clock::now();
+    for (int i = 0; i < FRUSTUM_QUERIES; ++i) {
+        for (size_t b = 0; b < count; ++b) {
+            if (frustums[i].intersects(tree.getFatBounds(proxies[b])))
+                ++bruteVisible;
+        }
+    }
+    report("frustum brute force", elapsedMs(start), FRUSTUM_QUERIES);
+
+    std::cout << "  visible per frustum: " << treeVisible / FRUSTUM_QUERIES << " (brute force " << bruteVisible / FRUSTUM_QUERIES << ")" << std::endl;
+
+    // rays from random points in random directions
+    ClosestHit closest = { 0 };
+    start = Clock::now();
+    for (int i = 0; i < RAY_QUERIES; ++i) {
+        glm::vec3 origin(position(random), position(random), position(random));
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(1e-3f));
+        tree.raycast(origin, direction, extent, closest);
+    }
+    report("ray cast", elapsedMs(start), RAY_QUERIES);
+
+    size_t overlaps = 0;
+    start = Clock::now();
+    for (int i = 0; i < SPHERE_QUERIES; ++i) {
+        results.clear();
+        tree.querySphere(BoundingSphere(glm::vec3(position(random), position(random), position(random)), 10.0f), results);
+        overlaps += results.size();
+    }
+    report("sphere query", elapsedMs(start), SPHERE_QUERIES);
+
+    std::cout << "  leaves per sphere: " << (float) overlaps / SPHERE_QUERIES << std::endl;
+
+    start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        tree.remove(proxies[i]);
+    }
+    report("remove", elapsedMs(start), count);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> counts;
+    for (int i = 1; i < argc; ++i) {
+        counts.push_back(std::strtoul(argv[i], NULL, 10));
+    }
+
+    if (counts.empty()) {
+        counts.push_back(10000);
+        counts.push_back(100000);
+    }
+
+    for (size_t i = 0; i < counts.size(); ++i) {
+        benchmark(counts[i]);
+    }
+
+    return 0;
+}
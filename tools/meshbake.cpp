@@ -0,0 +1,87 @@
+#include <util/mesh.hpp>
+#include <util/optimizer.hpp>
+#include <util/simplifier.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Writes the binary mesh cache, including the levels of detail, next to each
+ * given .obj file, so the first launch doesn't have to parse them. With --optimize the triangles and vertices
+ * are reordered for the post-transform cache and vertex fetch, and with --overdraw
+ * the triangle clusters are additionally sorted to reduce overdraw.
+ *
+ * Usage: meshbake [--half-texcoords] [--optimize] [--overdraw] <file.obj>...
+ */
+int main(int argc, char* argv[]) {
+    bool halfTexCoords = false;
+    bool optimize = false;
+    bool overdraw = false;
+    std::vector<std::string> sources;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--half-texcoords") {
+            halfTexCoords = true;
+        } else if (argument == "--optimize") {
+            optimize = true;
+        } else if (argument == "--overdraw") {
+            optimize = true;
+            overdraw = true;
+        } else {
+            sources.push_back(argument);
+        }
+    }
+
+    if (sources.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--half-texcoords] [--optimize] [--overdraw] <file.obj>..." << std::endl;
+        return 1;
+    }
+
+    VertexFormat format = VertexFormat::createCompact(halfTexCoords);
+    int failures = 0;
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        try {
+            Mesh::Data data = Mesh::parseOBJ(sources[i]);
+            for (std::map<std::string, Mesh::GroupData>::iterator it = data.m_groups.begin(); it != data.m_groups.end(); ++it) {
+                MeshSimplifier::generateLods(it->second);
+
+                std::cout << "INFO: " << sources[i] << " [" << it->first << "]: " << it->second.m_indices.size() / 3 << " triangles";
+                for (size_t l = 0; l < it->second.m_lods.size(); ++l) {
+                    std::cout << ", LOD" << l + 1 << " " << it->second.m_lods[l].m_indices.size() / 3 << " (error " << it->second.m_lods[l].m_error << ")";
+                }
+                std::cout << std::endl;
+            }
+
+            if (optimize) {
+                for (std::map<std::string, Mesh::GroupData>::iterator it = data.m_groups.begin(); it != data.m_groups.end(); ++it) {
+                    VertexCacheStats before = MeshOptimizer::analyzeVertexCache(it->second.m_indices, it->second.m_vertices.size());
+                    MeshOptimizer::optimize(it->second, overdraw);
+                    VertexCacheStats after = MeshOptimizer::analyzeVertexCache(it->second.m_indices, it->second.m_vertices.size());
+
+                    std::cout << "INFO: " << sources[i] << " [" << it->first << "]: " <<
+                                 "ACMR " << before.m_acmr << " -> " << after.m_acmr << ", " <<
+                                 "ATVR " << before.m_atvr << " -> " << after.m_atvr << std::endl;
+                }
+            }
+
+            Mesh::writeCache(data, format, sources[i]);
+
+            size_t vertexCount = 0;
+            size_t indexCount = 0;
+            for (std::map<std::string, Mesh::GroupData>::const_iterator it = data.m_groups.begin(); it != data.m_groups.end(); ++it) {
+                vertexCount += it->second.m_vertices.size();
+                indexCount += it->second.m_indices.size();
+            }
+
+            std::cout << "INFO: Baked " << Mesh::getCacheFilename(sources[i]) << " (" << data.m_groups.size() << " groups, " <<
+                         vertexCount << " vertices, " << indexCount << " indices)" << std::endl;
+        } catch (std::exception& e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+            ++failures;
+        }
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
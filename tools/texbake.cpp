@@ -0,0 +1,67 @@
+#include <util/texture.hpp>
+#include <util/blockcompressor.hpp>
+#include <IL/il.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Writes a block compressed DDS with the full mip chain next to each given image, which the
+ * texture loader then uploads directly instead of decoding the image and generating mipmaps
+ * at run time. Images with any transparent texel become BC3 (DXT5), the others BC1 (DXT1),
+ * unless a format is forced.
+ *
+ * Usage: texbake [--bc1|--bc3] <image>...
+ */
+int main(int argc, char* argv[]) {
+    enum { FORMAT_AUTO, FORMAT_BC1, FORMAT_BC3 } format = FORMAT_AUTO;
+    std::vector<std::string> sources;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--bc1") {
+            format = FORMAT_BC1;
+        } else if (argument == "--bc3") {
+            format = FORMAT_BC3;
+        } else {
+            sources.push_back(argument);
+        }
+    }
+
+    if (sources.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--bc1|--bc3] <image>..." << std::endl;
+        return 1;
+    }
+
+    ilInit();
+    int failures = 0;
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        try {
+            Texture::Image source = Texture::decodeImage(sources[i]);
+            Texture::Image::Level rgba = BlockCompressor::toRGBA(source);
+
+            bool alpha = (format == FORMAT_BC3);
+            if (format == FORMAT_AUTO) {
+                for (size_t t = 3; t < rgba.m_data.size() && !alpha; t += 4) {
+                    alpha = rgba.m_data[t] < 255;
+                }
+            }
+
+            Texture::Image baked = BlockCompressor::compressImage(source, alpha);
+            Texture::writeDDS(Texture::getBakedFilename(sources[i]), baked);
+
+            Texture::Image::Level decoded = BlockCompressor::decompress(baked.m_levels[0], alpha);
+            double psnr = BlockCompressor::computePSNR(rgba, decoded, alpha ? 4 : 3);
+
+            std::cout << "INFO: Baked " << Texture::getBakedFilename(sources[i]) << " (" << (alpha ? "BC3" : "BC1") << ", " <<
+                         rgba.m_width << "x" << rgba.m_height << ", " << baked.m_levels.size() << " levels, " <<
+                         source.getSize() << " -> " << baked.getSize() << " bytes, PSNR " << psnr << " dB)" << std::endl;
+        } catch (std::exception& e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+            ++failures;
+        }
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include <util/util.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Measures the CPU cost of setting the per-draw uniforms of an entity, looking the locations up
+ * with glGetUniformLocation on every draw (as Entity used to) versus through cached Uniform handles.
+ * Opens a small window for the context.
+ *
+ * Usage: uniformbench [draws]
+ */
+
+static const char* VERTEX_SHADER =
+    "#version 400\n"
+    "in vec3 in_PositionM;\n"
+    "in vec3 in_NormalM;\n"
+    "out vec3 normalV;\n"
+    "uniform mat4 g_Projection;\n"
+    "uniform mat4 g_ViewWorld;\n"
+    "uniform mat3 g_NormalViewWorld;\n"
+    "void main() {\n"
+    "    normalV = g_NormalViewWorld * in_NormalM;\n"
+    "    gl_Position = g_Projection * g_ViewWorld * vec4(in_PositionM, 1.0);\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER =
+    "#version 400\n"
+    "in vec3 normalV;\n"
+    "out vec4 out_Color;\n"
+    "uniform vec4 g_LightPositionV;\n"
+    "uniform vec3 g_LightIntensity;\n"
+    "uniform vec3 g_AmbientIntensity;\n"
+    "void main() {\n"
+    "    out_Color = vec4(g_AmbientIntensity + g_LightIntensity * max(dot(normalV, g_LightPositionV.xyz), 0.0), 1.0);\n"
+    "}\n";
+
+typedef std::chrono::high_resolution_clock Clock;
+
+int main(int argc, char* argv[]) {
+    int draws = (argc > 1) ? std::atoi(argv[1]) : 100000;
+
+    try {
+        LabApplication application;
+
+        LabApplication::ContextDescription description;
+        description.m_openglVersionMajor = 4;
+        description.m_openglVersionMinor = 0;
+        description.m_windowWidth = 64;
+        description.m_windowHeight = 64;
+        description.m_windowTitle = "uniformbench";
+        application.createContext(description);
+
+        std::vector<std::shared_ptr<Shader> > shaders;
+        shaders.push_back(std::shared_ptr<Shader>(new Shader(VERTEX_SHADER, GL_VERTEX_SHADER)));
+        shaders.push_back(std::shared_ptr<Shader>(new Shader(FRAGMENT_SHADER, GL_FRAGMENT_SHADER)));
+        Program program(shaders);
+
+        glm::mat4 projection(1.0f);
+        glm::mat4 viewWorld(1.0f);
+        glm::mat3 normalViewWorld(1.0f);
+        glm::vec3 ambient(0.2f);
+        glm::vec3 intensity(0.8f);
+        glm::vec4 lightPosition(0.0f, 3.0f, 6.0f, 1.0f);
+
+        glUseProgramState programBinding(program.getId());
+
+        // look up every location on every draw
+        GLCheck(glFinish());
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < draws; ++i) {
+            GLint projectionUniform = GLCheck(glGetUniformLocation(program.getId(), "g_Projection"));
+            GLint viewWorldUniform = GLCheck(glGetUniformLocation(program.getId(), "g_ViewWorld"));
+            GLint normalViewWorldUniform = GLCheck(glGetUniformLocation(program.getId(), "g_NormalViewWorld"));
+            GLint ambientIntensityUniform = GLCheck(glGetUniformLocation(program.getId(), "g_AmbientIntensity"));
+            GLint lightIntensityUniform = GLCheck(glGetUniformLocation(program.getId(), "g_LightIntensity"));
+            GLint lightPositionUniform = GLCheck(glGetUniformLocation(program.getId(), "g_LightPositionV"));
+
+            GLCheck(glUniformMatrix4fv(projectionUniform, 1, GL_FALSE, &projection[0][0]));
+            GLCheck(glUniformMatrix4fv(viewWorldUniform, 1, GL_FALSE, &viewWorld[0][0]));
+            GLCheck(glUniformMatrix3fv(normalViewWorldUniform, 1, GL_FALSE, &normalViewWorld[0][0]));
+            GLCheck(glUniform3fv(ambientIntensityUniform, 1, &ambient[0]));
+            GLCheck(glUniform3fv(lightIntensityUniform, 1, &intensity[0]));
+            GLCheck(glUniform4fv(lightPositionUniform, 1, &lightPosition[0]));
+        }
+        GLCheck(glFinish());
+        double lookupMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        // cached handles
+        Uniform<glm::mat4> projectionUniform(program, "g_Projection");
+        Uniform<glm::mat4> viewWorldUniform(program, "g_ViewWorld");
+        Uniform<glm::mat3> normalViewWorldUniform(program, "g_NormalViewWorld");
+        Uniform<glm::vec3> ambientIntensityUniform(program, "g_AmbientIntensity");
+        Uniform<glm::vec3> lightIntensityUniform(program, "g_LightIntensity");
+        Uniform<glm::vec4> lightPositionUniform(program, "g_LightPositionV");
+
+        start = Clock::now();
+        for (int i = 0; i < draws; ++i) {
+            projectionUniform.set(projection);
+            viewWorldUniform.set(viewWorld);
+            normalViewWorldUniform.set(normalViewWorld);
+            ambientIntensityUniform.set(ambient);
+            lightIntensityUniform.set(intensity);
+            lightPositionUniform.set(lightPosition);
+        }
+        GLCheck(glFinish());
+        double cachedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::cout << draws << " draws" << std::endl;
+        std::cout << "  glGetUniformLocation per draw: " << lookupMs * 1e6 / draws << " ns/draw" << std::endl;
+        std::cout << "  cached Uniform handles:        " << cachedMs * 1e6 / draws << " ns/draw" << std::endl;
+    } catch (std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,454 @@
+#include "blockcompressor.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <glm/glm.hpp>
+#include <r2tk/r2-exception.hpp>
+
+// Times the endpoints are refit to the indices they selected
+static const int REFINE_ITERATIONS = 2;
+
+static float srgbToLinear(unsigned char value) {
+    float c = value / 255.0f;
+    return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static unsigned char linearToSrgb(float value) {
+    float c = (value <= 0.0031308f) ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char) glm::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f);
+}
+
+static uint16_t pack565(const glm::vec3& color) {
+    int r = glm::clamp((int) (color.r * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = glm::clamp((int) (color.g * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = glm::clamp((int) (color.b * 31.0f / 255.0f + 0.5f), 0, 31);
+
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static glm::ivec3 unpack565(uint16_t color) {
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+
+    return glm::ivec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+/** The four colors a BC1 block can select from, computed the way the hardware decodes them */
+static void getPalette(uint16_t c0, uint16_t c1, bool forceFourColor, glm::ivec3* palette) {
+    palette[0] = unpack565(c0);
+    palette[1] = unpack565(c1);
+    if (c0 > c1 || forceFourColor) {
+        palette[2] = (2 * palette[0] + palette[1]) / 3;
+        palette[3] = (palette[0] + 2 * palette[1]) / 3;
+    } else {
+        palette[2] = (palette[0] + palette[1]) / 2;
+        palette[3] = glm::ivec3(0);
+    }
+}
+
+static int distanceSquared(const glm::ivec3& a, const glm::vec3& b) {
+    glm::vec3 d = glm::vec3(a) - b;
+    return (int) glm::dot(d, d);
+}
+
+/** Pick the closest palette entry for every texel and return the total squared error */
+static int selectIndices(const glm::vec3* colors, uint16_t c0, uint16_t c1, unsigned char* indices) {
+    glm::ivec3 palette[4];
+    getPalette(c0, c1, false, palette);
+
+    // with equal endpoints the block is in three color mode, where index 3 is black
+    int paletteSize = (c0 == c1) ? 1 : 4;
+
+    int error = 0;
+    for (int i = 0; i < 16; ++i) {
+        int best = 0;
+        int bestDistance = distanceSquared(palette[0], colors[i]);
+        for (int p = 1; p < paletteSize; ++p) {
+            int distance = distanceSquared(palette[p], colors[i]);
+            if (distance < bestDistance) {
+                best = p;
+                bestDistance = distance;
+            }
+        }
+
+        indices[i] = best;
+        error += bestDistance;
+    }
+
+    return error;
+}
+
+/** Quantize the endpoints into four color mode order, select the indices and return the error */
+static int evaluateEndpoints(const glm::vec3* colors, const glm::vec3& e0, const glm::vec3& e1, uint16_t& c0, uint16_t& c1, unsigned char* indices) {
+    c0 = pack565(e0);
+    c1 = pack565(e1);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    return selectIndices(colors, c0, c1, indices);
+}
+
+/** Solve for the endpoints that best reproduce the colors with the given indices. Returns false if they are degenerate. */
+static bool fitEndpoints(const glm::vec3* colors, const unsigned char* indices, glm::vec3& e0, glm::vec3& e1) {
+    static const float WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    glm::vec3 ax(0.0f), bx(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        float a = WEIGHTS[indices[i]];
+        float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ax += a * colors[i];
+        bx += b * colors[i];
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+
+    e0 = (ax * bb - bx * ab) / determinant;
+    e1 = (bx * aa - ax * ab) / determinant;
+
+    return true;
+}
+
+static void writeColorBlock(uint16_t c0, uint16_t c1, const unsigned char* indices, unsigned char* block) {
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) {
+        bits |= (uint32_t) indices[i] << (2 * i);
+    }
+
+    block[0] = c0 & 0xFF;
+    block[1] = c0 >> 8;
+    block[2] = c1 & 0xFF;
+    block[3] = c1 >> 8;
+    block[4] = bits & 0xFF;
+    block[5] = (bits >> 8) & 0xFF;
+    block[6] = (bits >> 16) & 0xFF;
+    block[7] = bits >> 24;
+}
+
+static void decodeColorBlock(const unsigned char* block, bool forceFourColor, unsigned char* rgba) {
+    uint16_t c0 = block[0] | (block[1] << 8);
+    uint16_t c1 = block[2] | (block[3] << 8);
+    uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t) block[7] << 24);
+
+    glm::ivec3 palette[4];
+    getPalette(c0, c1, forceFourColor, palette);
+
+    for (int i = 0; i < 16; ++i) {
+        const glm::ivec3& color = palette[(bits >> (2 * i)) & 3];
+        rgba[i * 4 + 0] = color.r;
+        rgba[i * 4 + 1] = color.g;
+        rgba[i * 4 + 2] = color.b;
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+void BlockCompressor::compressBC1Block(const unsigned char* rgba, unsigned char* block) {
+    glm::vec3 colors[16];
+    glm::vec3 mean(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        colors[i] = glm::vec3(rgba[i * 4 + 0], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+        mean += colors[i];
+    }
+    mean /= 16.0f;
+
+    // the principal axis of the colors, by power iteration on their covariance
+    glm::mat3 covariance(0.0f);
+    glm::vec3 minColor = colors[0];
+    glm::vec3 maxColor = colors[0];
+    for (int i = 0; i < 16; ++i) {
+        glm::vec3 d = colors[i] - mean;
+        covariance += glm::mat3(d * d.x, d * d.y, d * d.z);
+        minColor = glm::min(minColor, colors[i]);
+        maxColor = glm::max(maxColor, colors[i]);
+    }
+
+    glm::vec3 axis = maxColor - minColor;
+    if (glm::dot(axis, axis) < 1e-6f)
+        axis = glm::vec3(1.0f);
+
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 next = covariance * axis;
+        float length = glm::length(next);
+        if (length < 1e-6f)
+            break;
+
+        axis = next / length;
+    }
+    axis = glm::normalize(axis);
+
+    float minT = std::numeric_limits<float>::max();
+    float maxT = -std::numeric_limits<float>::max();
+    for (int i = 0; i < 16; ++i) {
+        float t = glm::dot(colors[i] - mean, axis);
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    uint16_t bestC0, bestC1;
+    unsigned char bestIndices[16];
+    int bestError = evaluateEndpoints(colors, mean + axis * maxT, mean + axis * minT, bestC0, bestC1, bestIndices);
+
+    for (int iteration = 0; iteration < REFINE_ITERATIONS && bestError > 0; ++iteration) {
+        glm::vec3 e0, e1;
+        if (!fitEndpoints(colors, bestIndices, e0, e1))
+            break;
+
+        uint16_t c0, c1;
+        unsigned char indices[16];
+        int error = evaluateEndpoints(colors, e0, e1, c0, c1, indices);
+        if (error >= bestError)
+            break;
+
+        bestC0 = c0;
+        bestC1 = c1;
+        bestError = error;
+        std::copy(indices, indices + 16, bestIndices);
+    }
+
+    writeColorBlock(bestC0, bestC1, bestIndices, block);
+}
+
+void BlockCompressor::compressBC3Block(const unsigned char* rgba, unsigned char* block) {
+    unsigned char minAlpha = 255;
+    unsigned char maxAlpha = 0;
+    for (int i = 0; i < 16; ++i) {
+        minAlpha = std::min(minAlpha, rgba[i * 4 + 3]);
+        maxAlpha = std::max(maxAlpha, rgba[i * 4 + 3]);
+    }
+
+    // eight alpha mode, which needs the first endpoint to be the larger
+    int palette[8];
+    palette[0] = maxAlpha;
+    palette[1] = minAlpha;
+    for (int i = 2; i < 8; ++i) {
+        palette[i] = ((8 - i) * maxAlpha + (i - 1) * minAlpha) / 7;
+    }
+
+    uint64_t bits = 0;
+    if (maxAlpha != minAlpha) {
+        for (int i = 0; i < 16; ++i) {
+            int alpha = rgba[i * 4 + 3];
+            int best = 0;
+            for (int p = 1; p < 8; ++p) {
+                if (std::abs(palette[p] - alpha) < std::abs(palette[best] - alpha))
+                    best = p;
+            }
+
+            bits |= (uint64_t) best << (3 * i);
+        }
+    }
+
+    block[0] = maxAlpha;
+    block[1] = minAlpha;
+    for (int i = 0; i < 6; ++i) {
+        block[2 + i] = (bits >> (8 * i)) & 0xFF;
+    }
+
+    compressBC1Block(rgba, block + 8);
+}
+
+void BlockCompressor::decompressBC1Block(const unsigned char* block, unsigned char* rgba) {
+    decodeColorBlock(block, false, rgba);
+}
+
+void BlockCompressor::decompressBC3Block(const unsigned char* block, unsigned char* rgba) {
+    // the color block of BC3 is always in four color mode
+    decodeColorBlock(block + 8, true, rgba);
+
+    int a0 = block[0];
+    int a1 = block[1];
+    int palette[8] = { a0, a1 };
+    if (a0 > a1) {
+        for (int i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        }
+    } else {
+        for (int i = 2; i < 6; ++i) {
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i) {
+        bits |= (uint64_t) block[2 + i] << (8 * i);
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        rgba[i * 4 + 3] = palette[(bits >> (3 * i)) & 7];
+    }
+}
+
+Texture::Image::Level BlockCompressor::compress(const Texture::Image::Level& level, bool alpha) {
+    size_t blockSize = alpha ? BC3_BLOCK_SIZE : BC1_BLOCK_SIZE;
+    int blocksX = (level.m_width + 3) / 4;
+    int blocksY = (level.m_height + 3) / 4;
+
+    Texture::Image::Level result;
+    result.m_width = level.m_width;
+    result.m_height = level.m_height;
+    result.m_data.resize(blocksX * blocksY * blockSize);
+
+    unsigned char texels[64];
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            for (int i = 0; i < 16; ++i) {
+                int x = std::min(bx * 4 + i % 4, level.m_width - 1);
+                int y = std::min(by * 4 + i / 4, level.m_height - 1);
+                std::copy(&level.m_data[(y * level.m_width + x) * 4], &level.m_data[(y * level.m_width + x) * 4] + 4, texels + i * 4);
+            }
+
+            unsigned char* block = &result.m_data[(by * blocksX + bx) * blockSize];
+            if (alpha) {
+                compressBC3Block(texels, block);
+            } else {
+                compressBC1Block(texels, block);
+            }
+        }
+    }
+
+    return result;
+}
+
+Texture::Image::Level BlockCompressor::decompress(const Texture::Image::Level& level, bool alpha) {
+    size_t blockSize = alpha ? BC3_BLOCK_SIZE : BC1_BLOCK_SIZE;
+    int blocksX = (level.m_width + 3) / 4;
+    int blocksY = (level.m_height + 3) / 4;
+
+    Texture::Image::Level result;
+    result.m_width = level.m_width;
+    result.m_height = level.m_height;
+    result.m_data.resize(level.m_width * level.m_height * 4);
+
+    unsigned char texels[64];
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            const unsigned char* block = &level.m_data[(by * blocksX + bx) * blockSize];
+            if (alpha) {
+                decompressBC3Block(block, texels);
+            } else {
+                decompressBC1Block(block, texels);
+            }
+
+            for (int i = 0; i < 16; ++i) {
+                int x = bx * 4 + i % 4;
+                int y = by * 4 + i / 4;
+                if (x < level.m_width && y < level.m_height)
+                    std::copy(texels + i * 4, texels + i * 4 + 4, &result.m_data[(y * level.m_width + x) * 4]);
+            }
+        }
+    }
+
+    return result;
+}
+
+Texture::Image::Level BlockCompressor::downsample(const Texture::Image::Level& level) {
+    static const float TAPS[4] = { 1.0f / 8.0f, 3.0f / 8.0f, 3.0f / 8.0f, 1.0f / 8.0f };
+
+    float table[256];
+    for (int i = 0; i < 256; ++i) {
+        table[i] = srgbToLinear(i);
+    }
+
+    // horizontal pass into linear floats, then vertical pass back to bytes
+    int width = std::max(level.m_width / 2, 1);
+    int height = std::max(level.m_height / 2, 1);
+    std::vector<glm::vec4> rows(width * level.m_height);
+    for (int y = 0; y < level.m_height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            glm::vec4 sum(0.0f);
+            for (int t = 0; t < 4; ++t) {
+                int sx = glm::clamp(x * 2 - 1 + t, 0, level.m_width - 1);
+                const unsigned char* texel = &level.m_data[(y * level.m_width + sx) * 4];
+                sum += TAPS[t] * glm::vec4(table[texel[0]], table[texel[1]], table[texel[2]], texel[3] / 255.0f);
+            }
+
+            rows[y * width + x] = sum;
+        }
+    }
+
+    Texture::Image::Level result;
+    result.m_width = width;
+    result.m_height = height;
+    result.m_data.resize(width * height * 4);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            glm::vec4 sum(0.0f);
+            for (int t = 0; t < 4; ++t) {
+                int sy = glm::clamp(y * 2 - 1 + t, 0, level.m_height - 1);
+                sum += TAPS[t] * rows[sy * width + x];
+            }
+
+            unsigned char* texel = &result.m_data[(y * width + x) * 4];
+            texel[0] = linearToSrgb(sum.r);
+            texel[1] = linearToSrgb(sum.g);
+            texel[2] = linearToSrgb(sum.b);
+            texel[3] = (unsigned char) glm::clamp(sum.a * 255.0f + 0.5f, 0.0f, 255.0f);
+        }
+    }
+
+    return result;
+}
+
+Texture::Image::Level BlockCompressor::toRGBA(const Texture::Image& source) {
+    if (source.m_compressed || source.m_levels.empty() || (source.m_format != GL_RGB && source.m_format != GL_RGBA)) {
+        throw r2ExceptionArgumentM("Only uncompressed RGB and RGBA images can be converted");
+    }
+
+    const Texture::Image::Level& level = source.m_levels[0];
+    if (source.m_format == GL_RGBA)
+        return level;
+
+    Texture::Image::Level result;
+    result.m_width = level.m_width;
+    result.m_height = level.m_height;
+    result.m_data.resize(level.m_width * level.m_height * 4);
+    for (size_t i = 0; i < (size_t) (level.m_width * level.m_height); ++i) {
+        std::copy(&level.m_data[i * 3], &level.m_data[i * 3] + 3, &result.m_data[i * 4]);
+        result.m_data[i * 4 + 3] = 255;
+    }
+
+    return result;
+}
+
+Texture::Image BlockCompressor::compressImage(const Texture::Image& source, bool alpha) {
+    Texture::Image result;
+    result.m_format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    result.m_compressed = true;
+
+    Texture::Image::Level level = toRGBA(source);
+    for (;;) {
+        result.m_levels.push_back(compress(level, alpha));
+        if (level.m_width == 1 && level.m_height == 1)
+            break;
+
+        level = downsample(level);
+    }
+
+    return result;
+}
+
+double BlockCompressor::computePSNR(const Texture::Image::Level& a, const Texture::Image::Level& b, int channels) {
+    double squaredError = 0.0;
+    size_t texelCount = a.m_width * a.m_height;
+    for (size_t i = 0; i < texelCount; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            double d = (double) a.m_data[i * 4 + c] - (double) b.m_data[i * 4 + c];
+            squaredError += d * d;
+        }
+    }
+
+    double meanSquaredError = squaredError / (texelCount * channels);
+    if (meanSquaredError == 0.0)
+        return std::numeric_limits<double>::infinity();
+
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
@@ -0,0 +1,41 @@
+#ifndef BLOCKCOMPRESSOR_HPP
+#define BLOCKCOMPRESSOR_HPP
+
+#include "texture.hpp"
+
+/**
+ * Offline S3TC compression. Colors are fit along their principal axis and refined by least squares,
+ * which is slow next to a GPU or real time encoder but noticeably better than the bounding box fit.
+ * Blocks are 4x4 texels of RGBA8, row by row.
+ */
+class BlockCompressor {
+public:
+    static const size_t BC1_BLOCK_SIZE = 8;
+    static const size_t BC3_BLOCK_SIZE = 16;
+
+    /**
+     * Compress an uncompressed image and its full mip chain, down to 1x1. Mipmaps are filtered from the
+     * previous level in linear light. With alpha the result is BC3 (DXT5), otherwise BC1 (DXT1).
+     */
+    static Texture::Image compressImage(const Texture::Image& source, bool alpha);
+
+    /** Half the size of an RGBA level with a [1 3 3 1] filter, clamped at the edges */
+    static Texture::Image::Level downsample(const Texture::Image::Level& level);
+
+    static void compressBC1Block(const unsigned char* rgba, unsigned char* block);
+    static void compressBC3Block(const unsigned char* rgba, unsigned char* block);
+    static void decompressBC1Block(const unsigned char* block, unsigned char* rgba);
+    static void decompressBC3Block(const unsigned char* block, unsigned char* rgba);
+
+    /** Compress a whole RGBA level, repeating the edge texels into blocks that hang over it */
+    static Texture::Image::Level compress(const Texture::Image::Level& level, bool alpha);
+    static Texture::Image::Level decompress(const Texture::Image::Level& level, bool alpha);
+
+    /** Expand an image to RGBA8, if it isn't already */
+    static Texture::Image::Level toRGBA(const Texture::Image& source);
+
+    /** Peak signal to noise ratio in dB between two RGBA levels of the same size, over the given channels */
+    static double computePSNR(const Texture::Image::Level& a, const Texture::Image::Level& b, int channels);
+};
+
+#endif
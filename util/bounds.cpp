@@ -0,0 +1,192 @@
+#include "bounds.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+AABB::AABB()
+    : m_min(std::numeric_limits<float>::max())
+    , m_max(-std::numeric_limits<float>::max()) {}
+
+AABB::AABB(const glm::vec3& min, const glm::vec3& max)
+    : m_min(min)
+    , m_max(max) {}
+
+void AABB::merge(const AABB& other) {
+    m_min = glm::min(m_min, other.m_min);
+    m_max = glm::max(m_max, other.m_max);
+}
+
+float AABB::getSurfaceArea() const {
+    glm::vec3 size = m_max - m_min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool AABB::contains(const AABB& other) const {
+    return m_min.x <= other.m_min.x && m_min.y <= other.m_min.y && m_min.z <= other.m_min.z &&
+           m_max.x >= other.m_max.x && m_max.y >= other.m_max.y && m_max.z >= other.m_max.z;
+}
+
+bool AABB::intersects(const AABB& other) const {
+    return m_min.x <= other.m_max.x && m_max.x >= other.m_min.x &&
+           m_min.y <= other.m_max.y && m_max.y >= other.m_min.y &&
+           m_min.z <= other.m_max.z && m_max.z >= other.m_min.z;
+}
+
+bool AABB::intersects(const BoundingSphere& sphere) const {
+    glm::vec3 closest = glm::clamp(sphere.m_center, m_min, m_max);
+    glm::vec3 offset = sphere.m_center - closest;
+    return glm::dot(offset, offset) <= sphere.m_radius * sphere.m_radius;
+}
+
+bool AABB::intersectsRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const {
+    glm::vec3 t0 = (m_min - origin) * inverseDirection;
+    glm::vec3 t1 = (m_max - origin) * inverseDirection;
+    glm::vec3 slabEnter = glm::min(t0, t1);
+    glm::vec3 slabExit = glm::max(t0, t1);
+
+    float enter = std::max(std::max(slabEnter.x, slabEnter.y), std::max(slabEnter.z, 0.0f));
+    float exit = std::min(std::min(slabExit.x, slabExit.y), std::min(slabExit.z, maxDistance));
+    if (enter > exit)
+        return false;
+
+    distance = enter;
+    return true;
+}
+
+AABB AABB::transform(const glm::mat4& matrix) const {
+    if (isEmpty())
+        return *this;
+
+    // Arvo's method: the extents along each world axis are the sums of the absolute basis projections
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.0f));
+    glm::vec3 extents = getExtents();
+    glm::vec3 worldExtents;
+    for (int i = 0; i < 3; ++i) {
+        worldExtents[i] = std::abs(matrix[0][i]) * extents.x +
+                          std::abs(matrix[1][i]) * extents.y +
+                          std::abs(matrix[2][i]) * extents.z;
+    }
+
+    return AABB(center - worldExtents, center + worldExtents);
+}
+
+AABB AABB::fromPoints(const std::vector<glm::vec3>& points) {
+    AABB box;
+    for (size_t i = 0; i < points.size(); ++i) {
+        box.m_min = glm::min(box.m_min, points[i]);
+        box.m_max = glm::max(box.m_max, points[i]);
+    }
+
+    return box;
+}
+
+AABB AABB::combine(const AABB& a, const AABB& b) {
+    return AABB(glm::min(a.m_min, b.m_min), glm::max(a.m_max, b.m_max));
+}
+
+
+BoundingSphere::BoundingSphere()
+    : m_center(0.0f)
+    , m_radius(-1.0f) {}
+
+BoundingSphere::BoundingSphere(const glm::vec3& center, float radius)
+    : m_center(center)
+    , m_radius(radius) {}
+
+void BoundingSphere::merge(const BoundingSphere& other) {
+    if (other.m_radius < 0.0f)
+        return;
+    if (m_radius < 0.0f) {
+        *this = other;
+        return;
+    }
+
+    glm::vec3 offset = other.m_center - m_center;
+    float distance = glm::length(offset);
+
+    // one sphere already contains the other
+    if (distance + other.m_radius <= m_radius)
+        return;
+    if (distance + m_radius <= other.m_radius) {
+        *this = other;
+        return;
+    }
+
+    float radius = (distance + m_radius + other.m_radius) * 0.5f;
+    m_center += offset * ((radius - m_radius) / distance);
+    m_radius = radius;
+}
+
+BoundingSphere BoundingSphere::transform(const glm::mat4& matrix) const {
+    if (m_radius < 0.0f)
+        return *this;
+
+    float scale = std::max(glm::length(glm::vec3(matrix[0])),
+                  std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+
+    return BoundingSphere(glm::vec3(matrix * glm::vec4(m_center, 1.0f)), m_radius * scale);
+}
+
+BoundingSphere BoundingSphere::fromPoints(const std::vector<glm::vec3>& points) {
+    if (points.empty())
+        return BoundingSphere();
+
+    glm::vec3 center = AABB::fromPoints(points).getCenter();
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < points.size(); ++i) {
+        glm::vec3 offset = points[i] - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+
+    return BoundingSphere(center, std::sqrt(radiusSquared));
+}
+
+
+Frustum::Frustum() {}
+
+Frustum Frustum::fromMatrix(const glm::mat4& projectionView) {
+    // glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+    }
+
+    Frustum frustum;
+    frustum.m_planes[PLANE_LEFT] = rows[3] + rows[0];
+    frustum.m_planes[PLANE_RIGHT] = rows[3] - rows[0];
+    frustum.m_planes[PLANE_BOTTOM] = rows[3] + rows[1];
+    frustum.m_planes[PLANE_TOP] = rows[3] - rows[1];
+    frustum.m_planes[PLANE_NEAR] = rows[3] + rows[2];
+    frustum.m_planes[PLANE_FAR] = rows[3] - rows[2];
+
+    for (int i = 0; i < PLANE_COUNT; ++i) {
+        float length = glm::length(glm::vec3(frustum.m_planes[i]));
+        if (length > 0.0f)
+            frustum.m_planes[i] /= length;
+    }
+
+    return frustum;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    for (int i = 0; i < PLANE_COUNT; ++i) {
+        if (glm::dot(glm::vec3(m_planes[i]), sphere.m_center) + m_planes[i].w < -sphere.m_radius)
+            return false;
+    }
+
+    return true;
+}
+
+bool Frustum::intersects(const AABB& box) const {
+    glm::vec3 center = box.getCenter();
+    glm::vec3 extents = box.getExtents();
+
+    for (int i = 0; i < PLANE_COUNT; ++i) {
+        glm::vec3 normal = glm::vec3(m_planes[i]);
+        float radius = glm::dot(extents, glm::abs(normal));
+        if (glm::dot(normal, center) + m_planes[i].w < -radius)
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct BoundingSphere;
+
+/** Axis aligned bounding box */
+struct AABB {
+    glm::vec3 m_min;
+    glm::vec3 m_max;
+
+    AABB();
+    AABB(const glm::vec3& min, const glm::vec3& max);
+
+    glm::vec3 getCenter() const { return (m_min + m_max) * 0.5f; }
+    glm::vec3 getExtents() const { return (m_max - m_min) * 0.5f; }
+    bool isEmpty() const { return m_min.x > m_max.x || m_min.y > m_max.y || m_min.z > m_max.z; }
+
+    float getSurfaceArea() const;
+    bool contains(const AABB& other) const;
+    bool intersects(const AABB& other) const;
+    bool intersects(const BoundingSphere& sphere) const;
+
+    /** Slab test. On a hit, the entry distance along the ray (0 if the origin is inside) is written to distance. */
+    bool intersectsRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const;
+
+    /** Grow the box to contain another one */
+    void merge(const AABB& other);
+
+    /** The box containing this one after the transformation */
+    AABB transform(const glm::mat4& matrix) const;
+
+    /** The smallest box containing the points. Empty if there are none. */
+    static AABB fromPoints(const std::vector<glm::vec3>& points);
+
+    /** The union of two boxes */
+    static AABB combine(const AABB& a, const AABB& b);
+};
+
+/** Bounding sphere, a cheaper and rotation invariant test than the box */
+struct BoundingSphere {
+    glm::vec3 m_center;
+    float m_radius;
+
+    BoundingSphere();
+    BoundingSphere(const glm::vec3& center, float radius);
+
+    /** Grow the sphere to contain another one */
+    void merge(const BoundingSphere& other);
+
+    /** The sphere containing this one after the transformation. Non-uniform scale uses the largest axis. */
+    BoundingSphere transform(const glm::mat4& matrix) const;
+
+    /** A sphere around the points, centered on their bounding box (not the minimal sphere, but close for most meshes) */
+    static BoundingSphere fromPoints(const std::vector<glm::vec3>& points);
+};
+
+/** The six planes of a view frustum, facing inwards */
+class Frustum {
+public:
+    enum Plane {
+        PLANE_LEFT = 0,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP,
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_COUNT
+    };
+
+    Frustum();
+
+    /** Extract the planes of a projection * view matrix (Gribb & Hartmann), normalized so plane distances are world units */
+    static Frustum fromMatrix(const glm::mat4& projectionView);
+
+    /** Plane as (normal, distance), where dot(normal, p) + distance >= 0 for points inside */
+    const glm::vec4& getPlane(int plane) const { return m_planes[plane]; }
+
+    bool intersects(const BoundingSphere& sphere) const;
+    bool intersects(const AABB& box) const;
+private:
+    glm::vec4 m_planes[PLANE_COUNT];
+};
+
+#endif
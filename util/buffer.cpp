@@ -5,6 +5,7 @@ VBO::VBO() {
 }
 
 VBO::~VBO() {
+    GLState::forgetBuffer(m_id);
     GLCheck(glDeleteBuffers(1, &m_id));
 }
 
@@ -14,6 +15,7 @@ VAO::VAO() {
 }
 
 VAO::~VAO() {
+    GLState::forgetVertexArray(m_id);
     GLCheck(glDeleteVertexArrays(1, &m_id));
 }
 
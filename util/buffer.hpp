@@ -5,6 +5,7 @@
 #include <memory>
 #include <GL/glew.h>
 #include "utility.hpp"
+#include "glstate.hpp"
 
 /** Defines a vertex buffer object (VBO) */
 class VBO {
@@ -20,12 +21,10 @@ private:
     VBO& operator=(const VBO&);
 };
 
+/** Binds through the state cache. The buffer stays bound after the scope, so binding it again is free. */
 class glBindBufferState {
 public:
-    glBindBufferState(GLenum target, GLuint buffer) : m_target(target) { GLCheck(glBindBuffer(m_target, buffer)); }
-    ~glBindBufferState() { GLCheck(glBindBuffer(m_target, 0)); }
-private:
-    GLenum m_target;
+    glBindBufferState(GLenum target, GLuint buffer) { GLState::bindBuffer(target, buffer); }
 };
 
 /** Defines a vertex array object (VAO) */
@@ -42,10 +41,10 @@ private:
     VAO& operator=(const VAO&);
 };
 
+/** Binds through the state cache. The vertex array stays bound after the scope, so binding it again is free. */
 class glBindVertexArrayState {
 public:
-    glBindVertexArrayState(GLuint id) { GLCheck(glBindVertexArray(id)); }
-    ~glBindVertexArrayState() { GLCheck(glBindVertexArray(0)); }
+    glBindVertexArrayState(GLuint id) { GLState::bindVertexArray(id); }
 };
 
 #endif
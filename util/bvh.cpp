@@ -0,0 +1,393 @@
+#include "bvh.hpp"
+#include <r2tk/r2-assert.hpp>
+#include <algorithm>
+
+// Below this fraction of moved leaves, commitUpdates reinserts them instead of refitting the whole tree
+static const float REINSERT_FRACTION = 0.25f;
+
+DynamicAABBTree::DynamicAABBTree(float margin)
+    : m_root(NULL_NODE)
+    , m_freeList(NULL_NODE)
+    , m_leafCount(0)
+    , m_margin(margin) {}
+
+int DynamicAABBTree::insert(const AABB& bounds, size_t userData) {
+    int leaf = allocateNode();
+    m_nodes[leaf].m_bounds = fatten(bounds);
+    m_nodes[leaf].m_userData = userData;
+    m_nodes[leaf].m_height = 0;
+
+    insertLeaf(leaf);
+    ++m_leafCount;
+
+    return leaf;
+}
+
+void DynamicAABBTree::remove(int proxy) {
+    r2AssertM(proxy >= 0 && proxy < (int) m_nodes.size() && m_nodes[proxy].isLeaf(), "Invalid proxy");
+
+    // drop any queued move, the proxy may be reused by the next insert
+    for (size_t i = 0; i < m_pendingUpdates.size(); ) {
+        if (m_pendingUpdates[i].m_proxy == proxy) {
+            m_pendingUpdates[i] = m_pendingUpdates.back();
+            m_pendingUpdates.pop_back();
+        } else {
+            ++i;
+        }
+    }
+
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --m_leafCount;
+}
+
+bool DynamicAABBTree::update(int proxy, const AABB& bounds) {
+    r2AssertM(proxy >= 0 && proxy < (int) m_nodes.size() && m_nodes[proxy].isLeaf(), "Invalid proxy");
+
+    if (m_nodes[proxy].m_bounds.contains(bounds))
+        return false;
+
+    removeLeaf(proxy);
+    m_nodes[proxy].m_bounds = fatten(bounds);
+    insertLeaf(proxy);
+
+    return true;
+}
+
+void DynamicAABBTree::deferUpdate(int proxy, const AABB& bounds) {
+    r2AssertM(proxy >= 0 && proxy < (int) m_nodes.size() && m_nodes[proxy].isLeaf(), "Invalid proxy");
+
+    if (m_nodes[proxy].m_bounds.contains(bounds))
+        return;
+
+    PendingUpdate pending = { proxy, bounds };
+    m_pendingUpdates.push_back(pending);
+}
+
+void DynamicAABBTree::commitUpdates() {
+    if (m_pendingUpdates.empty())
+        return;
+
+    if (m_pendingUpdates.size() < m_leafCount * REINSERT_FRACTION) {
+        for (size_t i = 0; i < m_pendingUpdates.size(); ++i) {
+            update(m_pendingUpdates[i].m_proxy, m_pendingUpdates[i].m_bounds);
+        }
+    } else {
+        for (size_t i = 0; i < m_pendingUpdates.size(); ++i) {
+            m_nodes[m_pendingUpdates[i].m_proxy].m_bounds = fatten(m_pendingUpdates[i].m_bounds);
+        }
+
+        refitAll();
+    }
+
+    m_pendingUpdates.clear();
+}
+
+void DynamicAABBTree::queryFrustum(const Frustum& frustum, std::vector<size_t>& results) const {
+    if (m_root == NULL_NODE)
+        return;
+
+    // each stack entry carries a mask of the planes its parent wasn't entirely inside of, since
+    // a child can't cross a plane its parent is inside. Once the mask is empty, the whole subtree is visible.
+    const int ALL_PLANES = (1 << Frustum::PLANE_COUNT) - 1;
+
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    m_stack.push_back(ALL_PLANES);
+    while (!m_stack.empty()) {
+        int mask = m_stack.back();
+        m_stack.pop_back();
+        int index = m_stack.back();
+        m_stack.pop_back();
+
+        const Node& node = m_nodes[index];
+        if (mask != 0) {
+            glm::vec3 center = node.m_bounds.getCenter();
+            glm::vec3 extents = node.m_bounds.getExtents();
+
+            bool outside = false;
+            for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+                if ((mask & (1 << p)) == 0)
+                    continue;
+
+                const glm::vec4& plane = frustum.getPlane(p);
+                float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+                float radius = glm::dot(extents, glm::abs(glm::vec3(plane)));
+                if (distance < -radius) {
+                    outside = true;
+                    break;
+                }
+                if (distance >= radius)
+                    mask &= ~(1 << p);
+            }
+
+            if (outside)
+                continue;
+        }
+
+        if (node.isLeaf()) {
+            results.push_back(node.m_userData);
+        } else {
+            m_stack.push_back(node.m_left);
+            m_stack.push_back(mask);
+            m_stack.push_back(node.m_right);
+            m_stack.push_back(mask);
+        }
+    }
+}
+
+void DynamicAABBTree::querySphere(const BoundingSphere& sphere, std::vector<size_t>& results) const {
+    if (m_root == NULL_NODE)
+        return;
+
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty()) {
+        const Node& node = m_nodes[m_stack.back()];
+        m_stack.pop_back();
+
+        if (!node.m_bounds.intersects(sphere))
+            continue;
+
+        if (node.isLeaf()) {
+            results.push_back(node.m_userData);
+        } else {
+            m_stack.push_back(node.m_left);
+            m_stack.push_back(node.m_right);
+        }
+    }
+}
+
+void DynamicAABBTree::queryAABB(const AABB& bounds, std::vector<size_t>& results) const {
+    if (m_root == NULL_NODE)
+        return;
+
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty()) {
+        const Node& node = m_nodes[m_stack.back()];
+        m_stack.pop_back();
+
+        if (!node.m_bounds.intersects(bounds))
+            continue;
+
+        if (node.isLeaf()) {
+            results.push_back(node.m_userData);
+        } else {
+            m_stack.push_back(node.m_left);
+            m_stack.push_back(node.m_right);
+        }
+    }
+}
+
+int DynamicAABBTree::allocateNode() {
+    if (m_freeList == NULL_NODE) {
+        Node node;
+        node.m_parent = NULL_NODE;
+        node.m_height = -1;
+        m_nodes.push_back(node);
+        m_freeList = m_nodes.size() - 1;
+    }
+
+    int index = m_freeList;
+    m_freeList = m_nodes[index].m_parent;
+
+    Node& node = m_nodes[index];
+    node.m_userData = 0;
+    node.m_parent = NULL_NODE;
+    node.m_left = NULL_NODE;
+    node.m_right = NULL_NODE;
+    node.m_height = 0;
+
+    return index;
+}
+
+void DynamicAABBTree::freeNode(int node) {
+    m_nodes[node].m_parent = m_freeList;
+    m_nodes[node].m_height = -1;
+    m_freeList = node;
+}
+
+void DynamicAABBTree::insertLeaf(int leaf) {
+    if (m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].m_parent = NULL_NODE;
+        return;
+    }
+
+    // descend to the sibling that minimizes the added surface area
+    const AABB leafBounds = m_nodes[leaf].m_bounds;
+    int index = m_root;
+    while (!m_nodes[index].isLeaf()) {
+        const Node& node = m_nodes[index];
+        float area = node.m_bounds.getSurfaceArea();
+        float combinedArea = AABB::combine(node.m_bounds, leafBounds).getSurfaceArea();
+
+        // cost of making a new parent for this node and the leaf, and the increase pushed down to the children
+        float cost = 2.0f * combinedArea;
+        float inheritedCost = 2.0f * (combinedArea - area);
+
+        float childCosts[2];
+        int children[2] = { node.m_left, node.m_right };
+        for (int c = 0; c < 2; ++c) {
+            const Node& child = m_nodes[children[c]];
+            float childArea = AABB::combine(child.m_bounds, leafBounds).getSurfaceArea();
+            if (child.isLeaf())
+                childCosts[c] = childArea + inheritedCost;
+            else
+                childCosts[c] = childArea - child.m_bounds.getSurfaceArea() + inheritedCost;
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1])
+            break;
+
+        index = (childCosts[0] < childCosts[1]) ? children[0] : children[1];
+    }
+
+    // replace the sibling with a new parent of it and the leaf
+    int sibling = index;
+    int oldParent = m_nodes[sibling].m_parent;
+    int newParent = allocateNode();
+    m_nodes[newParent].m_parent = oldParent;
+    m_nodes[newParent].m_bounds = AABB::combine(leafBounds, m_nodes[sibling].m_bounds);
+    m_nodes[newParent].m_height = m_nodes[sibling].m_height + 1;
+    m_nodes[newParent].m_left = sibling;
+    m_nodes[newParent].m_right = leaf;
+    m_nodes[sibling].m_parent = newParent;
+    m_nodes[leaf].m_parent = newParent;
+
+    if (oldParent == NULL_NODE) {
+        m_root = newParent;
+    } else if (m_nodes[oldParent].m_left == sibling) {
+        m_nodes[oldParent].m_left = newParent;
+    } else {
+        m_nodes[oldParent].m_right = newParent;
+    }
+
+    refitAncestors(m_nodes[leaf].m_parent);
+}
+
+void DynamicAABBTree::removeLeaf(int leaf) {
+    if (leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    // the sibling takes the place of the parent
+    int parent = m_nodes[leaf].m_parent;
+    int grandParent = m_nodes[parent].m_parent;
+    int sibling = (m_nodes[parent].m_left == leaf) ? m_nodes[parent].m_right : m_nodes[parent].m_left;
+
+    m_nodes[sibling].m_parent = grandParent;
+    freeNode(parent);
+
+    if (grandParent == NULL_NODE) {
+        m_root = sibling;
+        return;
+    }
+
+    if (m_nodes[grandParent].m_left == parent) {
+        m_nodes[grandParent].m_left = sibling;
+    } else {
+        m_nodes[grandParent].m_right = sibling;
+    }
+
+    refitAncestors(grandParent);
+}
+
+void DynamicAABBTree::refitAncestors(int node) {
+    while (node != NULL_NODE) {
+        node = balance(node);
+
+        Node& current = m_nodes[node];
+        const Node& left = m_nodes[current.m_left];
+        const Node& right = m_nodes[current.m_right];
+        current.m_bounds = AABB::combine(left.m_bounds, right.m_bounds);
+        current.m_height = 1 + std::max(left.m_height, right.m_height);
+
+        node = current.m_parent;
+    }
+}
+
+int DynamicAABBTree::balance(int a) {
+    // rotate the taller grandchild up when the children of a differ by more than one in height.
+    // Returns the node that took the place of a.
+    Node& nodeA = m_nodes[a];
+    if (nodeA.isLeaf() || nodeA.m_height < 2)
+        return a;
+
+    int b = nodeA.m_left;
+    int c = nodeA.m_right;
+    int difference = m_nodes[c].m_height - m_nodes[b].m_height;
+    if (difference >= -1 && difference <= 1)
+        return a;
+
+    // the taller child rises, its taller child stays with it and the shorter one moves to a
+    int up = (difference > 0) ? c : b;
+    int down = (difference > 0) ? b : c;
+    Node& nodeUp = m_nodes[up];
+    int f = nodeUp.m_left;
+    int g = nodeUp.m_right;
+
+    nodeUp.m_left = a;
+    nodeUp.m_parent = nodeA.m_parent;
+    nodeA.m_parent = up;
+
+    if (nodeUp.m_parent == NULL_NODE) {
+        m_root = up;
+    } else if (m_nodes[nodeUp.m_parent].m_left == a) {
+        m_nodes[nodeUp.m_parent].m_left = up;
+    } else {
+        m_nodes[nodeUp.m_parent].m_right = up;
+    }
+
+    int keep = (m_nodes[f].m_height > m_nodes[g].m_height) ? f : g;
+    int move = (keep == f) ? g : f;
+
+    nodeUp.m_right = keep;
+    if (difference > 0) {
+        nodeA.m_right = move;
+    } else {
+        nodeA.m_left = move;
+    }
+    m_nodes[move].m_parent = a;
+
+    nodeA.m_bounds = AABB::combine(m_nodes[down].m_bounds, m_nodes[move].m_bounds);
+    nodeA.m_height = 1 + std::max(m_nodes[down].m_height, m_nodes[move].m_height);
+    nodeUp.m_bounds = AABB::combine(nodeA.m_bounds, m_nodes[keep].m_bounds);
+    nodeUp.m_height = 1 + std::max(nodeA.m_height, m_nodes[keep].m_height);
+
+    return up;
+}
+
+void DynamicAABBTree::refitAll() {
+    if (m_root == NULL_NODE)
+        return;
+
+    // a preorder visits parents before children, so walking it backwards refits children first
+    std::vector<int> order;
+    order.reserve(m_nodes.size());
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty()) {
+        int index = m_stack.back();
+        m_stack.pop_back();
+
+        order.push_back(index);
+        if (!m_nodes[index].isLeaf()) {
+            m_stack.push_back(m_nodes[index].m_left);
+            m_stack.push_back(m_nodes[index].m_right);
+        }
+    }
+
+    for (size_t i = order.size(); i-- > 0; ) {
+        Node& node = m_nodes[order[i]];
+        if (!node.isLeaf())
+            node.m_bounds = AABB::combine(m_nodes[node.m_left].m_bounds, m_nodes[node.m_right].m_bounds);
+    }
+}
+
+AABB DynamicAABBTree::fatten(const AABB& bounds) const {
+    glm::vec3 margin(m_margin);
+    return AABB(bounds.m_min - margin, bounds.m_max + margin);
+}
@@ -0,0 +1,119 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.hpp"
+
+/**
+ * A dynamic bounding volume hierarchy of AABBs (in the style of Box2D's b2DynamicTree).
+ * Leaves store fattened bounds, so objects that move a little don't touch the tree at all.
+ * Leaves are inserted by the surface area heuristic and the tree is kept balanced with rotations.
+ */
+class DynamicAABBTree {
+public:
+    static const int NULL_NODE = -1;
+
+    /** The margin is added on every side of the leaf bounds */
+    explicit DynamicAABBTree(float margin = 0.1f);
+
+    /** Insert a leaf and return its proxy, which stays valid until the leaf is removed */
+    int insert(const AABB& bounds, size_t userData);
+    void remove(int proxy);
+
+    /** Move a leaf immediately. Returns false if the bounds still fit in the fat bounds, so nothing changed. */
+    bool update(int proxy, const AABB& bounds);
+
+    /**
+     * Queue a move until commitUpdates. Useful when many leaves move in the same tick: the queued leaves
+     * are either reinserted one by one or, when they are a large part of the tree, resized in place and the
+     * whole tree refitted in one bottom-up pass, which is cheaper but keeps the old topology.
+     */
+    void deferUpdate(int proxy, const AABB& bounds);
+    void commitUpdates();
+
+    /** Collect the user data of the leaves intersecting the volume */
+    void queryFrustum(const Frustum& frustum, std::vector<size_t>& results) const;
+    void querySphere(const BoundingSphere& sphere, std::vector<size_t>& results) const;
+    void queryAABB(const AABB& bounds, std::vector<size_t>& results) const;
+
+    /**
+     * Visit the leaves whose bounds the ray hits, in no particular order. The callback is called as
+     * callback(userData, entryDistance) and returns the new maximum distance, so returning the distance
+     * of an exact hit finds the closest one and returning maxDistance visits them all.
+     */
+    template <class Callback>
+    void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback& callback) const;
+
+    size_t getUserData(int proxy) const { return m_nodes[proxy].m_userData; }
+    const AABB& getFatBounds(int proxy) const { return m_nodes[proxy].m_bounds; }
+    size_t getLeafCount() const { return m_leafCount; }
+    int getHeight() const { return (m_root == NULL_NODE) ? 0 : m_nodes[m_root].m_height; }
+private:
+    struct Node {
+        AABB m_bounds;
+        size_t m_userData;
+        int m_parent;   // The next free node while the node is on the free list
+        int m_left;
+        int m_right;
+        int m_height;   // Leaves are 0, free nodes -1
+
+        bool isLeaf() const { return m_left == NULL_NODE; }
+    };
+
+    struct PendingUpdate {
+        int m_proxy;
+        AABB m_bounds;
+    };
+
+    std::vector<Node> m_nodes;
+    int m_root;
+    int m_freeList;
+    size_t m_leafCount;
+    float m_margin;
+
+    std::vector<PendingUpdate> m_pendingUpdates;
+    mutable std::vector<int> m_stack;
+
+    int allocateNode();
+    void freeNode(int node);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+
+    /** Recompute the bounds and heights from the node up to the root, rotating on the way */
+    void refitAncestors(int node);
+    int balance(int node);
+    void refitAll();
+
+    AABB fatten(const AABB& bounds) const;
+};
+
+template <class Callback>
+void DynamicAABBTree::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback& callback) const {
+    if (m_root == NULL_NODE)
+        return;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty()) {
+        int index = m_stack.back();
+        m_stack.pop_back();
+
+        const Node& node = m_nodes[index];
+        float distance;
+        if (!node.m_bounds.intersectsRay(origin, inverseDirection, maxDistance, distance))
+            continue;
+
+        if (node.isLeaf()) {
+            maxDistance = callback(node.m_userData, distance);
+        } else {
+            m_stack.push_back(node.m_left);
+            m_stack.push_back(node.m_right);
+        }
+    }
+}
+
+#endif
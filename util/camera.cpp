@@ -1,6 +1,8 @@
 #include "camera.hpp"
 
-Camera::Camera() {}
+Camera::Camera()
+    : m_viewportWidth(0)
+    , m_viewportHeight(0) {}
 
 
 void Camera::setProjection(const glm::mat4& projection) {
@@ -19,6 +21,11 @@ void Camera::setPosition(const glm::vec3& position) {
     m_position = position;
 }
 
+void Camera::setViewport(int width, int height) {
+    m_viewportWidth = width;
+    m_viewportHeight = height;
+}
+
 
 void Camera::commit() {
     glm::vec3 z = -glm::normalize(m_facing);
@@ -35,6 +42,7 @@ void Camera::commit() {
                        -glm::dot(x, m_position), -glm::dot(y, m_position), -glm::dot(z, m_position), 1);
 
     m_projectionView = m_projection * m_view;
+    m_frustum = Frustum::fromMatrix(m_projectionView);
 }
 
 glm::mat4 Camera::createPerspectiveProjection(float near, float far, float fovY, float aspect) {
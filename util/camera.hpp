@@ -2,6 +2,7 @@
 #define CAMERA_HPP
 
 #include <glm/glm.hpp>
+#include "bounds.hpp"
 
 class Camera {
 public:
@@ -11,6 +12,7 @@ public:
     void setUp(const glm::vec3& up);
     void setFacing(const glm::vec3& facing);
     void setPosition(const glm::vec3& position);
+    void setViewport(int width, int height);
 
     void commit();
 
@@ -20,6 +22,9 @@ public:
     const glm::mat4& getView() const { return m_view; }
     const glm::mat4& getProjection() const { return m_projection; }
     const glm::mat4& getProjectionView() const { return m_projectionView; }
+    const Frustum& getFrustum() const { return m_frustum; }
+    int getViewportWidth() const { return m_viewportWidth; }
+    int getViewportHeight() const { return m_viewportHeight; }
 
     static glm::mat4 createPerspectiveProjection(float near, float far, float fovY, float aspect);
 private:
@@ -30,6 +35,10 @@ private:
     glm::mat4 m_view; 
     glm::mat4 m_projection;
     glm::mat4 m_projectionView;
+    Frustum m_frustum;
+
+    int m_viewportWidth;
+    int m_viewportHeight;
 };
 
 #endif
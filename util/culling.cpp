@@ -0,0 +1,87 @@
+#include "culling.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+SphereCuller::SphereCuller()
+    : m_count(0) {}
+
+void SphereCuller::clear() {
+    m_count = 0;
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_radius.clear();
+    m_visible.clear();
+}
+
+size_t SphereCuller::add(const BoundingSphere& sphere) {
+    // overwrite the padding if there is some, otherwise grow by a whole batch
+    if (m_count == m_x.size()) {
+        m_x.resize(m_count + 4, 0.0f);
+        m_y.resize(m_count + 4, 0.0f);
+        m_z.resize(m_count + 4, 0.0f);
+        m_radius.resize(m_count + 4, -1.0f);
+        m_visible.resize(m_count + 4, 0);
+    }
+
+    m_x[m_count] = sphere.m_center.x;
+    m_y[m_count] = sphere.m_center.y;
+    m_z[m_count] = sphere.m_center.z;
+    m_radius[m_count] = sphere.m_radius;
+
+    return m_count++;
+}
+
+CullStats SphereCuller::cull(const Frustum& frustum) {
+    CullStats stats;
+    stats.m_tested = m_count;
+
+#ifdef CULLING_SSE
+    __m128 planes[Frustum::PLANE_COUNT][4];
+    for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+        const glm::vec4& plane = frustum.getPlane(p);
+        for (int c = 0; c < 4; ++c) {
+            planes[p][c] = _mm_set1_ps(plane[c]);
+        }
+    }
+
+    for (size_t i = 0; i < m_x.size(); i += 4) {
+        __m128 x = _mm_loadu_ps(&m_x[i]);
+        __m128 y = _mm_loadu_ps(&m_y[i]);
+        __m128 z = _mm_loadu_ps(&m_z[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_radius[i]));
+
+        // a sphere is visible if it is not entirely behind any of the planes
+        __m128 inside = _mm_cmpge_ps(_mm_loadu_ps(&m_radius[i]), _mm_setzero_ps());
+        for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planes[p][0]), _mm_mul_ps(y, planes[p][1])),
+                                         _mm_add_ps(_mm_mul_ps(z, planes[p][2]), planes[p][3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int j = 0; j < 4; ++j) {
+            m_visible[i + j] = (unsigned char) ((mask >> j) & 1);
+        }
+    }
+#else
+    for (size_t i = 0; i < m_count; ++i) {
+        bool inside = m_radius[i] >= 0.0f;
+        for (int p = 0; p < Frustum::PLANE_COUNT && inside; ++p) {
+            const glm::vec4& plane = frustum.getPlane(p);
+            inside = plane.x * m_x[i] + plane.y * m_y[i] + plane.z * m_z[i] + plane.w >= -m_radius[i];
+        }
+
+        m_visible[i] = inside ? 1 : 0;
+    }
+#endif
+
+    for (size_t i = 0; i < m_count; ++i) {
+        stats.m_visible += m_visible[i];
+    }
+
+    return stats;
+}
@@ -0,0 +1,49 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <vector>
+#include "bounds.hpp"
+
+/** The outcome of a culling pass */
+struct CullStats {
+    size_t m_tested;
+    size_t m_visible;
+
+    CullStats() : m_tested(0), m_visible(0) {}
+
+    size_t getCulled() const { return m_tested - m_visible; }
+};
+
+/**
+ * Tests a batch of world space bounding spheres against a frustum. The spheres are stored as
+ * structure of arrays so four of them are tested against a plane at once with SSE, where available.
+ */
+class SphereCuller {
+public:
+    SphereCuller();
+
+    /** Remove all spheres, keeping the storage */
+    void clear();
+
+    /** Add a sphere and return its index */
+    size_t add(const BoundingSphere& sphere);
+
+    /** Test every sphere against the frustum */
+    CullStats cull(const Frustum& frustum);
+
+    /** Whether the sphere intersected the frustum in the last cull */
+    bool isVisible(size_t index) const { return m_visible[index] != 0; }
+
+    size_t getCount() const { return m_count; }
+private:
+    size_t m_count;
+
+    // padded to a multiple of four, with spheres that are always culled
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_radius;
+    std::vector<unsigned char> m_visible;
+};
+
+#endif
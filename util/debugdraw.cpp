@@ -0,0 +1,90 @@
+#include "debugdraw.hpp"
+#include "programcache.hpp"
+#include "glstate.hpp"
+#include <cstring>
+
+static const char* VERTEX_SHADER =
+    "#version 400\n"
+    "layout(location=0) in vec3 in_PositionW;\n"
+    "layout(location=1) in vec3 in_Color;\n"
+    "out vec3 ex_Color;\n"
+    "uniform mat4 g_ProjectionView;\n"
+    "void main() {\n"
+    "    ex_Color = in_Color;\n"
+    "    gl_Position = g_ProjectionView * vec4(in_PositionW, 1.0);\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER =
+    "#version 400\n"
+    "in vec3 ex_Color;\n"
+    "out vec4 out_Color;\n"
+    "void main() {\n"
+    "    out_Color = vec4(ex_Color, 1.0);\n"
+    "}\n";
+
+DebugDraw::DebugDraw(StreamBuffer& stream)
+    : m_stream(stream) {
+    std::vector<ProgramCache::Source> sources;
+    sources.push_back(ProgramCache::Source(GL_VERTEX_SHADER, VERTEX_SHADER));
+    sources.push_back(ProgramCache::Source(GL_FRAGMENT_SHADER, FRAGMENT_SHADER));
+    m_program = ProgramCache::get(sources);
+
+    glBindVertexArrayState vaoState(m_VAO.getId());
+    GLCheck(glEnableVertexAttribArray(0));
+    GLCheck(glEnableVertexAttribArray(1));
+}
+
+void DebugDraw::addLine(const glm::vec3& from, const glm::vec3& to, const glm::vec3& color) {
+    Vertex vertex = { from, color };
+    m_vertices.push_back(vertex);
+    vertex.m_position = to;
+    m_vertices.push_back(vertex);
+}
+
+void DebugDraw::addAABB(const AABB& bounds, const glm::vec3& color) {
+    if (bounds.isEmpty())
+        return;
+
+    // the corners are numbered by which of x, y and z are at the maximum, in bits 0, 1 and 2
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; ++i) {
+        corners[i] = glm::vec3((i & 1) ? bounds.m_max.x : bounds.m_min.x,
+                               (i & 2) ? bounds.m_max.y : bounds.m_min.y,
+                               (i & 4) ? bounds.m_max.z : bounds.m_min.z);
+    }
+
+    // every edge connects two corners differing in one bit
+    for (int i = 0; i < 8; ++i) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if ((i & bit) == 0)
+                addLine(corners[i], corners[i | bit], color);
+        }
+    }
+}
+
+void DebugDraw::draw(const glm::mat4& projectionView) {
+    if (m_vertices.empty())
+        return;
+
+    size_t size = m_vertices.size() * sizeof(Vertex);
+    StreamBuffer::Allocation allocation = m_stream.allocate(size);
+    memcpy(allocation.m_data, &m_vertices[0], size);
+    m_stream.flush();
+
+    // looked up at the first draw, so the program can link in the background until then
+    if (!m_projectionViewUniform)
+        m_projectionViewUniform.reset(new Uniform<glm::mat4>(*m_program, "g_ProjectionView"));
+
+    GLState::useProgram(m_program->getId());
+    m_projectionViewUniform->set(projectionView);
+
+    GLState::bindVertexArray(m_VAO.getId());
+    {
+        glBindBufferState bufferState(GL_ARRAY_BUFFER, allocation.m_buffer);
+        GLCheck(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*) allocation.m_offset));
+        GLCheck(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*) (allocation.m_offset + sizeof(glm::vec3))));
+    }
+
+    GLCheck(glDrawArrays(GL_LINES, 0, (GLsizei) m_vertices.size()));
+    m_vertices.clear();
+}
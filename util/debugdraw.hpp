@@ -0,0 +1,41 @@
+#ifndef DEBUGDRAW_HPP
+#define DEBUGDRAW_HPP
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+#include "buffer.hpp"
+#include "bounds.hpp"
+#include "shader.hpp"
+#include "streambuffer.hpp"
+
+/** Colored lines queued during a frame and drawn together, with the vertices written to a stream buffer */
+class DebugDraw {
+public:
+    explicit DebugDraw(StreamBuffer& stream);
+
+    void addLine(const glm::vec3& from, const glm::vec3& to, const glm::vec3& color);
+    void addAABB(const AABB& bounds, const glm::vec3& color);
+
+    /** Draw everything queued since the last call, in world space, and clear the queue */
+    void draw(const glm::mat4& projectionView);
+
+    size_t getLineCount() const { return m_vertices.size() / 2; }
+private:
+    struct Vertex {
+        glm::vec3 m_position;
+        glm::vec3 m_color;
+    };
+
+    StreamBuffer& m_stream;
+    std::vector<Vertex> m_vertices;
+
+    std::shared_ptr<Program> m_program;
+    std::unique_ptr<Uniform<glm::mat4> > m_projectionViewUniform;
+    VAO m_VAO;
+
+    DebugDraw(const DebugDraw&);
+    DebugDraw& operator=(const DebugDraw&);
+};
+
+#endif
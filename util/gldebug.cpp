@@ -0,0 +1,79 @@
+#include "gldebug.hpp"
+#include "utility.hpp"
+#include <GL/glew.h>
+#include <iostream>
+
+const char* GLDebug::s_file = NULL;
+int GLDebug::s_line = 0;
+size_t GLDebug::s_calls = 0;
+GLDebug::Severity GLDebug::s_minimumSeverity = GLDebug::SEVERITY_LOW;
+
+static const char* getSourceName(GLenum source) {
+    switch (source) {
+    case GL_DEBUG_SOURCE_API: return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION: return "application";
+    default: return "other";
+    }
+}
+
+static const char* getTypeName(GLenum type) {
+    switch (type) {
+    case GL_DEBUG_TYPE_ERROR: return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+    default: return "other";
+    }
+}
+
+static GLDebug::Severity getSeverity(GLenum severity) {
+    switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH: return GLDebug::SEVERITY_HIGH;
+    case GL_DEBUG_SEVERITY_MEDIUM: return GLDebug::SEVERITY_MEDIUM;
+    case GL_DEBUG_SEVERITY_LOW: return GLDebug::SEVERITY_LOW;
+    default: return GLDebug::SEVERITY_NOTIFICATION;
+    }
+}
+
+// the KHR and ARB enums have the same values, so one callback serves both
+static void GLAPIENTRY onDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, GLvoid* userParam) {
+    GLDebug::report(getSeverity(severity), getSourceName(source), getTypeName(type), id, message);
+}
+
+bool GLDebug::install(Severity minimumSeverity) {
+    s_minimumSeverity = minimumSeverity;
+
+    // synchronous output calls back before the offending call returns, so the location is still the current one
+    if (GLEW_VERSION_4_3 || GLEW_KHR_debug) {
+        GLCheck(glEnable(GL_DEBUG_OUTPUT));
+        GLCheck(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+        GLCheck(glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE));
+        GLCheck(glDebugMessageCallback((GLDEBUGPROC) onDebugMessage, NULL));
+        return true;
+    }
+
+    if (GLEW_ARB_debug_output) {
+        GLCheck(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB));
+        GLCheck(glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE));
+        GLCheck(glDebugMessageCallbackARB((GLDEBUGPROCARB) onDebugMessage, NULL));
+        return true;
+    }
+
+    return false;
+}
+
+void GLDebug::report(Severity severity, const char* source, const char* type, unsigned int id, const char* message) {
+    if (severity < s_minimumSeverity)
+        return;
+
+    static const char* SEVERITY_NAMES[] = { "NOTE", "LOW", "MEDIUM", "HIGH" };
+
+    std::cerr << "GL " << SEVERITY_NAMES[severity] << " " << type << " (" << source << ", " << id << ")";
+    if (s_file != NULL)
+        std::cerr << " at " << s_file << ":" << s_line;
+    std::cerr << ": " << message << std::endl;
+}
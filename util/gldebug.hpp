@@ -0,0 +1,41 @@
+#ifndef GLDEBUG_HPP
+#define GLDEBUG_HPP
+
+#include <cstddef>
+
+/**
+ * Backs the GLCheck macro. With UTIL_GL_DEBUG, the messages of a debug context are delivered
+ * synchronously to a callback, which reports them with the location of the GLCheck that was
+ * running. With UTIL_GL_PROFILE, or either of the checking options, GLCheck counts the calls.
+ */
+class GLDebug {
+public:
+    enum Severity {
+        SEVERITY_NOTIFICATION = 0,
+        SEVERITY_LOW,
+        SEVERITY_MEDIUM,
+        SEVERITY_HIGH
+    };
+
+    /** Register the callback through KHR_debug or ARB_debug_output. Returns false if the context has neither. */
+    static bool install(Severity minimumSeverity = SEVERITY_LOW);
+
+    /** Messages below the severity are dropped */
+    static void setMinimumSeverity(Severity severity) { s_minimumSeverity = severity; }
+
+    static void markCall(const char* file, int line) { s_file = file; s_line = line; ++s_calls; }
+    static void countCall() { ++s_calls; }
+
+    static size_t getCallCount() { return s_calls; }
+    static void resetCallCount() { s_calls = 0; }
+
+    /** Report a message, unless it is below the minimum severity */
+    static void report(Severity severity, const char* source, const char* type, unsigned int id, const char* message);
+private:
+    static const char* s_file;
+    static int s_line;
+    static size_t s_calls;
+    static Severity s_minimumSeverity;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#include "glextensions.hpp"
+#include <GL/glfw.h>
+
+PFNGLBUFFERSTORAGEPROC GLExtensions::s_bufferStorage = NULL;
+PFNGLGETTEXTURESAMPLERHANDLEARBPROC GLExtensions::s_getTextureSamplerHandle = NULL;
+PFNGLMAKETEXTUREHANDLERESIDENTARBPROC GLExtensions::s_makeTextureHandleResident = NULL;
+PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC GLExtensions::s_makeTextureHandleNonResident = NULL;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC GLExtensions::s_maxShaderCompilerThreads = NULL;
+
+void GLExtensions::load() {
+    s_bufferStorage = isAvailable(4, 4, "GL_ARB_buffer_storage") ? (PFNGLBUFFERSTORAGEPROC) glfwGetProcAddress("glBufferStorage") : NULL;
+
+    s_getTextureSamplerHandle = NULL;
+    if (glfwExtensionSupported("GL_ARB_bindless_texture") == GL_TRUE) {
+        s_makeTextureHandleResident = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC) glfwGetProcAddress("glMakeTextureHandleResidentARB");
+        s_makeTextureHandleNonResident = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC) glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+
+        // only report support once every entry point is there
+        if (s_makeTextureHandleResident != NULL && s_makeTextureHandleNonResident != NULL)
+            s_getTextureSamplerHandle = (PFNGLGETTEXTURESAMPLERHANDLEARBPROC) glfwGetProcAddress("glGetTextureSamplerHandleARB");
+    }
+
+    s_maxShaderCompilerThreads = NULL;
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile") == GL_TRUE)
+        s_maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile") == GL_TRUE)
+        s_maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+}
+
+bool GLExtensions::isAvailable(int major, int minor, const char* extension) {
+    int contextMajor, contextMinor, contextRevision;
+    glfwGetGLVersion(&contextMajor, &contextMinor, &contextRevision);
+
+    if (contextMajor > major || (contextMajor == major && contextMinor >= minor))
+        return true;
+
+    return glfwExtensionSupported(extension) == GL_TRUE;
+}
@@ -0,0 +1,67 @@
+#ifndef GLEXTENSIONS_HPP
+#define GLEXTENSIONS_HPP
+
+#include <GL/glew.h>
+
+// GL 4.4 / ARB_buffer_storage, which the bundled GLEW predates
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+typedef void (GLAPIENTRY * PFNGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const GLvoid* data, GLbitfield flags);
+
+// ARB_bindless_texture, likewise
+#ifndef GL_ARB_bindless_texture
+typedef GLuint64 (GLAPIENTRY * PFNGLGETTEXTURESAMPLERHANDLEARBPROC) (GLuint texture, GLuint sampler);
+typedef void (GLAPIENTRY * PFNGLMAKETEXTUREHANDLERESIDENTARBPROC) (GLuint64 handle);
+typedef void (GLAPIENTRY * PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC) (GLuint64 handle);
+#endif
+
+// KHR_parallel_shader_compile (or its ARB twin, which shares the enums)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (GLAPIENTRY * PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) (GLuint count);
+
+/**
+ * Entry points newer than the bundled GLEW, loaded through GLFW once the context exists.
+ * Each one is only available if the context's version or extensions offer it.
+ */
+class GLExtensions {
+public:
+    /** Called by LabApplication::createContext, after GLEW has been initialized */
+    static void load();
+
+    static bool hasBufferStorage() { return s_bufferStorage != NULL; }
+    static void bufferStorage(GLenum target, GLsizeiptr size, const GLvoid* data, GLbitfield flags) { s_bufferStorage(target, size, data, flags); }
+
+    /** ARB_bindless_texture, which is not part of any core version */
+    static bool hasBindlessTexture() { return s_getTextureSamplerHandle != NULL; }
+    static GLuint64 getTextureSamplerHandle(GLuint texture, GLuint sampler) { return s_getTextureSamplerHandle(texture, sampler); }
+    static void makeTextureHandleResident(GLuint64 handle) { s_makeTextureHandleResident(handle); }
+    static void makeTextureHandleNonResident(GLuint64 handle) { s_makeTextureHandleNonResident(handle); }
+
+    /**
+     * KHR_parallel_shader_compile or ARB_parallel_shader_compile. Compiles and links then run on driver threads,
+     * and GL_COMPLETION_STATUS_KHR tells whether one is done without waiting for it.
+     */
+    static bool hasParallelShaderCompile() { return s_maxShaderCompilerThreads != NULL; }
+    /** 0xFFFFFFFF lets the driver pick the number of threads, 0 compiles on the calling thread */
+    static void maxShaderCompilerThreads(GLuint count) { s_maxShaderCompilerThreads(count); }
+private:
+    static PFNGLBUFFERSTORAGEPROC s_bufferStorage;
+    static PFNGLGETTEXTURESAMPLERHANDLEARBPROC s_getTextureSamplerHandle;
+    static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC s_makeTextureHandleResident;
+    static PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC s_makeTextureHandleNonResident;
+    static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC s_maxShaderCompilerThreads;
+
+    /** Whether the context is at least the version or reports the extension */
+    static bool isAvailable(int major, int minor, const char* extension);
+};
+
+#endif
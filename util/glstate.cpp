@@ -0,0 +1,227 @@
+#include "glstate.hpp"
+
+GLuint GLState::s_program = GLState::UNKNOWN;
+GLuint GLState::s_vertexArray = GLState::UNKNOWN;
+GLuint GLState::s_buffers[BUFFER_TARGET_COUNT];
+GLState::BufferRange GLState::s_uniformBindings[MAX_BUFFER_BINDINGS];
+GLuint GLState::s_activeUnit = GLState::UNKNOWN;
+GLuint GLState::s_textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+GLuint GLState::s_samplers[MAX_TEXTURE_UNITS];
+GLState::Stats GLState::s_stats;
+
+/** Starts out not knowing any binding */
+static struct GLStateInitializer {
+    GLStateInitializer() { GLState::invalidate(); }
+} s_initializer;
+
+void GLState::useProgram(GLuint program) {
+    if (change(s_program, program)) {
+        GLCheck(glUseProgram(program));
+    }
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+    if (change(s_vertexArray, vertexArray)) {
+        GLCheck(glBindVertexArray(vertexArray));
+
+        // the element array binding belongs to the vertex array
+        s_buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    int index = getBufferTarget(target);
+    if (index < 0) {
+        ++s_stats.m_issued;
+        GLCheck(glBindBuffer(target, buffer));
+        return;
+    }
+
+    if (change(s_buffers[index], buffer)) {
+        GLCheck(glBindBuffer(target, buffer));
+    }
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    if (target != GL_UNIFORM_BUFFER || index >= MAX_BUFFER_BINDINGS) {
+        ++s_stats.m_issued;
+        GLCheck(glBindBufferBase(target, index, buffer));
+        s_buffers[BUFFER_UNIFORM] = UNKNOWN;
+        return;
+    }
+
+    BufferRange& binding = s_uniformBindings[index];
+    if (binding.m_buffer == buffer && binding.m_size == -1) {
+        ++s_stats.m_filtered;
+        return;
+    }
+
+    ++s_stats.m_issued;
+    GLCheck(glBindBufferBase(target, index, buffer));
+    binding.m_buffer = buffer;
+    binding.m_offset = 0;
+    binding.m_size = -1;
+    s_buffers[BUFFER_UNIFORM] = buffer;
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    if (target != GL_UNIFORM_BUFFER || index >= MAX_BUFFER_BINDINGS) {
+        ++s_stats.m_issued;
+        GLCheck(glBindBufferRange(target, index, buffer, offset, size));
+        s_buffers[BUFFER_UNIFORM] = UNKNOWN;
+        return;
+    }
+
+    BufferRange& binding = s_uniformBindings[index];
+    if (binding.m_buffer == buffer && binding.m_offset == offset && binding.m_size == size) {
+        ++s_stats.m_filtered;
+        return;
+    }
+
+    ++s_stats.m_issued;
+    GLCheck(glBindBufferRange(target, index, buffer, offset, size));
+    binding.m_buffer = buffer;
+    binding.m_offset = offset;
+    binding.m_size = size;
+    s_buffers[BUFFER_UNIFORM] = buffer;
+}
+
+void GLState::activeTexture(GLuint unit) {
+    if (change(s_activeUnit, unit)) {
+        GLCheck(glActiveTexture(GL_TEXTURE0 + unit));
+    }
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int index = getTextureTarget(target);
+    if (unit >= MAX_TEXTURE_UNITS || index < 0) {
+        s_stats.m_issued += 2;
+        GLCheck(glActiveTexture(GL_TEXTURE0 + unit));
+        GLCheck(glBindTexture(target, texture));
+        s_activeUnit = unit;
+        return;
+    }
+
+    if (!change(s_textures[unit][index], texture))
+        return;
+
+    if (change(s_activeUnit, unit)) {
+        GLCheck(glActiveTexture(GL_TEXTURE0 + unit));
+    }
+
+    GLCheck(glBindTexture(target, texture));
+}
+
+void GLState::bindSampler(GLuint unit, GLuint sampler) {
+    if (unit >= MAX_TEXTURE_UNITS) {
+        ++s_stats.m_issued;
+        GLCheck(glBindSampler(unit, sampler));
+        return;
+    }
+
+    if (change(s_samplers[unit], sampler)) {
+        GLCheck(glBindSampler(unit, sampler));
+    }
+}
+
+void GLState::invalidate() {
+    s_program = UNKNOWN;
+    s_vertexArray = UNKNOWN;
+    s_activeUnit = UNKNOWN;
+
+    for (int i = 0; i < BUFFER_TARGET_COUNT; ++i) {
+        s_buffers[i] = UNKNOWN;
+    }
+
+    for (GLuint i = 0; i < MAX_BUFFER_BINDINGS; ++i) {
+        s_uniformBindings[i].m_buffer = UNKNOWN;
+        s_uniformBindings[i].m_offset = 0;
+        s_uniformBindings[i].m_size = 0;
+    }
+
+    for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit) {
+        for (int i = 0; i < TEXTURE_TARGET_COUNT; ++i) {
+            s_textures[unit][i] = UNKNOWN;
+        }
+
+        s_samplers[unit] = UNKNOWN;
+    }
+}
+
+void GLState::forgetProgram(GLuint program) {
+    // a deleted program stays in use until another one is, so only the name has to be forgotten
+    if (s_program == program)
+        s_program = UNKNOWN;
+}
+
+void GLState::forgetVertexArray(GLuint vertexArray) {
+    if (s_vertexArray == vertexArray) {
+        s_vertexArray = 0;
+        s_buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN;
+    }
+}
+
+void GLState::forgetBuffer(GLuint buffer) {
+    for (int i = 0; i < BUFFER_TARGET_COUNT; ++i) {
+        if (s_buffers[i] == buffer)
+            s_buffers[i] = 0;
+    }
+
+    for (GLuint i = 0; i < MAX_BUFFER_BINDINGS; ++i) {
+        if (s_uniformBindings[i].m_buffer == buffer)
+            s_uniformBindings[i].m_buffer = UNKNOWN;
+    }
+}
+
+void GLState::forgetTexture(GLuint texture) {
+    for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit) {
+        for (int i = 0; i < TEXTURE_TARGET_COUNT; ++i) {
+            if (s_textures[unit][i] == texture)
+                s_textures[unit][i] = 0;
+        }
+    }
+}
+
+void GLState::forgetSampler(GLuint sampler) {
+    for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit) {
+        if (s_samplers[unit] == sampler)
+            s_samplers[unit] = 0;
+    }
+}
+
+int GLState::getBufferTarget(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_ELEMENT_ARRAY;
+        case GL_UNIFORM_BUFFER: return BUFFER_UNIFORM;
+        case GL_COPY_READ_BUFFER: return BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER: return BUFFER_COPY_WRITE;
+        case GL_PIXEL_PACK_BUFFER: return BUFFER_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER: return BUFFER_PIXEL_UNPACK;
+        case GL_DRAW_INDIRECT_BUFFER: return BUFFER_DRAW_INDIRECT;
+        case GL_TEXTURE_BUFFER: return BUFFER_TEXTURE;
+        default: return -1;
+    }
+}
+
+int GLState::getTextureTarget(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return TEXTURE_2D;
+        case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+        case GL_TEXTURE_3D: return TEXTURE_3D;
+        case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER;
+        default: return -1;
+    }
+}
+
+bool GLState::change(GLuint& current, GLuint value) {
+    if (current == value) {
+        ++s_stats.m_filtered;
+        return false;
+    }
+
+    ++s_stats.m_issued;
+    current = value;
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+#include <GL/glew.h>
+#include "utility.hpp"
+
+/**
+ * Shadows the program, vertex array, buffer, texture and sampler bindings of the context and skips
+ * calls that wouldn't change them. All binding in util and the labs goes through here; GL calls
+ * made around it must be followed by invalidate. Deleted objects must be forgotten, since GL
+ * unbinds them and may reuse their names.
+ */
+class GLState {
+public:
+    struct Stats {
+        size_t m_issued;        // Calls that reached GL
+        size_t m_filtered;      // Calls skipped because the binding was already current
+
+        Stats() : m_issued(0), m_filtered(0) {}
+    };
+
+    static const GLuint MAX_TEXTURE_UNITS = 32;
+    static const GLuint MAX_BUFFER_BINDINGS = 16;
+
+    static void useProgram(GLuint program);
+    static void bindVertexArray(GLuint vertexArray);
+    static void bindBuffer(GLenum target, GLuint buffer);
+
+    /** Indexed uniform buffer bindings. Like GL, these also bind the generic GL_UNIFORM_BUFFER target. */
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    /** Select the unit that texture calls without a unit parameter (glTexImage2D, glGenerateMipmap, ...) act on */
+    static void activeTexture(GLuint unit);
+
+    /** Bind a texture to a unit, only switching the active unit when something has to be bound */
+    static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    static void bindSampler(GLuint unit, GLuint sampler);
+
+    /** Forget everything, so the next bind of each kind reaches GL */
+    static void invalidate();
+
+    /** Drop a deleted object from the shadowed bindings */
+    static void forgetProgram(GLuint program);
+    static void forgetVertexArray(GLuint vertexArray);
+    static void forgetBuffer(GLuint buffer);
+    static void forgetTexture(GLuint texture);
+    static void forgetSampler(GLuint sampler);
+
+    static const Stats& getStats() { return s_stats; }
+    static void resetStats() { s_stats = Stats(); }
+private:
+    enum BufferTarget {
+        BUFFER_ARRAY = 0,
+        BUFFER_ELEMENT_ARRAY,       // Part of the vertex array state
+        BUFFER_UNIFORM,
+        BUFFER_COPY_READ,
+        BUFFER_COPY_WRITE,
+        BUFFER_PIXEL_PACK,
+        BUFFER_PIXEL_UNPACK,
+        BUFFER_DRAW_INDIRECT,
+        BUFFER_TEXTURE,
+        BUFFER_TARGET_COUNT
+    };
+
+    enum TextureTarget {
+        TEXTURE_2D = 0,
+        TEXTURE_2D_ARRAY,
+        TEXTURE_CUBE_MAP,
+        TEXTURE_3D,
+        TEXTURE_BUFFER,
+        TEXTURE_TARGET_COUNT
+    };
+
+    struct BufferRange {
+        GLuint m_buffer;
+        GLintptr m_offset;
+        GLsizeiptr m_size;      // -1 for the whole buffer
+    };
+
+    static const GLuint UNKNOWN = ~0u;
+
+    static GLuint s_program;
+    static GLuint s_vertexArray;
+    static GLuint s_buffers[BUFFER_TARGET_COUNT];
+    static BufferRange s_uniformBindings[MAX_BUFFER_BINDINGS];
+    static GLuint s_activeUnit;
+    static GLuint s_textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+    static GLuint s_samplers[MAX_TEXTURE_UNITS];
+    static Stats s_stats;
+
+    static int getBufferTarget(GLenum target);
+    static int getTextureTarget(GLenum target);
+
+    /** Count the call and return whether it has to be issued */
+    static bool change(GLuint& current, GLuint value);
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "lightgrid.hpp"
+#include "glstate.hpp"
+#include "textureunits.hpp"
+#include <cmath>
+#include <algorithm>
+#include <r2tk/r2-exception.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHTGRID_SSE
+#include <xmmintrin.h>
+#endif
+
+#ifdef LIGHTGRID_SSE
+/** The number of set bits of a four bit mask, as returned by _mm_movemask_ps */
+static const int BIT_COUNT[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+#endif
+
+/** Respecify the buffer and fill it. A texture buffer needs at least one texel, so it is never left empty. */
+static void uploadBuffer(GLuint buffer, const void* data, size_t size, size_t texelSize) {
+    glBindBufferState bufferState(GL_TEXTURE_BUFFER, buffer);
+    GLCheck(glBufferData(GL_TEXTURE_BUFFER, std::max(size, texelSize), NULL, GL_STREAM_DRAW));
+    if (size > 0) {
+        GLCheck(glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data));
+    }
+}
+
+/** Create a texture viewing the buffer */
+static GLuint createBufferTexture(GLuint buffer, GLenum format, size_t texelSize) {
+    uploadBuffer(buffer, NULL, 0, texelSize);
+
+    GLuint texture;
+    GLCheck(glGenTextures(1, &texture));
+    GLState::bindTexture(TextureUnits::UPLOAD_UNIT, GL_TEXTURE_BUFFER, texture);
+    GLCheck(glTexBuffer(GL_TEXTURE_BUFFER, format, buffer));
+
+    return texture;
+}
+
+static void deleteTexture(GLuint texture) {
+    GLState::forgetTexture(texture);
+    GLCheck(glDeleteTextures(1, &texture));
+}
+
+LightGrid::LightGrid(GLuint tilesX, GLuint tilesY, GLuint slices)
+    : m_tilesX(tilesX)
+    , m_tilesY(tilesY)
+    , m_slices(slices)
+    , m_clusterScale(0.0f) {
+    if (tilesX == 0 || tilesY == 0 || slices == 0)
+        throw r2ExceptionArgumentM("A light grid needs at least one cluster along every axis");
+
+    m_lightTexture = createBufferTexture(m_lightBuffer.getId(), GL_RGBA32F, sizeof(glm::vec4));
+    m_clusterTexture = createBufferTexture(m_clusterBuffer.getId(), GL_RG32UI, 2 * sizeof(GLuint));
+    m_indexTexture = createBufferTexture(m_indexBuffer.getId(), GL_R32UI, sizeof(GLuint));
+}
+
+LightGrid::~LightGrid() {
+    deleteTexture(m_lightTexture);
+    deleteTexture(m_clusterTexture);
+    deleteTexture(m_indexTexture);
+}
+
+void LightGrid::clear() {
+    m_lights.clear();
+}
+
+size_t LightGrid::add(const glm::vec3& positionW, float radius, const glm::vec3& intensity) {
+    if (radius <= 0.0f)
+        throw r2ExceptionArgumentM("A light needs a positive radius to be binned");
+
+    Light light = { positionW, radius, intensity };
+    m_lights.push_back(light);
+
+    return m_lights.size() - 1;
+}
+
+void LightGrid::update(const Camera& camera) {
+    // the depth range of the projection, from its third column
+    const glm::mat4& projection = camera.getProjection();
+    float near = projection[3][2] / (projection[2][2] - 1.0f);
+    float far = projection[3][2] / (projection[2][2] + 1.0f);
+    setupPlanes(projection, near, far);
+
+    float logDepthRange = std::log(far / near);
+    m_clusterScale = glm::vec4((float) m_tilesX / std::max(camera.getViewportWidth(), 1),
+                               (float) m_tilesY / std::max(camera.getViewportHeight(), 1),
+                               m_slices / logDepthRange,
+                               -(m_slices * std::log(near)) / logDepthRange);
+
+    m_stats = Stats();
+    m_stats.m_lights = m_lights.size();
+
+    // transform every light, since the indices refer to them all, and find the clusters of the visible ones
+    m_ranges.clear();
+    m_lightData.resize(m_lights.size() * 2);
+    for (size_t i = 0; i < m_lights.size(); ++i) {
+        const Light& light = m_lights[i];
+        glm::vec3 centerV = glm::vec3(camera.getView() * glm::vec4(light.m_positionW, 1.0f));
+        m_lightData[i * 2] = glm::vec4(centerV, light.m_radius);
+        m_lightData[i * 2 + 1] = glm::vec4(light.m_intensity, 0.0f);
+
+        if (!camera.getFrustum().intersects(BoundingSphere(light.m_positionW, light.m_radius)))
+            continue;
+
+        Range range;
+        range.m_light = i;
+        bool touches = true;
+        for (int axis = 0; axis < AXIS_COUNT && touches; ++axis) {
+            touches = findRange(axis, centerV, light.m_radius, range.m_min[axis], range.m_max[axis]);
+        }
+
+        if (touches)
+            m_ranges.push_back(range);
+    }
+    m_stats.m_visible = m_ranges.size();
+
+    // count the lights of every cluster, then give each cluster its part of the index list
+    m_clusters.assign(getClusterCount() * 2, 0);
+    for (size_t i = 0; i < m_ranges.size(); ++i) {
+        const Range& range = m_ranges[i];
+        for (GLuint z = range.m_min[AXIS_Z]; z <= range.m_max[AXIS_Z]; ++z) {
+            for (GLuint y = range.m_min[AXIS_Y]; y <= range.m_max[AXIS_Y]; ++y) {
+                for (GLuint x = range.m_min[AXIS_X]; x <= range.m_max[AXIS_X]; ++x) {
+                    ++m_clusters[(x + m_tilesX * (y + m_tilesY * z)) * 2 + 1];
+                }
+            }
+        }
+    }
+
+    GLuint offset = 0;
+    for (size_t cluster = 0; cluster < getClusterCount(); ++cluster) {
+        GLuint count = m_clusters[cluster * 2 + 1];
+        m_clusters[cluster * 2] = offset;
+        offset += count;
+
+        if (count > 0)
+            ++m_stats.m_occupied;
+        m_stats.m_maxPerCluster = std::max<size_t>(m_stats.m_maxPerCluster, count);
+
+        // counted up again as the indices are written
+        m_clusters[cluster * 2 + 1] = 0;
+    }
+    m_stats.m_indices = offset;
+
+    m_indices.resize(offset);
+    for (size_t i = 0; i < m_ranges.size(); ++i) {
+        const Range& range = m_ranges[i];
+        for (GLuint z = range.m_min[AXIS_Z]; z <= range.m_max[AXIS_Z]; ++z) {
+            for (GLuint y = range.m_min[AXIS_Y]; y <= range.m_max[AXIS_Y]; ++y) {
+                for (GLuint x = range.m_min[AXIS_X]; x <= range.m_max[AXIS_X]; ++x) {
+                    GLuint* cluster = &m_clusters[(x + m_tilesX * (y + m_tilesY * z)) * 2];
+                    m_indices[cluster[0] + cluster[1]++] = (GLuint) range.m_light;
+                }
+            }
+        }
+    }
+
+    upload();
+}
+
+void LightGrid::bind(GLuint lightUnit, GLuint clusterUnit, GLuint indexUnit) const {
+    GLState::bindTexture(lightUnit, GL_TEXTURE_BUFFER, m_lightTexture);
+    GLState::bindTexture(clusterUnit, GL_TEXTURE_BUFFER, m_clusterTexture);
+    GLState::bindTexture(indexUnit, GL_TEXTURE_BUFFER, m_indexTexture);
+}
+
+void LightGrid::setupPlanes(const glm::mat4& projection, float near, float far) {
+    std::vector<glm::vec4> planes[AXIS_COUNT];
+
+    // x = a * w in clip space is a plane through the eye, positive to the right of (or above) the boundary
+    glm::vec4 rows[3];
+    for (int row = 0; row < 3; ++row) {
+        rows[row] = glm::vec4(projection[0][row], projection[1][row], projection[2][row], projection[3][row]);
+    }
+    glm::vec4 wRow(projection[0][3], projection[1][3], projection[2][3], projection[3][3]);
+
+    for (GLuint i = 1; i < m_tilesX; ++i) {
+        planes[AXIS_X].push_back(rows[0] - (-1.0f + 2.0f * i / m_tilesX) * wRow);
+    }
+    for (GLuint i = 1; i < m_tilesY; ++i) {
+        planes[AXIS_Y].push_back(rows[1] - (-1.0f + 2.0f * i / m_tilesY) * wRow);
+    }
+
+    // the slices are spaced evenly in log depth, so clusters stay roughly cube shaped; positive beyond the boundary
+    for (GLuint i = 1; i < m_slices; ++i) {
+        float depth = near * std::pow(far / near, (float) i / m_slices);
+        planes[AXIS_Z].push_back(glm::vec4(0.0f, 0.0f, -1.0f, -depth));
+    }
+
+    for (int axis = 0; axis < AXIS_COUNT; ++axis) {
+        m_planeCount[axis] = planes[axis].size();
+
+        size_t padded = (planes[axis].size() + 3) & ~3;
+        for (int c = 0; c < 4; ++c) {
+            m_planes[axis][c].assign(padded, 0.0f);
+        }
+
+        // normalized, so the distances are in view space units
+        for (size_t i = 0; i < planes[axis].size(); ++i) {
+            glm::vec4 plane = planes[axis][i] / glm::length(glm::vec3(planes[axis][i]));
+            for (int c = 0; c < 4; ++c) {
+                m_planes[axis][c][i] = plane[c];
+            }
+        }
+    }
+}
+
+bool LightGrid::findRange(int axis, const glm::vec3& center, float radius, GLuint& first, GLuint& last) const {
+    // the boundaries are in order, so the sphere starts after those it is entirely beyond
+    // and ends before those it is entirely in front of
+    int beyond = 0;
+    int before = 0;
+    const std::vector<float>* planes = m_planes[axis];
+
+#ifdef LIGHTGRID_SSE
+    __m128 x = _mm_set1_ps(center.x);
+    __m128 y = _mm_set1_ps(center.y);
+    __m128 z = _mm_set1_ps(center.z);
+    __m128 positiveRadius = _mm_set1_ps(radius);
+    __m128 negativeRadius = _mm_set1_ps(-radius);
+
+    for (size_t i = 0; i < planes[0].size(); i += 4) {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_loadu_ps(&planes[0][i])), _mm_mul_ps(y, _mm_loadu_ps(&planes[1][i]))),
+                                     _mm_add_ps(_mm_mul_ps(z, _mm_loadu_ps(&planes[2][i])), _mm_loadu_ps(&planes[3][i])));
+        beyond += BIT_COUNT[_mm_movemask_ps(_mm_cmpge_ps(distance, positiveRadius))];
+        before += BIT_COUNT[_mm_movemask_ps(_mm_cmple_ps(distance, negativeRadius))];
+    }
+#else
+    for (size_t i = 0; i < planes[0].size(); ++i) {
+        float distance = planes[0][i] * center.x + planes[1][i] * center.y + planes[2][i] * center.z + planes[3][i];
+        if (distance >= radius)
+            ++beyond;
+        else if (distance <= -radius)
+            ++before;
+    }
+#endif
+
+    first = beyond;
+    last = m_planeCount[axis] - before;
+
+    return first <= last;
+}
+
+void LightGrid::upload() {
+    // respecified every frame, like the Frame block, so the driver can hand out new storage while the last frame draws
+    uploadBuffer(m_lightBuffer.getId(), m_lightData.empty() ? NULL : &m_lightData[0], m_lightData.size() * sizeof(glm::vec4), sizeof(glm::vec4));
+    uploadBuffer(m_clusterBuffer.getId(), &m_clusters[0], m_clusters.size() * sizeof(GLuint), 2 * sizeof(GLuint));
+    uploadBuffer(m_indexBuffer.getId(), m_indices.empty() ? NULL : &m_indices[0], m_indices.size() * sizeof(GLuint), sizeof(GLuint));
+}
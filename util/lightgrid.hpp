@@ -0,0 +1,124 @@
+#ifndef LIGHTGRID_HPP
+#define LIGHTGRID_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "buffer.hpp"
+#include "camera.hpp"
+
+/**
+ * Bins point lights into the clusters of the view frustum for clustered forward shading: the screen is cut
+ * into tiles and the depth range into slices that grow exponentially with the distance, so a fragment only
+ * loops over the lights of its own cluster. Binning runs on the CPU every frame; each light is tested against
+ * the boundary planes of the tiles and slices, four planes at once with SSE where available, which gives the
+ * range of clusters its sphere touches along each axis.
+ *
+ * The results are uploaded to three texture buffers, for contexts without storage buffers:
+ * the lights as two RGBA32F texels each (view space position and radius, then intensity), the clusters as
+ * an RG32UI texel each (first index and count, x varying fastest, then y, then slice) and the light indices
+ * as R32UI. A fragment finds its cluster from gl_FragCoord and its view depth with getClusterScale.
+ */
+class LightGrid {
+public:
+    struct Stats {
+        size_t m_lights;
+        size_t m_visible;           // Lights in the frustum, binned into at least one cluster
+        size_t m_indices;           // Light references over all clusters
+        size_t m_occupied;          // Clusters with at least one light
+        size_t m_maxPerCluster;
+
+        Stats() : m_lights(0), m_visible(0), m_indices(0), m_occupied(0), m_maxPerCluster(0) {}
+    };
+
+    /** The number of tiles across and up the screen, and of depth slices */
+    LightGrid(GLuint tilesX = 16, GLuint tilesY = 9, GLuint slices = 24);
+    ~LightGrid();
+
+    /** Remove all lights, keeping the storage */
+    void clear();
+
+    /** Add a light and return its index. Its intensity falls off to zero at the radius. */
+    size_t add(const glm::vec3& positionW, float radius, const glm::vec3& intensity);
+
+    void setPosition(size_t index, const glm::vec3& positionW) { m_lights[index].m_positionW = positionW; }
+
+    /** Bin the lights into the clusters of the camera and upload them. Needs a perspective projection. */
+    void update(const Camera& camera);
+
+    /** Bind the light, cluster and index buffers to three texture units */
+    void bind(GLuint lightUnit, GLuint clusterUnit, GLuint indexUnit) const;
+
+    /**
+     * Maps a fragment to its cluster: tile = gl_FragCoord.xy * xy and slice = log(depth) * z + w,
+     * with depth the positive view space distance along the view direction
+     */
+    const glm::vec4& getClusterScale() const { return m_clusterScale; }
+
+    GLuint getTilesX() const { return m_tilesX; }
+    GLuint getTilesY() const { return m_tilesY; }
+    GLuint getSlices() const { return m_slices; }
+    size_t getClusterCount() const { return (size_t) m_tilesX * m_tilesY * m_slices; }
+    size_t getLightCount() const { return m_lights.size(); }
+
+    /** The stats of the last update */
+    const Stats& getStats() const { return m_stats; }
+private:
+    struct Light {
+        glm::vec3 m_positionW;
+        float m_radius;
+        glm::vec3 m_intensity;
+    };
+
+    /** The clusters a visible light touches, inclusive */
+    struct Range {
+        size_t m_light;
+        GLuint m_min[3];
+        GLuint m_max[3];
+    };
+
+    enum Axis {
+        AXIS_X = 0,
+        AXIS_Y,
+        AXIS_Z,
+        AXIS_COUNT
+    };
+
+    GLuint m_tilesX;
+    GLuint m_tilesY;
+    GLuint m_slices;
+
+    std::vector<Light> m_lights;
+    glm::vec4 m_clusterScale;
+    Stats m_stats;
+
+    // the interior boundaries between the tiles or slices of each axis, in order, as structure of arrays
+    // padded to a multiple of four with zero planes, which no sphere is entirely on either side of
+    std::vector<float> m_planes[AXIS_COUNT][4];
+    GLuint m_planeCount[AXIS_COUNT];
+
+    std::vector<Range> m_ranges;
+    std::vector<GLuint> m_clusters;         // First index and count per cluster
+    std::vector<GLuint> m_indices;
+    std::vector<glm::vec4> m_lightData;
+
+    VBO m_lightBuffer;
+    VBO m_clusterBuffer;
+    VBO m_indexBuffer;
+    GLuint m_lightTexture;
+    GLuint m_clusterTexture;
+    GLuint m_indexTexture;
+
+    /** Find the boundary planes of the tiles and slices in view space */
+    void setupPlanes(const glm::mat4& projection, float near, float far);
+
+    /** The clusters along the axis that the view space sphere touches. Returns false if it misses them all. */
+    bool findRange(int axis, const glm::vec3& center, float radius, GLuint& first, GLuint& last) const;
+
+    void upload();
+
+    LightGrid(const LightGrid&);
+    LightGrid& operator=(const LightGrid&);
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "mappedfile.hpp"
+#include <r2tk/r2-exception.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename)
+    : m_data(NULL)
+    , m_size(0)
+    , m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(NULL) {
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        throw r2ExceptionIOM("Failed to open file for mapping: " + filename);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size)) {
+        CloseHandle(m_file);
+        throw r2ExceptionIOM("Failed to get size of file: " + filename);
+    }
+    m_size = (size_t) size.QuadPart;
+
+    // an empty file cannot be mapped, but is still a valid (empty) view
+    if (m_size == 0)
+        return;
+
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping != NULL)
+        m_data = (const unsigned char*) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (m_data == NULL) {
+        if (m_mapping != NULL)
+            CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw r2ExceptionIOM("Failed to map file: " + filename);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != NULL)
+        UnmapViewOfFile(m_data);
+    if (m_mapping != NULL)
+        CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename)
+    : m_data(NULL)
+    , m_size(0)
+    , m_file(-1) {
+    m_file = open(filename.c_str(), O_RDONLY);
+    if (m_file == -1) {
+        throw r2ExceptionIOM("Failed to open file for mapping: " + filename);
+    }
+
+    struct stat status;
+    if (fstat(m_file, &status) != 0) {
+        close(m_file);
+        throw r2ExceptionIOM("Failed to get size of file: " + filename);
+    }
+    m_size = (size_t) status.st_size;
+
+    // an empty file cannot be mapped, but is still a valid (empty) view
+    if (m_size == 0)
+        return;
+
+    void* data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (data == MAP_FAILED) {
+        close(m_file);
+        throw r2ExceptionIOM("Failed to map file: " + filename);
+    }
+
+    m_data = (const unsigned char*) data;
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != NULL)
+        munmap((void*) m_data, m_size);
+    close(m_file);
+}
+
+#endif
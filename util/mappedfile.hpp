@@ -0,0 +1,30 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+#include <cstddef>
+
+/** Maps a whole file read-only into memory for the lifetime of the object */
+class MappedFile {
+public:
+    MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    const unsigned char* getData() const { return m_data; }
+    size_t getSize() const { return m_size; }
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_file;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+#endif
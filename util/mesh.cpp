@@ -1,31 +1,278 @@
 #include "mesh.hpp"
+#include "mappedfile.hpp"
+#include "simplifier.hpp"
 #include <r2tk/r2-exception.hpp>
 #include <fstream>
 #include <sstream>
+#include <iostream>
 #include <limits>
 #include <vector>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
-struct GroupData {
-    std::string m_material;
-    std::vector<glm::vec4> m_vertices;
-    std::vector<glm::vec4> m_normals;
-    std::vector<glm::vec2> m_texCoords;
+/** Identifies a unique v/t/n triple in a face definition */
+struct VertexKey {
+    int m_vertex;
+    int m_texCoord;
+    int m_normal;
+
+    bool operator==(const VertexKey& other) const {
+        return m_vertex == other.m_vertex && m_texCoord == other.m_texCoord && m_normal == other.m_normal;
+    }
 };
 
-std::shared_ptr<Mesh> Mesh::loadOBJ(const std::string& filename) {
-    std::shared_ptr<Mesh> mesh(new Mesh);
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        size_t hash = std::hash<int>()(key.m_vertex);
+        hash ^= std::hash<int>()(key.m_texCoord) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<int>()(key.m_normal) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+};
+
+typedef std::unordered_map<VertexKey, GLuint, VertexKeyHash> VertexLookup;
+
+
+/*
+ * Binary cache layout. All offsets are from the start of the file and the vertex and
+ * index blobs are aligned to CACHE_ALIGNMENT, so they can be uploaded straight from a
+ * mapping of the file.
+ *
+ *  CacheHeader
+ *  CacheGroup[m_groupCount]
+ *  strings (material library, group names, material names)
+ *  vertex and index blobs
+ */
+static const char CACHE_MAGIC[4] = { 'R', '2', 'M', 'C' };
+static const uint32_t CACHE_VERSION = 3;
+static const size_t CACHE_ALIGNMENT = 16;
+static const size_t CACHE_MAX_ATTRIBUTES = 8;
+static const size_t CACHE_MAX_LODS = 8;
+
+struct CacheAttribute {
+    uint32_t m_semantic;
+    uint32_t m_components;
+    uint32_t m_type;
+    uint32_t m_normalized;
+};
+
+struct CacheHeader {
+    char m_magic[4];
+    uint32_t m_version;
+    uint64_t m_sourceHash;
+    uint64_t m_sourceSize;
+
+    uint32_t m_attributeCount;
+    uint32_t m_stride;
+    CacheAttribute m_attributes[CACHE_MAX_ATTRIBUTES];
+
+    uint32_t m_mtlLibraryOffset;
+    uint32_t m_mtlLibraryLength;
+    uint32_t m_groupCount;
+    uint32_t m_padding;
+};
+
+struct CacheLod {
+    uint32_t m_indexOffset;
+    uint32_t m_indexCount;
+    float m_error;
+    uint32_t m_padding;
+};
+
+struct CacheGroup {
+    uint32_t m_nameOffset;
+    uint32_t m_nameLength;
+    uint32_t m_materialOffset;
+    uint32_t m_materialLength;
+
+    uint32_t m_vertexCount;
+    uint32_t m_indexCount;
+    uint32_t m_indexType;
+    uint32_t m_padding;
+
+    uint64_t m_vertexOffset;
+    uint64_t m_vertexSize;
+    uint64_t m_indexOffset;
+    uint64_t m_indexSize;
+
+    uint32_t m_lodCount;
+    uint32_t m_padding2[3];
+    CacheLod m_lods[CACHE_MAX_LODS];
+
+    float m_boundsMin[3];
+    float m_boundsMax[3];
+    float m_sphereCenter[3];
+    float m_sphereRadius;
+    uint32_t m_padding3[2];
+};
+
+/** Whether the range lies within [0, total), checked so the end can't wrap around */
+static bool isInRange(uint64_t offset, uint64_t size, uint64_t total) {
+    return offset <= total && size <= total - offset;
+}
+
+/** FNV-1a hash of a file's contents. Returns false if the file could not be read. */
+static bool hashFile(const std::string& filename, uint64_t& hash, uint64_t& size) {
+    std::ifstream fs(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!fs.is_open())
+        return false;
+
+    hash = 14695981039346656037ULL;
+    size = 0;
+
+    char buffer[4096];
+    while (fs.read(buffer, sizeof(buffer)) || fs.gcount() > 0) {
+        std::streamsize count = fs.gcount();
+        for (std::streamsize i = 0; i < count; ++i) {
+            hash ^= (unsigned char) buffer[i];
+            hash *= 1099511628211ULL;
+        }
+
+        size += count;
+    }
+
+    return true;
+}
+
+/** Interleave the vertices of a group according to the format */
+static std::vector<unsigned char> packVertices(const Mesh::GroupData& data, const VertexFormat& format) {
+    std::vector<unsigned char> vertexData(data.m_vertices.size() * format.getStride());
+    for (size_t i = 0; i < data.m_vertices.size(); ++i) {
+        format.writeVertex(&vertexData[i * format.getStride()], data.m_vertices[i], data.m_normals[i], data.m_texCoords[i]);
+    }
+
+    return vertexData;
+}
+
+/**
+ * Concatenate the indices of all levels of detail, as 16-bit if the vertex count allows it and 32-bit
+ * otherwise. Returns the index type and the range of each level.
+ */
+static GLenum packIndices(const Mesh::GroupData& data, std::vector<unsigned char>& indexData, std::vector<Mesh::Group::Lod>& lods) {
+    std::vector<const std::vector<GLuint>*> levels;
+    levels.push_back(&data.m_indices);
+    for (size_t i = 0; i < data.m_lods.size(); ++i) {
+        levels.push_back(&data.m_lods[i].m_indices);
+    }
+
+    std::vector<GLuint> indices;
+    lods.clear();
+    for (size_t i = 0; i < levels.size(); ++i) {
+        Mesh::Group::Lod lod;
+        lod.m_indexOffset = indices.size();
+        lod.m_indexCount = levels[i]->size();
+        lod.m_error = (i == 0) ? 0.0f : data.m_lods[i - 1].m_error;
+        lods.push_back(lod);
+
+        indices.insert(indices.end(), levels[i]->begin(), levels[i]->end());
+    }
+
+    if (data.m_vertices.size() <= (size_t) std::numeric_limits<GLushort>::max() + 1) {
+        indexData.resize(indices.size() * sizeof(GLushort));
+        GLushort* shortIndices = (GLushort*) &indexData[0];
+        for (size_t i = 0; i < indices.size(); ++i) {
+            shortIndices[i] = (GLushort) indices[i];
+        }
+
+        return GL_UNSIGNED_SHORT;
+    }
+
+    indexData.resize(indices.size() * sizeof(GLuint));
+    memcpy(&indexData[0], &indices[0], indexData.size());
+
+    return GL_UNSIGNED_INT;
+}
+
+/** Upload an already packed group */
+static std::shared_ptr<Mesh::Group> createGroup(const std::string& material,
+                                                const VertexFormat& format,
+                                                const void* vertexData, size_t vertexSize, size_t vertexCount,
+                                                GLenum indexType, const void* indexData, size_t indexSize, size_t indexCount,
+                                                const std::vector<Mesh::Group::Lod>& lods,
+                                                const AABB& bounds, const BoundingSphere& boundingSphere) {
+    std::shared_ptr<Mesh::Group> g(new Mesh::Group);
+    g->m_material = material;
+    g->m_format = format;
+    g->m_vertexCount = vertexCount;
+    g->m_indexType = indexType;
+    g->m_indexCount = indexCount;
+    g->m_lods = lods;
+    g->m_bounds = bounds;
+    g->m_boundingSphere = boundingSphere;
+
+    {
+        glBindVertexArrayState vaoState(g->m_VAO.getId());
+
+        {
+            glBindBufferState vboState(GL_ARRAY_BUFFER, g->m_vertices.getId());
+            GLCheck(glBufferData(GL_ARRAY_BUFFER, vertexSize, vertexData, GL_STATIC_DRAW));
+            format.setupAttributes();
+        }
+
+        // the element array binding is part of the VAO state, so it is recorded in the VAO
+        glBindBufferState iboState(GL_ELEMENT_ARRAY_BUFFER, g->m_indices.getId());
+        GLCheck(glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, indexData, GL_STATIC_DRAW));
+    }
+
+    return g;
+}
+
+/** Set the bounds of the mesh to the union of its groups */
+static void mergeGroupBounds(Mesh& mesh) {
+    mesh.m_bounds = AABB();
+    mesh.m_boundingSphere = BoundingSphere();
+    for (std::map<std::string, std::shared_ptr<Mesh::Group> >::const_iterator it = mesh.m_groups.begin(); it != mesh.m_groups.end(); ++it) {
+        mesh.m_bounds.merge(it->second->m_bounds);
+        mesh.m_boundingSphere.merge(it->second->m_boundingSphere);
+    }
+}
+
+static size_t alignCacheOffset(size_t offset) {
+    return (offset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+
+std::shared_ptr<Mesh> Mesh::load(const std::string& filename, const VertexFormat& format) {
+    std::shared_ptr<Mesh> mesh = loadCache(filename, format);
+    if (mesh != nullptr)
+        return mesh;
+
+    Data data = parseOBJ(filename);
+    for (std::map<std::string, GroupData>::iterator it = data.m_groups.begin(); it != data.m_groups.end(); ++it) {
+        MeshSimplifier::generateLods(it->second);
+    }
+
+    // a missing cache only costs load time, so don't fail if it can't be written
+    try {
+        writeCache(data, format, filename);
+    } catch (std::exception& e) {
+        std::cerr << "WARNING: " << e.what() << std::endl;
+    }
+
+    return create(data, format);
+}
+
+std::shared_ptr<Mesh> Mesh::loadOBJ(const std::string& filename, const VertexFormat& format) {
+    return create(parseOBJ(filename), format);
+}
+
+Mesh::Data Mesh::parseOBJ(const std::string& filename) {
+    Data mesh;
 
     std::ifstream fs(filename.c_str(), std::ifstream::in);
     if (!fs.is_open()) {
 		throw r2ExceptionIOM("Failed to open .obj file: " + filename);
     }
 
-    std::vector<glm::vec4> vertexList;
-    std::vector<glm::vec4> normalList;
+    std::vector<glm::vec3> vertexList;
+    std::vector<glm::vec3> normalList;
     std::vector<glm::vec2> texCoordList;
 
-    std::map<std::string, GroupData> groupData;
+    // maps a v/t/n triple to its index in the vertex arrays of each group
+    std::map<std::string, VertexLookup> vertexLookups;
+    std::map<std::string, GroupData>& groupData = mesh.m_groups;
     std::string currentGroup = "default";
 
     while (!fs.eof()) {
@@ -39,7 +286,7 @@ std::shared_ptr<Mesh> Mesh::loadOBJ(const std::string& filename) {
         lineStream >> token;
 
         if (token == "mtllib") {
-            lineStream >> mesh->m_mtlLibrary;
+            lineStream >> mesh.m_mtlLibrary;
         } else if (token == "g") {
             lineStream >> currentGroup;
         } else if (token == "usemtl") {
@@ -48,12 +295,11 @@ std::shared_ptr<Mesh> Mesh::loadOBJ(const std::string& filename) {
 
             groupData[currentGroup].m_material = material;
         } else if (token == "v") {
-            glm::vec4 v;
+            glm::vec3 v;
 
             lineStream >> v.x;
             lineStream >> v.y;
             lineStream >> v.z;
-            v.w = 1.0f;
 
             if (lineStream.fail() || lineStream.bad()) {
 				throw r2ExceptionIOM("Failed to parse vertex in .obj file: " + filename);
@@ -61,12 +307,11 @@ std::shared_ptr<Mesh> Mesh::loadOBJ(const std::string& filename) {
 
             vertexList.push_back(v);
         } else if (token == "vn") {
-            glm::vec4 n;
+            glm::vec3 n;
 
             lineStream >> n.x;
             lineStream >> n.y;
             lineStream >> n.z;
-            n.w = 0.0f;
 
             if (lineStream.fail() || lineStream.bad()) {
 				throw r2ExceptionIOM("Failed to parse normal in .obj file: " + filename);
@@ -84,40 +329,52 @@ std::shared_ptr<Mesh> Mesh::loadOBJ(const std::string& filename) {
 
             texCoordList.push_back(t);
         } else if (token == "f") {
+            GroupData& group = groupData[currentGroup];
+            VertexLookup& vertexLookup = vertexLookups[currentGroup];
+
             for (int i = 0; i < 3; ++i) {
-                int v;
-                int t;
-                int n;
+                VertexKey key;
 
-                lineStream >> v;
+                lineStream >> key.m_vertex;
                 lineStream.ignore();
-                lineStream >> t;
+                lineStream >> key.m_texCoord;
                 lineStream.ignore();
-                lineStream >> n;
+                lineStream >> key.m_normal;
 
                 if (lineStream.fail() || lineStream.bad()) {
                     throw r2ExceptionIOM("Failed to parse face in .obj file: " + filename);
                 }
 
-                v = v - 1;
-                n = n - 1;
-                t = t - 1;
+                key.m_vertex = key.m_vertex - 1;
+                key.m_normal = key.m_normal - 1;
+                key.m_texCoord = key.m_texCoord - 1;
+
+                // reuse the vertex if this triple has been seen before in the group
+                VertexLookup::iterator found = vertexLookup.find(key);
+                if (found != vertexLookup.end()) {
+                    group.m_indices.push_back(found->second);
+                    continue;
+                }
 
-                groupData[currentGroup].m_vertices.push_back(vertexList[v]);
-                groupData[currentGroup].m_normals.push_back(normalList[n]);
-                groupData[currentGroup].m_texCoords.push_back(texCoordList[t]);
+                GLuint index = group.m_vertices.size();
+                vertexLookup[key] = index;
+                group.m_indices.push_back(index);
+
+                group.m_vertices.push_back(vertexList[key.m_vertex]);
+                group.m_normals.push_back(normalList[key.m_normal]);
+                group.m_texCoords.push_back(texCoordList[key.m_texCoord]);
             }
         }
     }
 
     fs.close();
 
-    // create the buffers
-    for (std::map<std::string, GroupData>::iterator it = groupData.begin(); it != groupData.end(); it++)
-    {
+    for (std::map<std::string, GroupData>::iterator it = groupData.begin(); it != groupData.end(); ) {
         // skip if empty group
-        if (it->second.m_vertices.size() == 0)
+        if (it->second.m_vertices.size() == 0) {
+            groupData.erase(it++);
             continue;
+        }
 
         // assert that we have equal amounts of vertices, texture coordinates and normals
         bool sizeCheck = it->second.m_vertices.size() == it->second.m_normals.size() &&
@@ -126,38 +383,256 @@ std::shared_ptr<Mesh> Mesh::loadOBJ(const std::string& filename) {
 			throw r2ExceptionIOM("Invalid number of vertices/normals/texture coordinates in .obj file: " + filename);
         }
 
-        std::shared_ptr<Mesh::Group> g(new Mesh::Group);
+        ++it;
+    }
 
-        {
-            glBindVertexArrayState vaoState(g->m_VAO.getId());
-            GLCheck(glEnableVertexAttribArray(0)); 
-            GLCheck(glEnableVertexAttribArray(1));
-            GLCheck(glEnableVertexAttribArray(2));
-
-            {
-                glBindBufferState vboState(GL_ARRAY_BUFFER, g->m_vertices.getId());
-                GLCheck(glBufferData(GL_ARRAY_BUFFER, it->second.m_vertices.size() * 4 * sizeof(float), &it->second.m_vertices[0], GL_STATIC_DRAW));
-                GLCheck(glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0));
-            }
+    return mesh;
+}
 
-            {
-                glBindBufferState vboState(GL_ARRAY_BUFFER, g->m_normals.getId());
-                GLCheck(glBufferData(GL_ARRAY_BUFFER, it->second.m_normals.size() * 4 * sizeof(float), &it->second.m_normals[0], GL_STATIC_DRAW));
-                GLCheck(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, 0));
-            }
+std::shared_ptr<Mesh> Mesh::create(const Data& data, const VertexFormat& format) {
+    std::shared_ptr<Mesh> mesh(new Mesh);
+    mesh->m_mtlLibrary = data.m_mtlLibrary;
 
-            {
-                glBindBufferState vboState(GL_ARRAY_BUFFER, g->m_texCoords.getId());
-                GLCheck(glBufferData(GL_ARRAY_BUFFER, it->second.m_texCoords.size() * 2 * sizeof(float), &it->second.m_texCoords[0], GL_STATIC_DRAW));
-                GLCheck(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0));
-            }
+    // create the buffers
+    for (std::map<std::string, GroupData>::const_iterator it = data.m_groups.begin(); it != data.m_groups.end(); it++) {
+        std::vector<unsigned char> vertexData = packVertices(it->second, format);
+        std::vector<unsigned char> indexData;
+        std::vector<Group::Lod> lods;
+        GLenum indexType = packIndices(it->second, indexData, lods);
+
+        mesh->m_groups[it->first] = createGroup(it->second.m_material,
+                                                format,
+                                                &vertexData[0], vertexData.size(), it->second.m_vertices.size(),
+                                                indexType, &indexData[0], indexData.size(), lods.back().m_indexOffset + lods.back().m_indexCount,
+                                                lods,
+                                                AABB::fromPoints(it->second.m_vertices), BoundingSphere::fromPoints(it->second.m_vertices));
+    }
+
+    mergeGroupBounds(*mesh);
+
+    return mesh;
+}
+
+void Mesh::writeCache(const Data& data, const VertexFormat& format, const std::string& sourceFile) {
+    const std::vector<VertexFormat::Attribute>& attributes = format.getAttributes();
+    if (attributes.size() > CACHE_MAX_ATTRIBUTES) {
+        throw r2ExceptionArgumentM("Too many vertex attributes to cache mesh: " + sourceFile);
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.m_version = CACHE_VERSION;
+    if (!hashFile(sourceFile, header.m_sourceHash, header.m_sourceSize)) {
+        throw r2ExceptionIOM("Failed to read mesh source for caching: " + sourceFile);
+    }
+
+    header.m_attributeCount = attributes.size();
+    header.m_stride = format.getStride();
+    for (size_t i = 0; i < attributes.size(); ++i) {
+        header.m_attributes[i].m_semantic = attributes[i].m_semantic;
+        header.m_attributes[i].m_components = attributes[i].m_components;
+        header.m_attributes[i].m_type = attributes[i].m_type;
+        header.m_attributes[i].m_normalized = attributes[i].m_normalized;
+    }
+
+    // lay out the string table right after the group table
+    std::vector<CacheGroup> groups(data.m_groups.size());
+    std::string strings;
+    size_t stringBase = sizeof(CacheHeader) + groups.size() * sizeof(CacheGroup);
+
+    header.m_groupCount = groups.size();
+    header.m_mtlLibraryOffset = stringBase + strings.size();
+    header.m_mtlLibraryLength = data.m_mtlLibrary.size();
+    strings += data.m_mtlLibrary;
+
+    size_t groupIndex = 0;
+    for (std::map<std::string, GroupData>::const_iterator it = data.m_groups.begin(); it != data.m_groups.end(); ++it, ++groupIndex) {
+        CacheGroup& group = groups[groupIndex];
+        memset(&group, 0, sizeof(group));
+
+        group.m_nameOffset = stringBase + strings.size();
+        group.m_nameLength = it->first.size();
+        strings += it->first;
+
+        group.m_materialOffset = stringBase + strings.size();
+        group.m_materialLength = it->second.m_material.size();
+        strings += it->second.m_material;
+    }
+
+    // pack the blobs and assign their aligned offsets
+    std::vector<std::vector<unsigned char> > blobs;
+    size_t offset = stringBase + strings.size();
+
+    groupIndex = 0;
+    for (std::map<std::string, GroupData>::const_iterator it = data.m_groups.begin(); it != data.m_groups.end(); ++it, ++groupIndex) {
+        CacheGroup& group = groups[groupIndex];
+
+        blobs.push_back(packVertices(it->second, format));
+        group.m_vertexCount = it->second.m_vertices.size();
+        group.m_vertexOffset = offset = alignCacheOffset(offset);
+        group.m_vertexSize = blobs.back().size();
+        offset += group.m_vertexSize;
+
+        if (it->second.m_lods.size() + 1 > CACHE_MAX_LODS) {
+            throw r2ExceptionArgumentM("Too many levels of detail to cache mesh: " + sourceFile);
         }
-        
-        g->m_material = it->second.m_material;
-        g->m_vertexCount = it->second.m_vertices.size();
-        mesh->m_groups[it->first] = g;
+
+        std::vector<Group::Lod> lods;
+        blobs.push_back(std::vector<unsigned char>());
+        group.m_indexType = packIndices(it->second, blobs.back(), lods);
+        group.m_indexCount = lods.back().m_indexOffset + lods.back().m_indexCount;
+        group.m_lodCount = lods.size();
+        for (size_t i = 0; i < lods.size(); ++i) {
+            group.m_lods[i].m_indexOffset = lods[i].m_indexOffset;
+            group.m_lods[i].m_indexCount = lods[i].m_indexCount;
+            group.m_lods[i].m_error = lods[i].m_error;
+        }
+
+        group.m_indexOffset = offset = alignCacheOffset(offset);
+        group.m_indexSize = blobs.back().size();
+        offset += group.m_indexSize;
+
+        AABB bounds = AABB::fromPoints(it->second.m_vertices);
+        BoundingSphere boundingSphere = BoundingSphere::fromPoints(it->second.m_vertices);
+        for (int c = 0; c < 3; ++c) {
+            group.m_boundsMin[c] = bounds.m_min[c];
+            group.m_boundsMax[c] = bounds.m_max[c];
+            group.m_sphereCenter[c] = boundingSphere.m_center[c];
+        }
+        group.m_sphereRadius = boundingSphere.m_radius;
     }
 
+    // assemble the file in memory and write it in one go
+    std::vector<unsigned char> file(offset, 0);
+    memcpy(&file[0], &header, sizeof(header));
+    if (!groups.empty())
+        memcpy(&file[sizeof(header)], &groups[0], groups.size() * sizeof(CacheGroup));
+    if (!strings.empty())
+        memcpy(&file[stringBase], strings.data(), strings.size());
+
+    for (size_t i = 0; i < groups.size(); ++i) {
+        memcpy(&file[groups[i].m_vertexOffset], &blobs[i * 2][0], groups[i].m_vertexSize);
+        memcpy(&file[groups[i].m_indexOffset], &blobs[i * 2 + 1][0], groups[i].m_indexSize);
+    }
+
+    std::string cacheFile = getCacheFilename(sourceFile);
+    std::ofstream fs(cacheFile.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!fs.is_open()) {
+        throw r2ExceptionIOM("Failed to open mesh cache for writing: " + cacheFile);
+    }
+
+    fs.write((const char*) &file[0], file.size());
+    if (fs.fail()) {
+        throw r2ExceptionIOM("Failed to write mesh cache: " + cacheFile);
+    }
+}
+
+std::shared_ptr<Mesh> Mesh::loadCache(const std::string& sourceFile, const VertexFormat& format) {
+    std::string cacheFile = getCacheFilename(sourceFile);
+    if (!std::ifstream(cacheFile.c_str()).is_open())
+        return nullptr;
+
+    MappedFile file(cacheFile);
+    const unsigned char* base = file.getData();
+
+    // validate the header against the source and the requested format
+    if (file.getSize() < sizeof(CacheHeader))
+        return nullptr;
+
+    CacheHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.m_version != CACHE_VERSION)
+        return nullptr;
+
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    if (!hashFile(sourceFile, sourceHash, sourceSize)) {
+        throw r2ExceptionIOM("Failed to open .obj file: " + sourceFile);
+    }
+    if (sourceHash != header.m_sourceHash || sourceSize != header.m_sourceSize)
+        return nullptr;
+
+    const std::vector<VertexFormat::Attribute>& attributes = format.getAttributes();
+    if (header.m_attributeCount != attributes.size() || header.m_stride != (uint32_t) format.getStride())
+        return nullptr;
+    for (size_t i = 0; i < attributes.size(); ++i) {
+        const CacheAttribute& cached = header.m_attributes[i];
+        if (cached.m_semantic != (uint32_t) attributes[i].m_semantic ||
+            cached.m_components != (uint32_t) attributes[i].m_components ||
+            cached.m_type != attributes[i].m_type ||
+            cached.m_normalized != attributes[i].m_normalized)
+            return nullptr;
+    }
+
+    // bounds check everything before touching GL, so a truncated cache is simply treated as stale
+    uint64_t fileSize = file.getSize();
+    if (!isInRange(sizeof(CacheHeader), (uint64_t) header.m_groupCount * sizeof(CacheGroup), fileSize) ||
+        !isInRange(header.m_mtlLibraryOffset, header.m_mtlLibraryLength, fileSize))
+        return nullptr;
+
+    std::vector<CacheGroup> groups(header.m_groupCount);
+    if (!groups.empty())
+        memcpy(&groups[0], base + sizeof(CacheHeader), groups.size() * sizeof(CacheGroup));
+
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const CacheGroup& group = groups[i];
+        if (!isInRange(group.m_nameOffset, group.m_nameLength, fileSize) ||
+            !isInRange(group.m_materialOffset, group.m_materialLength, fileSize) ||
+            !isInRange(group.m_vertexOffset, group.m_vertexSize, fileSize) ||
+            !isInRange(group.m_indexOffset, group.m_indexSize, fileSize) ||
+            group.m_lodCount == 0 || group.m_lodCount > CACHE_MAX_LODS)
+            return nullptr;
+
+        // the draws may only read what is uploaded
+        if (header.m_stride == 0 || group.m_vertexSize % header.m_stride != 0 || group.m_vertexSize / header.m_stride != group.m_vertexCount)
+            return nullptr;
+
+        if (group.m_indexType != GL_UNSIGNED_SHORT && group.m_indexType != GL_UNSIGNED_INT)
+            return nullptr;
+        uint64_t indexSize = (group.m_indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+        if ((uint64_t) group.m_indexCount * indexSize > group.m_indexSize)
+            return nullptr;
+
+        for (size_t l = 0; l < group.m_lodCount; ++l) {
+            if (!isInRange(group.m_lods[l].m_indexOffset, group.m_lods[l].m_indexCount, group.m_indexCount))
+                return nullptr;
+        }
+    }
+
+    // upload the blobs straight from the mapping
+    std::shared_ptr<Mesh> mesh(new Mesh);
+    mesh->m_mtlLibrary.assign((const char*) base + header.m_mtlLibraryOffset, header.m_mtlLibraryLength);
+
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const CacheGroup& group = groups[i];
+
+        std::string name((const char*) base + group.m_nameOffset, group.m_nameLength);
+        std::string material((const char*) base + group.m_materialOffset, group.m_materialLength);
+
+        std::vector<Group::Lod> lods(group.m_lodCount);
+        for (size_t l = 0; l < lods.size(); ++l) {
+            lods[l].m_indexOffset = group.m_lods[l].m_indexOffset;
+            lods[l].m_indexCount = group.m_lods[l].m_indexCount;
+            lods[l].m_error = group.m_lods[l].m_error;
+        }
+
+        mesh->m_groups[name] = createGroup(material,
+                                           format,
+                                           base + group.m_vertexOffset, group.m_vertexSize, group.m_vertexCount,
+                                           group.m_indexType, base + group.m_indexOffset, group.m_indexSize, group.m_indexCount,
+                                           lods,
+                                           AABB(glm::vec3(group.m_boundsMin[0], group.m_boundsMin[1], group.m_boundsMin[2]),
+                                                glm::vec3(group.m_boundsMax[0], group.m_boundsMax[1], group.m_boundsMax[2])),
+                                           BoundingSphere(glm::vec3(group.m_sphereCenter[0], group.m_sphereCenter[1], group.m_sphereCenter[2]),
+                                                          group.m_sphereRadius));
+    }
+
+    mergeGroupBounds(*mesh);
+
     return mesh;
 }
 
+std::string Mesh::getCacheFilename(const std::string& sourceFile) {
+    return sourceFile + ".meshcache";
+}
@@ -4,7 +4,11 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <vector>
+#include <glm/glm.hpp>
 #include "buffer.hpp"
+#include "vertexformat.hpp"
+#include "bounds.hpp"
 
 class Mesh {
 public:
@@ -12,18 +16,80 @@ public:
     public:
         std::string m_material;
 
-        VBO m_vertices;
-        VBO m_normals;
-        VBO m_texCoords;
+        VertexFormat m_format;
+        VBO m_vertices;         // interleaved, laid out according to m_format
         size_t m_vertexCount;
 
+        /** A range of the index buffer drawing the group at some level of detail */
+        struct Lod {
+            size_t m_indexOffset;   // In indices, not bytes
+            size_t m_indexCount;
+            float m_error;          // Object space deviation from the full resolution group
+        };
+
+        VBO m_indices;          // All levels of detail, one after the other
+        GLenum m_indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, depending on the vertex count
+        size_t m_indexCount;
+        std::vector<Lod> m_lods;    // The full resolution group first, coarsest last
+
         VAO m_VAO;
+
+        AABB m_bounds;                      // Object space
+        BoundingSphere m_boundingSphere;    // Object space
+
+        size_t getIndexSize() const { return (m_indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint); }
+    };
+
+    /** A simplified version of a group, sharing the vertices of the full resolution group */
+    struct LodData {
+        std::vector<GLuint> m_indices;
+        float m_error;
+    };
+
+    /** The CPU-side contents of a group, before it has been packed and uploaded */
+    struct GroupData {
+        std::string m_material;
+        std::vector<glm::vec3> m_vertices;
+        std::vector<glm::vec3> m_normals;
+        std::vector<glm::vec2> m_texCoords;
+        std::vector<GLuint> m_indices;
+        std::vector<LodData> m_lods;    // Excluding the full resolution level, coarsest last
+    };
+
+    /** The CPU-side contents of a whole mesh, as produced by the parsers */
+    struct Data {
+        std::string m_mtlLibrary;
+        std::map<std::string, GroupData> m_groups;
     };
 
     std::string m_mtlLibrary;
     std::map<std::string, std::shared_ptr<Group> > m_groups;
+    AABB m_bounds;                      // Union of the group bounds
+    BoundingSphere m_boundingSphere;    // Union of the group spheres
+
+    /**
+     * Load a mesh through its binary cache. If the cache is missing or stale, the source is parsed,
+     * levels of detail are generated and the cache is (re)written.
+     */
+    static std::shared_ptr<Mesh> load(const std::string& filename, const VertexFormat& format = VertexFormat::createCompact());
+
+    /** Parse and upload a .obj file, bypassing the cache */
+    static std::shared_ptr<Mesh> loadOBJ(const std::string& filename, const VertexFormat& format = VertexFormat::createCompact());
+
+    /** Parse a .obj file into deduplicated, indexed groups */
+    static Data parseOBJ(const std::string& filename);
+
+    /** Pack and upload parsed mesh data */
+    static std::shared_ptr<Mesh> create(const Data& data, const VertexFormat& format);
+
+    /** Write the binary cache for the given source file. The source must exist, since its hash is stored in the cache. */
+    static void writeCache(const Data& data, const VertexFormat& format, const std::string& sourceFile);
+
+    /** Load a mesh from the cache of the given source file. Returns NULL if the cache is missing, stale or in another format. */
+    static std::shared_ptr<Mesh> loadCache(const std::string& sourceFile, const VertexFormat& format);
 
-    static std::shared_ptr<Mesh> loadOBJ(const std::string& filename);
+    /** The filename of the binary cache for a source file */
+    static std::string getCacheFilename(const std::string& sourceFile);
 };
 
 #endif
@@ -0,0 +1,95 @@
+#include "meshpool.hpp"
+#include <r2tk/r2-exception.hpp>
+#include <algorithm>
+#include <vector>
+
+MeshPool::MeshPool(const VertexFormat& format)
+    : m_format(format)
+    , m_vertices(new VBO)
+    , m_vertexCount(0)
+    , m_vertexCapacity(0)
+    , m_indices(new VBO)
+    , m_indexCount(0)
+    , m_indexCapacity(0)
+    , m_generation(0) {}
+
+void MeshPool::add(const Mesh& mesh) {
+    for (std::map<std::string, std::shared_ptr<Mesh::Group> >::const_iterator it = mesh.m_groups.begin(); it != mesh.m_groups.end(); ++it) {
+        add(*it->second);
+    }
+}
+
+const MeshPool::Allocation& MeshPool::add(const Mesh::Group& group) {
+    std::map<const Mesh::Group*, Allocation>::iterator existing = m_allocations.find(&group);
+    if (existing != m_allocations.end())
+        return existing->second;
+
+    if (group.m_format != m_format)
+        throw r2ExceptionArgumentM("The group's vertex format differs from the pool's");
+
+    size_t stride = m_format.getStride();
+    reserve(m_vertices, m_vertexCapacity, m_vertexCount, m_vertexCount + group.m_vertexCount, stride);
+    reserve(m_indices, m_indexCapacity, m_indexCount, m_indexCount + group.m_indexCount, sizeof(GLuint));
+
+    // the vertices can be copied as they are
+    {
+        glBindBufferState readState(GL_COPY_READ_BUFFER, group.m_vertices.getId());
+        glBindBufferState writeState(GL_COPY_WRITE_BUFFER, m_vertices->getId());
+        GLCheck(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, m_vertexCount * stride, group.m_vertexCount * stride));
+    }
+
+    // the indices may have to be widened, which is done on the CPU since this only happens at load time
+    {
+        glBindBufferState readState(GL_COPY_READ_BUFFER, group.m_indices.getId());
+        glBindBufferState writeState(GL_COPY_WRITE_BUFFER, m_indices->getId());
+
+        if (group.m_indexType == GL_UNSIGNED_INT) {
+            GLCheck(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, m_indexCount * sizeof(GLuint), group.m_indexCount * sizeof(GLuint)));
+        } else if (group.m_indexCount > 0) {
+            std::vector<GLushort> shortIndices(group.m_indexCount);
+            GLCheck(glGetBufferSubData(GL_COPY_READ_BUFFER, 0, group.m_indexCount * sizeof(GLushort), &shortIndices[0]));
+
+            std::vector<GLuint> indices(shortIndices.begin(), shortIndices.end());
+            GLCheck(glBufferSubData(GL_COPY_WRITE_BUFFER, m_indexCount * sizeof(GLuint), group.m_indexCount * sizeof(GLuint), &indices[0]));
+        }
+    }
+
+    Allocation& allocation = m_allocations[&group];
+    allocation.m_baseVertex = (GLint) m_vertexCount;
+    allocation.m_firstIndex = (GLuint) m_indexCount;
+    allocation.m_vertexCount = group.m_vertexCount;
+    allocation.m_indexCount = group.m_indexCount;
+
+    m_vertexCount += group.m_vertexCount;
+    m_indexCount += group.m_indexCount;
+
+    return allocation;
+}
+
+const MeshPool::Allocation* MeshPool::getAllocation(const Mesh::Group& group) const {
+    std::map<const Mesh::Group*, Allocation>::const_iterator it = m_allocations.find(&group);
+    return (it != m_allocations.end()) ? &it->second : NULL;
+}
+
+void MeshPool::reserve(std::unique_ptr<VBO>& buffer, size_t& capacity, size_t used, size_t required, size_t elementSize) {
+    if (required <= capacity)
+        return;
+
+    // double, so loading many small meshes doesn't copy the pool every time
+    size_t newCapacity = std::max(required, capacity * 2);
+    std::unique_ptr<VBO> newBuffer(new VBO);
+
+    {
+        glBindBufferState writeState(GL_COPY_WRITE_BUFFER, newBuffer->getId());
+        GLCheck(glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, NULL, GL_STATIC_DRAW));
+
+        if (used > 0) {
+            glBindBufferState readState(GL_COPY_READ_BUFFER, buffer->getId());
+            GLCheck(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used * elementSize));
+        }
+    }
+
+    buffer = std::move(newBuffer);
+    capacity = newCapacity;
+    ++m_generation;
+}
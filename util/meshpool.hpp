@@ -0,0 +1,62 @@
+#ifndef MESHPOOL_HPP
+#define MESHPOOL_HPP
+
+#include <map>
+#include <memory>
+#include <GL/glew.h>
+#include "buffer.hpp"
+#include "mesh.hpp"
+#include "vertexformat.hpp"
+
+/**
+ * Packs the groups of many meshes, all in the same vertex format, into one vertex and one index buffer,
+ * so they can be drawn from a single vertex array. The groups keep their own buffers; the pool holds copies.
+ * Indices are widened to GL_UNSIGNED_INT and stay relative to the group, so draws add the base vertex.
+ */
+class MeshPool {
+public:
+    /** Where a group's data lives in the pool */
+    struct Allocation {
+        GLint m_baseVertex;
+        GLuint m_firstIndex;
+        size_t m_vertexCount;
+        size_t m_indexCount;
+    };
+
+    explicit MeshPool(const VertexFormat& format);
+
+    /** Copy all groups of the mesh into the pool. Groups already in the pool are skipped. */
+    void add(const Mesh& mesh);
+    const Allocation& add(const Mesh::Group& group);
+
+    /** The allocation of a group, or NULL if it isn't in the pool */
+    const Allocation* getAllocation(const Mesh::Group& group) const;
+
+    const VertexFormat& getFormat() const { return m_format; }
+    GLuint getVertexBuffer() const { return m_vertices->getId(); }
+    GLuint getIndexBuffer() const { return m_indices->getId(); }
+
+    /** Incremented whenever the buffers are reallocated, so vertex arrays referencing them know to be set up again */
+    unsigned int getGeneration() const { return m_generation; }
+private:
+    VertexFormat m_format;
+
+    std::unique_ptr<VBO> m_vertices;
+    size_t m_vertexCount;
+    size_t m_vertexCapacity;
+
+    std::unique_ptr<VBO> m_indices;
+    size_t m_indexCount;
+    size_t m_indexCapacity;
+
+    std::map<const Mesh::Group*, Allocation> m_allocations;
+    unsigned int m_generation;
+
+    /** Grow a buffer to at least the capacity, in elements, keeping its contents */
+    void reserve(std::unique_ptr<VBO>& buffer, size_t& capacity, size_t used, size_t required, size_t elementSize);
+
+    MeshPool(const MeshPool&);
+    MeshPool& operator=(const MeshPool&);
+};
+
+#endif
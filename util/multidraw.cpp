@@ -0,0 +1,214 @@
+#include "multidraw.hpp"
+#include "programcache.hpp"
+#include "glstate.hpp"
+#include <r2tk/r2-exception.hpp>
+#include <algorithm>
+#include <cstring>
+
+// The storage buffer bindings of the culling shader
+static const GLuint OBJECT_BINDING = 0;
+static const GLuint COMMAND_BINDING = 1;
+static const GLuint CULL_GROUP_SIZE = 64;
+
+static const char* CULL_SHADER =
+    "#version 430\n"
+    "layout(local_size_x = 64) in;\n"
+    "struct Object { vec4 sphere; uint indexCount; uint firstIndex; int baseVertex; uint padding; };\n"
+    "struct Command { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n"
+    "layout(std430, binding = 0) readonly buffer Objects { Object g_Objects[]; };\n"
+    "layout(std430, binding = 1) writeonly buffer Commands { Command g_Commands[]; };\n"
+    "uniform vec4 g_Planes[6];\n"
+    "uniform int g_ObjectCount;\n"
+    "void main() {\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    if (i >= uint(g_ObjectCount))\n"
+    "        return;\n"
+    "    Object object = g_Objects[i];\n"
+    "    bool visible = true;\n"
+    "    for (int p = 0; p < 6; ++p) {\n"
+    "        if (dot(g_Planes[p].xyz, object.sphere.xyz) + g_Planes[p].w < -object.sphere.w)\n"
+    "            visible = false;\n"
+    "    }\n"
+    "    g_Commands[i] = Command(object.indexCount, visible ? 1u : 0u, object.firstIndex, object.baseVertex, i);\n"
+    "}\n";
+
+/** The layout glMultiDrawElementsIndirect reads */
+struct DrawElementsIndirectCommand {
+    GLuint m_count;
+    GLuint m_instanceCount;
+    GLuint m_firstIndex;
+    GLint m_baseVertex;
+    GLuint m_baseInstance;
+};
+
+bool MultiDraw::isSupported() {
+    return GLEW_VERSION_4_3 != 0;
+}
+
+MultiDraw::MultiDraw(const MeshPool& pool, StreamBuffer& stream)
+    : m_pool(pool)
+    , m_poolGeneration(pool.getGeneration())
+    , m_stream(stream)
+    , m_commandCapacity(0) {
+    if (!isSupported())
+        throw r2ExceptionRuntimeM("Multi-draw indirect needs an OpenGL 4.3 context");
+
+    std::vector<ProgramCache::Source> sources;
+    sources.push_back(ProgramCache::Source(GL_COMPUTE_SHADER, CULL_SHADER));
+    m_cullProgram = ProgramCache::get(sources);
+
+    GLint alignment;
+    GLCheck(glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment));
+    m_storageAlignment = (alignment > 0) ? alignment : 256;
+
+    setupVertexArray();
+}
+
+void MultiDraw::add(const Mesh::Group& group, size_t lod, const glm::mat4& modelMatrix,
+                    const TextureAtlas& atlas, size_t region, GLuint textureUnit, GLuint sampler) {
+    const MeshPool::Allocation* allocation = m_pool.getAllocation(group);
+    if (allocation == NULL)
+        throw r2ExceptionArgumentM("The group isn't in the mesh pool");
+
+    GLuint texture = atlas.getId();
+    Batch* batch = NULL;
+    for (size_t i = 0; i < m_batches.size(); ++i) {
+        if (m_batches[i].m_texture == texture && m_batches[i].m_textureUnit == textureUnit && m_batches[i].m_sampler == sampler) {
+            batch = &m_batches[i];
+            break;
+        }
+    }
+
+    if (batch == NULL) {
+        m_batches.push_back(Batch());
+        batch = &m_batches.back();
+        batch->m_texture = texture;
+        batch->m_textureUnit = textureUnit;
+        batch->m_sampler = sampler;
+    }
+
+    BoundingSphere sphere = group.m_boundingSphere.transform(modelMatrix);
+
+    Object object;
+    object.m_sphere = glm::vec4(sphere.m_center, sphere.m_radius);
+    object.m_indexCount = group.m_lods.empty() ? group.m_indexCount : group.m_lods[lod].m_indexCount;
+    object.m_firstIndex = allocation->m_firstIndex + (group.m_lods.empty() ? 0 : group.m_lods[lod].m_indexOffset);
+    object.m_baseVertex = allocation->m_baseVertex;
+    object.m_padding = 0;
+
+    batch->m_objects.push_back(object);
+    batch->m_modelMatrices.push_back(modelMatrix);
+    batch->m_regions.push_back(atlas.getRegion(region));
+}
+
+void MultiDraw::execute(const Frustum& frustum, const Program& program, const Uniform<GLint>& textureUniform) {
+    m_stats = Stats();
+
+    // lay the batches out one after the other, so each is a contiguous range of commands
+    m_objects.clear();
+    m_modelMatrices.clear();
+    m_regions.clear();
+    for (size_t i = 0; i < m_batches.size(); ++i) {
+        m_objects.insert(m_objects.end(), m_batches[i].m_objects.begin(), m_batches[i].m_objects.end());
+        m_modelMatrices.insert(m_modelMatrices.end(), m_batches[i].m_modelMatrices.begin(), m_batches[i].m_modelMatrices.end());
+        m_regions.insert(m_regions.end(), m_batches[i].m_regions.begin(), m_batches[i].m_regions.end());
+    }
+
+    m_stats.m_objects = m_objects.size();
+    if (m_objects.empty())
+        return;
+
+    if (m_poolGeneration != m_pool.getGeneration())
+        setupVertexArray();
+
+    // write this frame's objects, model matrices and atlas regions
+    size_t objectSize = m_objects.size() * sizeof(Object);
+    StreamBuffer::Allocation objects = m_stream.allocate(objectSize, m_storageAlignment);
+    memcpy(objects.m_data, &m_objects[0], objectSize);
+
+    size_t modelMatrixSize = m_modelMatrices.size() * sizeof(glm::mat4);
+    StreamBuffer::Allocation modelMatrices = m_stream.allocate(modelMatrixSize);
+    memcpy(modelMatrices.m_data, &m_modelMatrices[0], modelMatrixSize);
+
+    size_t regionSize = m_regions.size() * sizeof(TextureAtlas::Region);
+    StreamBuffer::Allocation regions = m_stream.allocate(regionSize);
+    memcpy(regions.m_data, &m_regions[0], regionSize);
+
+    m_stream.flush();
+
+    {
+        glBindVertexArrayState vaoState(m_VAO.getId());
+        {
+            glBindBufferState instanceState(GL_ARRAY_BUFFER, modelMatrices.m_buffer);
+            VertexFormat::setupInstanceMatrix(modelMatrices.m_offset);
+        }
+
+        glBindBufferState regionState(GL_ARRAY_BUFFER, regions.m_buffer);
+        VertexFormat::setupInstanceTextureRegion(regions.m_offset);
+    }
+
+    GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objects.m_buffer, objects.m_offset, objectSize);
+
+    // the commands are only ever written by the GPU, so the buffer is just grown when needed
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_commandBuffer.getId());
+    if (m_objects.size() > m_commandCapacity) {
+        m_commandCapacity = std::max(m_objects.size(), m_commandCapacity * 2);
+        GLCheck(glBufferData(GL_SHADER_STORAGE_BUFFER, m_commandCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY));
+    }
+
+    // write the commands
+    glm::vec4 planes[Frustum::PLANE_COUNT];
+    for (int i = 0; i < Frustum::PLANE_COUNT; ++i) {
+        planes[i] = frustum.getPlane(i);
+    }
+
+    // looked up at the first draw, so the program can link in the background until then
+    if (!m_planesUniform) {
+        m_planesUniform.reset(new Uniform<glm::vec4>(*m_cullProgram, "g_Planes"));
+        m_objectCountUniform.reset(new Uniform<GLint>(*m_cullProgram, "g_ObjectCount"));
+    }
+
+    GLState::useProgram(m_cullProgram->getId());
+    m_planesUniform->set(planes, Frustum::PLANE_COUNT);
+    m_objectCountUniform->set((GLint) m_objects.size());
+    GLCheck(glDispatchCompute((GLuint) (m_objects.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1));
+    GLCheck(glMemoryBarrier(GL_COMMAND_BARRIER_BIT));
+    ++m_stats.m_dispatches;
+
+    // draw each batch's range of commands
+    GLState::useProgram(program.getId());
+    GLState::bindVertexArray(m_VAO.getId());
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.getId());
+
+    size_t first = 0;
+    for (size_t i = 0; i < m_batches.size(); ++i) {
+        Batch& batch = m_batches[i];
+        if (batch.m_objects.empty())
+            continue;
+
+        GLState::bindTexture(batch.m_textureUnit, GL_TEXTURE_2D_ARRAY, batch.m_texture);
+        GLState::bindSampler(batch.m_textureUnit, batch.m_sampler);
+        textureUniform.set((GLint) batch.m_textureUnit);
+
+        GLCheck(glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) (first * sizeof(DrawElementsIndirectCommand)),
+                                            (GLsizei) batch.m_objects.size(), 0));
+        ++m_stats.m_drawCalls;
+
+        first += batch.m_objects.size();
+        batch.m_objects.clear();
+        batch.m_modelMatrices.clear();
+        batch.m_regions.clear();
+    }
+}
+
+void MultiDraw::setupVertexArray() {
+    glBindVertexArrayState vaoState(m_VAO.getId());
+
+    {
+        glBindBufferState vboState(GL_ARRAY_BUFFER, m_pool.getVertexBuffer());
+        m_pool.getFormat().setupAttributes();
+    }
+
+    glBindBufferState iboState(GL_ELEMENT_ARRAY_BUFFER, m_pool.getIndexBuffer());
+    m_poolGeneration = m_pool.getGeneration();
+}
@@ -0,0 +1,101 @@
+#ifndef MULTIDRAW_HPP
+#define MULTIDRAW_HPP
+
+#include <vector>
+#include <memory>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "buffer.hpp"
+#include "bounds.hpp"
+#include "meshpool.hpp"
+#include "shader.hpp"
+#include "streambuffer.hpp"
+#include "textureatlas.hpp"
+
+/**
+ * Draws any number of objects out of a mesh pool with one glMultiDrawElementsIndirect per texture atlas,
+ * so objects with different textures in the same atlas share a call.
+ * A compute shader tests each object's bounding sphere against the frustum and writes its draw
+ * command, zeroing the instance count of culled objects, so the CPU issues the same few calls
+ * however many objects there are. The objects and their model matrices are written to a stream
+ * buffer; the matrices and atlas regions are instanced attributes at VertexFormat::INSTANCE_MATRIX
+ * and INSTANCE_TEXTURE_TRANSFORM, selected per command by its base instance.
+ *
+ * Needs GL 4.3 (compute shaders, storage buffers and indirect multi-draws), see isSupported.
+ */
+class MultiDraw {
+public:
+    struct Stats {
+        size_t m_objects;
+        size_t m_drawCalls;     // Multi-draws issued, one per atlas
+        size_t m_dispatches;
+
+        Stats() : m_objects(0), m_drawCalls(0), m_dispatches(0) {}
+    };
+
+    /** Whether the context can run the GPU path. Otherwise draw through the render queue. */
+    static bool isSupported();
+
+    MultiDraw(const MeshPool& pool, StreamBuffer& stream);
+
+    /** Queue a level of detail of a pooled group, drawn with the model matrix and a region of the atlas bound to the unit */
+    void add(const Mesh::Group& group, size_t lod, const glm::mat4& modelMatrix,
+             const TextureAtlas& atlas, size_t region, GLuint textureUnit, GLuint sampler);
+
+    /**
+     * Cull and draw everything queued since the last call with the program, which must read the model matrix
+     * from VertexFormat::INSTANCE_MATRIX and the region from INSTANCE_TEXTURE_TRANSFORM and INSTANCE_TEXTURE_LAYER.
+     * The sampler2DArray uniform is set to each atlas's unit. Clears the queue.
+     */
+    void execute(const Frustum& frustum, const Program& program, const Uniform<GLint>& textureUniform);
+
+    /** The stats of the last execute */
+    const Stats& getStats() const { return m_stats; }
+private:
+    /** Mirrors the std430 Object struct of the culling shader */
+    struct Object {
+        glm::vec4 m_sphere;     // World space center and radius
+        GLuint m_indexCount;
+        GLuint m_firstIndex;
+        GLint m_baseVertex;
+        GLuint m_padding;
+    };
+
+    /** The objects sharing an atlas, drawn by one multi-draw */
+    struct Batch {
+        GLuint m_texture;
+        GLuint m_textureUnit;
+        GLuint m_sampler;
+        std::vector<Object> m_objects;
+        std::vector<glm::mat4> m_modelMatrices;
+        std::vector<TextureAtlas::Region> m_regions;
+    };
+
+    const MeshPool& m_pool;
+    unsigned int m_poolGeneration;
+    StreamBuffer& m_stream;
+    size_t m_storageAlignment;      // GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+
+    std::vector<Batch> m_batches;
+    std::vector<Object> m_objects;
+    std::vector<glm::mat4> m_modelMatrices;
+    std::vector<TextureAtlas::Region> m_regions;
+
+    VAO m_VAO;
+    VBO m_commandBuffer;
+    size_t m_commandCapacity;
+
+    std::shared_ptr<Program> m_cullProgram;
+    std::unique_ptr<Uniform<glm::vec4> > m_planesUniform;
+    std::unique_ptr<Uniform<GLint> > m_objectCountUniform;
+
+    Stats m_stats;
+
+    /** Record the pool's current buffers in the vertex array */
+    void setupVertexArray();
+
+    MultiDraw(const MultiDraw&);
+    MultiDraw& operator=(const MultiDraw&);
+};
+
+#endif
@@ -0,0 +1,363 @@
+#include "optimizer.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Tuning of the Forsyth score function, as suggested in the original article
+static const size_t FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+// Soft cluster boundaries are only placed after this many triangles
+static const size_t OVERDRAW_MIN_CLUSTER_SIZE = 8;
+
+static float forsythScore(int cachePosition, size_t remainingTriangles) {
+    // a vertex without triangles left can't help choosing the next triangle
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // the vertices of the last triangle get a fixed score, so the order doesn't depend on
+            // which way the previous triangle was wound
+            score = FORSYTH_LAST_TRIANGLE_SCORE;
+        } else {
+            float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+
+    // boost vertices with few triangles left, so lone triangles don't get left behind
+    score += FORSYTH_VALENCE_BOOST_SCALE * std::pow((float) remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+
+    return score;
+}
+
+/** Simulate a FIFO cache and return the number of misses of each triangle */
+static std::vector<unsigned char> simulateTriangleMisses(const std::vector<GLuint>& indices, size_t vertexCount, size_t cacheSize) {
+    std::vector<size_t> timestamps(vertexCount, 0);
+    size_t time = cacheSize + 1;
+
+    std::vector<unsigned char> misses(indices.size() / 3, 0);
+    for (size_t t = 0; t < misses.size(); ++t) {
+        for (size_t k = 0; k < 3; ++k) {
+            GLuint index = indices[t * 3 + k];
+            if (time - timestamps[index] > cacheSize) {
+                timestamps[index] = time++;
+                ++misses[t];
+            }
+        }
+    }
+
+    return misses;
+}
+
+
+void MeshOptimizer::optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // build the vertex -> triangle adjacency
+    std::vector<size_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        ++remaining[indices[i]];
+    }
+
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+
+    std::vector<GLuint> adjacency(indices.size());
+    {
+        std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+    }
+
+    // initial scores
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexScore[v] = forsythScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+
+    std::vector<GLuint> cache;
+    std::vector<GLuint> newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    int best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    size_t fallbackCursor = 0;
+
+    while (output.size() < indices.size()) {
+        // the cache ran dry, so continue with the first triangle not yet emitted
+        if (best < 0) {
+            while (emitted[fallbackCursor])
+                ++fallbackCursor;
+            best = fallbackCursor;
+        }
+
+        const GLuint* triangle = &indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // remove the triangle from the adjacency of its vertices
+        for (size_t k = 0; k < 3; ++k) {
+            GLuint v = triangle[k];
+            GLuint* begin = &adjacency[offsets[v]];
+            GLuint* end = begin + remaining[v];
+            GLuint* found = std::find(begin, end, (GLuint) best);
+            if (found != end) {
+                *found = *(end - 1);
+                --remaining[v];
+            }
+        }
+
+        // push the triangle's vertices to the front of the cache
+        newCache.assign(triangle, triangle + 3);
+        for (size_t i = 0; i < cache.size(); ++i) {
+            GLuint v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.push_back(v);
+        }
+
+        // vertices that fell out of the cache lose their position score
+        for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); ++i) {
+            cachePosition[newCache[i]] = -1;
+            vertexScore[newCache[i]] = forsythScore(-1, remaining[newCache[i]]);
+        }
+        if (newCache.size() > FORSYTH_CACHE_SIZE)
+            newCache.resize(FORSYTH_CACHE_SIZE);
+
+        cache.swap(newCache);
+        for (size_t i = 0; i < cache.size(); ++i) {
+            cachePosition[cache[i]] = i;
+            vertexScore[cache[i]] = forsythScore(i, remaining[cache[i]]);
+        }
+
+        // rescore the triangles touching the cache and pick the best one
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cache.size(); ++i) {
+            GLuint v = cache[i];
+            for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a) {
+                GLuint t = adjacency[a];
+                float score = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<glm::vec3>& positions, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    const size_t cacheSize = 16;
+
+    // hard boundaries: triangles that miss on every vertex start over with a cold cache anyway
+    std::vector<unsigned char> misses = simulateTriangleMisses(indices, positions.size(), cacheSize);
+    std::vector<size_t> hardBoundaries;
+    hardBoundaries.push_back(0);
+    for (size_t t = 1; t < triangleCount; ++t) {
+        if (misses[t] == 3)
+            hardBoundaries.push_back(t);
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // soft boundaries: split a hard cluster further whenever the part so far stays within the threshold.
+    // Each new cluster is simulated with a cold cache, which is what the split costs at draw time.
+    std::vector<size_t> clusters;
+    std::vector<size_t> timestamps(positions.size(), 0);
+    size_t time = cacheSize + 1;
+
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h) {
+        size_t begin = hardBoundaries[h];
+        size_t end = hardBoundaries[h + 1];
+
+        size_t clusterMisses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            clusterMisses += misses[t];
+        }
+        float clusterACMR = (float) clusterMisses / (end - begin);
+
+        clusters.push_back(begin);
+        time += cacheSize + 1;
+
+        size_t start = begin;
+        size_t runningMisses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (size_t k = 0; k < 3; ++k) {
+                GLuint index = indices[t * 3 + k];
+                if (time - timestamps[index] > cacheSize) {
+                    timestamps[index] = time++;
+                    ++runningMisses;
+                }
+            }
+
+            size_t size = t - start + 1;
+            if (size >= OVERDRAW_MIN_CLUSTER_SIZE && t + 1 < end &&
+                (float) runningMisses / size <= threshold * clusterACMR) {
+                clusters.push_back(t + 1);
+                start = t + 1;
+                runningMisses = 0;
+                time += cacheSize + 1;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // area weighted centroid of the mesh
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const glm::vec3& a = positions[indices[t * 3 + 0]];
+        const glm::vec3& b = positions[indices[t * 3 + 1]];
+        const glm::vec3& c = positions[indices[t * 3 + 2]];
+        float area = glm::length(glm::cross(b - a, c - a));
+
+        meshCentroid += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // sort the clusters so the ones facing away from the centroid (likely occluders) are drawn first
+    struct Cluster {
+        size_t m_begin;
+        size_t m_end;
+        float m_sortKey;
+
+        bool operator<(const Cluster& other) const { return m_sortKey > other.m_sortKey; }
+    };
+
+    std::vector<Cluster> sorted;
+    for (size_t i = 0; i + 1 < clusters.size(); ++i) {
+        Cluster cluster;
+        cluster.m_begin = clusters[i];
+        cluster.m_end = clusters[i + 1];
+
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = cluster.m_begin; t < cluster.m_end; ++t) {
+            const glm::vec3& a = positions[indices[t * 3 + 0]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& c = positions[indices[t * 3 + 2]];
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float triangleArea = glm::length(n);
+
+            centroid += (a + b + c) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+
+        if (area > 0.0f)
+            centroid /= area;
+        if (glm::length(normal) > 0.0f)
+            normal = glm::normalize(normal);
+
+        cluster.m_sortKey = glm::dot(centroid - meshCentroid, normal);
+        sorted.push_back(cluster);
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end());
+
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        output.insert(output.end(), indices.begin() + sorted[i].m_begin * 3, indices.begin() + sorted[i].m_end * 3);
+    }
+
+    indices.swap(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(Mesh::GroupData& group) {
+    const GLuint UNUSED = ~0u;
+    std::vector<GLuint> remap(group.m_vertices.size(), UNUSED);
+
+    Mesh::GroupData reordered;
+    reordered.m_material = group.m_material;
+    reordered.m_indices.resize(group.m_indices.size());
+
+    for (size_t i = 0; i < group.m_indices.size(); ++i) {
+        GLuint index = group.m_indices[i];
+        if (remap[index] == UNUSED) {
+            remap[index] = reordered.m_vertices.size();
+
+            reordered.m_vertices.push_back(group.m_vertices[index]);
+            reordered.m_normals.push_back(group.m_normals[index]);
+            reordered.m_texCoords.push_back(group.m_texCoords[index]);
+        }
+
+        reordered.m_indices[i] = remap[index];
+    }
+
+    // the levels of detail only use vertices of the full resolution group
+    reordered.m_lods = group.m_lods;
+    for (size_t l = 0; l < reordered.m_lods.size(); ++l) {
+        std::vector<GLuint>& indices = reordered.m_lods[l].m_indices;
+        for (size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = remap[indices[i]];
+        }
+    }
+
+    std::swap(group, reordered);
+}
+
+void MeshOptimizer::optimize(Mesh::GroupData& group, bool overdraw) {
+    optimizeVertexCache(group.m_indices, group.m_vertices.size());
+    if (overdraw)
+        optimizeOverdraw(group.m_indices, group.m_vertices);
+
+    for (size_t l = 0; l < group.m_lods.size(); ++l) {
+        optimizeVertexCache(group.m_lods[l].m_indices, group.m_vertices.size());
+        if (overdraw)
+            optimizeOverdraw(group.m_lods[l].m_indices, group.m_vertices);
+    }
+
+    optimizeVertexFetch(group);
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount, size_t cacheSize) {
+    VertexCacheStats stats;
+    stats.m_acmr = 0.0f;
+    stats.m_atvr = 0.0f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return stats;
+
+    std::vector<unsigned char> misses = simulateTriangleMisses(indices, vertexCount, cacheSize);
+    size_t transformed = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        transformed += misses[t];
+    }
+
+    stats.m_acmr = (float) transformed / triangleCount;
+    stats.m_atvr = (float) transformed / vertexCount;
+
+    return stats;
+}
@@ -0,0 +1,38 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include "mesh.hpp"
+
+/** Efficiency of an index order on a simulated FIFO post-transform cache */
+struct VertexCacheStats {
+    float m_acmr;           // Average cache miss ratio: transformed vertices per triangle (0.5 - 3.0)
+    float m_atvr;           // Average transformed vertex ratio: transformed vertices per unique vertex (>= 1.0)
+};
+
+/** Reorders the triangles and vertices of a group for the GPU. Meant to be run at bake time. */
+class MeshOptimizer {
+public:
+    /** Reorder the triangles for the post-transform cache (Tom Forsyth's linear-speed algorithm) */
+    static void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+
+    /**
+     * Split the triangles into clusters at cache boundaries and sort the clusters so the outward facing
+     * ones are drawn first. The clusters are kept small enough that the ACMR grows by at most the threshold.
+     * Should be run after optimizeVertexCache.
+     */
+    static void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<glm::vec3>& positions, float threshold = 1.05f);
+
+    /** Reorder the vertices in order of first use in the index buffer, so the fetches are linear. Levels of detail are remapped too. */
+    static void optimizeVertexFetch(Mesh::GroupData& group);
+
+    /** Run all of the above, in order, on every level of detail */
+    static void optimize(Mesh::GroupData& group, bool overdraw);
+
+    /** Simulate a FIFO cache of the given size over the indices */
+    static VertexCacheStats analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount, size_t cacheSize = 16);
+};
+
+#endif
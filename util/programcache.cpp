@@ -0,0 +1,220 @@
+#include "programcache.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <cstring>
+
+static const char BINARY_MAGIC[4] = { 'R', '2', 'P', 'B' };
+static const uint32_t BINARY_VERSION = 1;
+
+/** Precedes the driver's binary in a cache file */
+struct BinaryHeader {
+    char m_magic[4];
+    uint32_t m_version;
+    uint64_t m_key;             // Of the sources, in case of a collision in the file name
+    uint64_t m_driverHash;
+    uint32_t m_format;
+    uint32_t m_size;
+};
+
+std::string ProgramCache::s_directory = "resources/shaders/";
+std::map<uint64_t, std::weak_ptr<Shader> > ProgramCache::s_shaders;
+std::map<uint64_t, std::weak_ptr<Program> > ProgramCache::s_programs;
+std::map<std::string, std::weak_ptr<Program> > ProgramCache::s_permutations;
+std::vector<ProgramCache::PendingBinary> ProgramCache::s_pendingBinaries;
+ProgramCache::Stats ProgramCache::s_stats;
+
+/** FNV-1a, continuing from hash */
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static uint64_t hashSource(const ProgramCache::Source& source, uint64_t hash = 14695981039346656037ULL) {
+    uint32_t type = source.m_type;
+    hash = hashBytes(&type, sizeof(type), hash);
+
+    // includes the terminator, so the boundary between two sources is part of the hash
+    return hashBytes(source.m_source.c_str(), source.m_source.size() + 1, hash);
+}
+
+std::shared_ptr<Program> ProgramCache::get(const std::vector<Source>& sources) {
+    uint64_t key = 14695981039346656037ULL;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        key = hashSource(sources[i], key);
+    }
+
+    std::shared_ptr<Program> program = s_programs[key].lock();
+    if (program) {
+        ++s_stats.m_shared;
+        return program;
+    }
+
+    std::unique_ptr<Program> restored = readBinary(key);
+    if (restored) {
+        program.reset(restored.release());
+        ++s_stats.m_binaries;
+    } else {
+        std::vector<std::shared_ptr<Shader> > shaders;
+        for (size_t i = 0; i < sources.size(); ++i) {
+            shaders.push_back(getShader(sources[i]));
+        }
+
+        bool retrievable = !s_directory.empty() && Program::isBinarySupported();
+        program.reset(new Program(shaders, retrievable));
+        ++s_stats.m_linked;
+
+        // reading the binary now would wait for the link, so it is written by update once the link is done
+        if (retrievable) {
+            PendingBinary pending = { key, program };
+            s_pendingBinaries.push_back(pending);
+        }
+    }
+
+    s_programs[key] = program;
+
+    return program;
+}
+
+std::shared_ptr<Program> ProgramCache::load(const std::string& vertexFile, const std::string& fragmentFile, const ShaderDefines& defines) {
+    std::string permutation = vertexFile + "\n" + fragmentFile;
+    for (ShaderDefines::const_iterator it = defines.begin(); it != defines.end(); ++it) {
+        permutation += "\n" + it->first + "=" + it->second;
+    }
+
+    std::shared_ptr<Program> program = s_permutations[permutation].lock();
+    if (program) {
+        ++s_stats.m_shared;
+        return program;
+    }
+
+    std::vector<Source> sources;
+    sources.push_back(Source(GL_VERTEX_SHADER, Shader::readSource(vertexFile, defines)));
+    sources.push_back(Source(GL_FRAGMENT_SHADER, Shader::readSource(fragmentFile, defines)));
+
+    program = get(sources);
+    s_permutations[permutation] = program;
+
+    return program;
+}
+
+void ProgramCache::update() {
+    size_t kept = 0;
+    for (size_t i = 0; i < s_pendingBinaries.size(); ++i) {
+        std::shared_ptr<Program> program = s_pendingBinaries[i].m_program.lock();
+        if (!program)
+            continue;
+
+        // a failed link is dropped here and reported by the program's first use
+        if (!program->isReady())
+            s_pendingBinaries[kept++] = s_pendingBinaries[i];
+        else if (program->isLinked())
+            writeBinary(s_pendingBinaries[i].m_key, *program);
+    }
+
+    s_pendingBinaries.resize(kept);
+}
+
+std::shared_ptr<Shader> ProgramCache::getShader(const Source& source) {
+    uint64_t key = hashSource(source);
+
+    std::shared_ptr<Shader> shader = s_shaders[key].lock();
+    if (!shader) {
+        shader.reset(new Shader(source.m_source.c_str(), source.m_type));
+        s_shaders[key] = shader;
+        ++s_stats.m_compiled;
+    }
+
+    return shader;
+}
+
+std::unique_ptr<Program> ProgramCache::readBinary(uint64_t key) {
+    if (s_directory.empty() || !Program::isBinarySupported())
+        return nullptr;
+
+    std::ifstream fs(getBinaryFilename(key).c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!fs.is_open())
+        return nullptr;
+
+    BinaryHeader header;
+    fs.read((char*) &header, sizeof(header));
+    if (fs.fail() || memcmp(header.m_magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 || header.m_version != BINARY_VERSION ||
+        header.m_key != key || header.m_driverHash != getDriverHash()) {
+        ++s_stats.m_rejected;
+        return nullptr;
+    }
+
+    // the binary fills the rest of the file, so a corrupt size is caught before it is allocated
+    std::streampos binaryStart = fs.tellg();
+    fs.seekg(0, std::ifstream::end);
+    std::streamoff remaining = fs.tellg() - binaryStart;
+    fs.seekg(binaryStart);
+    if (fs.fail() || header.m_size == 0 || remaining != (std::streamoff) header.m_size) {
+        ++s_stats.m_rejected;
+        return nullptr;
+    }
+
+    std::vector<unsigned char> binary(header.m_size);
+    fs.read((char*) &binary[0], binary.size());
+
+    std::unique_ptr<Program> program;
+    if (!fs.fail())
+        program = Program::createFromBinary(header.m_format, binary);
+
+    if (!program)
+        ++s_stats.m_rejected;
+
+    return program;
+}
+
+void ProgramCache::writeBinary(uint64_t key, const Program& program) {
+    GLenum format = 0;
+    std::vector<unsigned char> binary = program.getBinary(format);
+    if (binary.empty())
+        return;
+
+    BinaryHeader header;
+    memcpy(header.m_magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.m_version = BINARY_VERSION;
+    header.m_key = key;
+    header.m_driverHash = getDriverHash();
+    header.m_format = format;
+    header.m_size = binary.size();
+
+    // the cache is only an optimization, so failing to write it isn't an error
+    std::string filename = getBinaryFilename(key);
+    std::ofstream fs(filename.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (fs.is_open()) {
+        fs.write((const char*) &header, sizeof(header));
+        fs.write((const char*) &binary[0], binary.size());
+    }
+
+    if (!fs.is_open() || fs.fail())
+        std::cerr << "WARNING: Failed to write program binary: " << filename << std::endl;
+}
+
+std::string ProgramCache::getBinaryFilename(uint64_t key) {
+    std::stringstream ss;
+    ss << s_directory << std::hex << std::setw(16) << std::setfill('0') << key << ".programcache";
+
+    return ss.str();
+}
+
+uint64_t ProgramCache::getDriverHash() {
+    const GLenum NAMES[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); ++i) {
+        const char* value = (const char*) GLCheck(glGetString(NAMES[i]));
+        if (value != NULL)
+            hash = hashBytes(value, strlen(value) + 1, hash);
+    }
+
+    return hash;
+}
@@ -0,0 +1,85 @@
+#ifndef PROGRAMCACHE_HPP
+#define PROGRAMCACHE_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include "shader.hpp"
+
+/**
+ * Shares shaders and programs between everything built from the same sources, keyed by a hash of each
+ * stage and its source, and keeps the linked programs on disk as driver binaries. A binary is only used
+ * by the driver that wrote it (same vendor, renderer and version), so after a driver update the programs
+ * are compiled again and the binaries rewritten; a warm start compiles nothing.
+ *
+ * The binaries are named by the hash of their sources, so editing a shader leaves the binaries of its old
+ * sources behind. Nothing removes them; clear the directory of .programcache files to reclaim the space.
+ */
+class ProgramCache {
+public:
+    struct Source {
+        GLenum m_type;
+        std::string m_source;
+
+        Source(GLenum type, const std::string& source) : m_type(type), m_source(source) {}
+    };
+
+    struct Stats {
+        size_t m_compiled;          // Shaders compiled
+        size_t m_linked;            // Programs linked from shaders
+        size_t m_binaries;          // Programs restored from binaries
+        size_t m_rejected;          // Binaries that were stale or that the driver refused
+        size_t m_shared;            // Requests answered by a program that was already alive
+
+        Stats() : m_compiled(0), m_linked(0), m_binaries(0), m_rejected(0), m_shared(0) {}
+    };
+
+    /** Where the binaries are kept, "resources/shaders/" by default. Empty disables the disk cache. */
+    static void setDirectory(const std::string& directory) { s_directory = directory; }
+
+    /** The program of the sources, one per stage */
+    static std::shared_ptr<Program> get(const std::vector<Source>& sources);
+
+    /**
+     * The permutation of a vertex and a fragment shader file with the defines, which both stages get. Only the
+     * permutations that are asked for are ever compiled, and asking again for a live one doesn't read the files.
+     */
+    static std::shared_ptr<Program> load(const std::string& vertexFile, const std::string& fragmentFile,
+                                         const ShaderDefines& defines = ShaderDefines());
+
+    /**
+     * Write the binaries of the programs that have finished linking since the last call. Programs are linked in the
+     * background where the driver supports it, so this never waits for one and is meant to be called every frame.
+     */
+    static void update();
+
+    static const Stats& getStats() { return s_stats; }
+private:
+    struct PendingBinary {
+        uint64_t m_key;
+        std::weak_ptr<Program> m_program;
+    };
+
+    static std::string s_directory;
+    static std::map<uint64_t, std::weak_ptr<Shader> > s_shaders;
+    static std::map<uint64_t, std::weak_ptr<Program> > s_programs;
+    static std::map<std::string, std::weak_ptr<Program> > s_permutations;    // By files and defines
+    static std::vector<PendingBinary> s_pendingBinaries;
+    static Stats s_stats;
+
+    static std::shared_ptr<Shader> getShader(const Source& source);
+
+    /** Restore a program from its binary, or return NULL if there is none that this driver can use */
+    static std::unique_ptr<Program> readBinary(uint64_t key);
+    static void writeBinary(uint64_t key, const Program& program);
+
+    static std::string getBinaryFilename(uint64_t key);
+
+    /** Identifies the driver the binaries were written by */
+    static uint64_t getDriverHash();
+};
+
+#endif
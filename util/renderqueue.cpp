@@ -0,0 +1,228 @@
+#include "renderqueue.hpp"
+#include "glstate.hpp"
+#include <algorithm>
+#include <cstring>
+
+size_t DrawList::pushUniforms(const void* data, size_t size) {
+    size_t offset = m_uniforms.size();
+    m_uniforms.resize(offset + size);
+    memcpy(&m_uniforms[offset], data, size);
+
+    return offset;
+}
+
+void DrawList::clear() {
+    m_packets.clear();
+    m_uniforms.clear();
+}
+
+
+RenderQueue::RenderQueue(size_t listCount)
+    : m_lists(listCount)
+    , m_order(ORDER_STATE)
+    , m_depthPrepass(false)
+    , m_queryFrame(0) {
+    memset(m_queries, 0, sizeof(m_queries));
+    memset(m_queryIssued, 0, sizeof(m_queryIssued));
+    memset(m_samples, 0, sizeof(m_samples));
+}
+
+RenderQueue::~RenderQueue() {
+    if (m_queries[0][0] != 0) {
+        GLCheck(glDeleteQueries(QUERY_LATENCY * QUERY_PASS_COUNT, &m_queries[0][0]));
+    }
+}
+
+void RenderQueue::setListCount(size_t listCount) {
+    m_lists.resize(listCount);
+}
+
+void RenderQueue::execute(UniformRing& objectUniforms, GLuint objectBinding) {
+    m_stats = Stats();
+
+    // merge the lists, moving the per-object blocks into the ring
+    m_packets.clear();
+    m_entries.clear();
+    for (size_t l = 0; l < m_lists.size(); ++l) {
+        DrawList& list = m_lists[l];
+        for (size_t i = 0; i < list.m_packets.size(); ++i) {
+            DrawPacket packet = list.m_packets[i];
+            if (packet.m_uniformSize > 0)
+                packet.m_uniformOffset = objectUniforms.push(&list.m_uniforms[packet.m_uniformOffset], packet.m_uniformSize);
+
+            uint64_t key = (m_order == ORDER_FRONT_TO_BACK) ? makeFrontToBackKey(packet.m_key) : packet.m_key;
+            SortEntry entry = { key, (uint32_t) m_packets.size() };
+            m_entries.push_back(entry);
+            m_packets.push_back(packet);
+        }
+
+        list.clear();
+    }
+
+    objectUniforms.flush();
+    sortEntries();
+    readQueries();
+
+    // lay down the depth of everything first, so the shading pass runs the fragment shaders once per visible sample
+    if (m_depthPrepass) {
+        GLCheck(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+        beginQuery(QUERY_PREPASS);
+        drawPackets(objectUniforms, objectBinding, true);
+        GLCheck(glEndQuery(GL_SAMPLES_PASSED));
+        GLCheck(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+
+        GLCheck(glDepthFunc(GL_EQUAL));
+        GLCheck(glDepthMask(GL_FALSE));
+    }
+
+    beginQuery(QUERY_SHADING);
+    drawPackets(objectUniforms, objectBinding, false);
+    GLCheck(glEndQuery(GL_SAMPLES_PASSED));
+
+    if (m_depthPrepass) {
+        GLCheck(glDepthFunc(GL_LESS));
+        GLCheck(glDepthMask(GL_TRUE));
+    }
+
+    m_queryFrame = (m_queryFrame + 1) % QUERY_LATENCY;
+
+    m_stats.m_packets = m_entries.size();
+    m_stats.m_prepassSamples = m_samples[QUERY_PREPASS];
+    m_stats.m_shadedSamples = m_samples[QUERY_SHADING];
+}
+
+void RenderQueue::drawPackets(UniformRing& objectUniforms, GLuint objectBinding, bool depthOnly) {
+    // packets without a depth program missed the prepass, so they are depth tested as usual
+    bool depthEqual = m_depthPrepass;
+
+    // draw, touching only the state that differs from the previous packet
+    const DrawPacket* previous = NULL;
+    GLuint previousProgram = 0;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        const DrawPacket& packet = m_packets[m_entries[i].m_packet];
+
+        GLuint program = depthOnly ? packet.m_depthProgram : packet.m_program;
+        if (program == 0)
+            continue;
+
+        if (!depthOnly && m_depthPrepass && depthEqual != (packet.m_depthProgram != 0)) {
+            depthEqual = !depthEqual;
+            GLCheck(glDepthFunc(depthEqual ? GL_EQUAL : GL_LESS));
+            GLCheck(glDepthMask(depthEqual ? GL_FALSE : GL_TRUE));
+        }
+
+        if (previous == NULL || program != previousProgram) {
+            GLState::useProgram(program);
+            ++m_stats.m_programChanges;
+        }
+
+        if (!depthOnly && packet.m_texture != 0 && (previous == NULL || packet.m_texture != previous->m_texture ||
+            packet.m_textureUnit != previous->m_textureUnit || packet.m_sampler != previous->m_sampler)) {
+            GLState::bindTexture(packet.m_textureUnit, GL_TEXTURE_2D, packet.m_texture);
+            GLState::bindSampler(packet.m_textureUnit, packet.m_sampler);
+            ++m_stats.m_textureChanges;
+        }
+
+        if (previous == NULL || packet.m_vertexArray != previous->m_vertexArray) {
+            GLState::bindVertexArray(packet.m_vertexArray);
+            ++m_stats.m_vertexArrayChanges;
+        }
+
+        if (packet.m_uniformSize > 0)
+            objectUniforms.bind(objectBinding, packet.m_uniformOffset, packet.m_uniformSize);
+
+        if (depthOnly)
+            ++m_stats.m_depthPackets;
+        else
+            m_stats.m_instances += packet.m_instanceCount;
+
+        if (packet.m_instanceCount > 1) {
+            GLCheck(glDrawElementsInstanced(GL_TRIANGLES, packet.m_indexCount, packet.m_indexType, (const GLvoid*) packet.m_indexOffset, packet.m_instanceCount));
+        } else {
+            GLCheck(glDrawElements(GL_TRIANGLES, packet.m_indexCount, packet.m_indexType, (const GLvoid*) packet.m_indexOffset));
+        }
+
+        previous = &packet;
+        previousProgram = program;
+    }
+}
+
+void RenderQueue::readQueries() {
+    if (m_queries[0][0] == 0) {
+        GLCheck(glGenQueries(QUERY_LATENCY * QUERY_PASS_COUNT, &m_queries[0][0]));
+    }
+
+    // a pass that wasn't drawn that frame counts as nothing; a result that still isn't in is dropped
+    for (int pass = 0; pass < QUERY_PASS_COUNT; ++pass) {
+        if (!m_queryIssued[m_queryFrame][pass]) {
+            m_samples[pass] = 0;
+            continue;
+        }
+
+        GLuint query = m_queries[m_queryFrame][pass];
+        GLuint available = GL_FALSE;
+        GLCheck(glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available));
+        if (available == GL_TRUE) {
+            GLCheck(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &m_samples[pass]));
+        }
+
+        m_queryIssued[m_queryFrame][pass] = false;
+    }
+}
+
+void RenderQueue::beginQuery(QueryPass pass) {
+    GLCheck(glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_queryFrame][pass]));
+    m_queryIssued[m_queryFrame][pass] = true;
+}
+
+uint64_t RenderQueue::makeKey(unsigned int layer, GLuint program, GLuint texture, GLuint vertexArray, float depth) {
+    uint64_t quantizedDepth = (uint64_t) (std::min(std::max(depth, 0.0f), 1.0f) * ((1 << 20) - 1));
+
+    return ((uint64_t) (layer & 0xFF) << 56) |
+           ((uint64_t) (program & 0xFFF) << 44) |
+           ((uint64_t) (texture & 0xFFF) << 32) |
+           ((uint64_t) (vertexArray & 0xFFF) << 20) |
+           quantizedDepth;
+}
+
+uint64_t RenderQueue::makeFrontToBackKey(uint64_t key) {
+    // the depth moves from the lowest 20 bits to right below the layer, and the 36 bits of state below it
+    return (key & 0xFF00000000000000ULL) | ((key & 0xFFFFFULL) << 36) | ((key >> 20) & 0xFFFFFFFFFULL);
+}
+
+void RenderQueue::sortEntries() {
+    size_t count = m_entries.size();
+    if (count < 2)
+        return;
+
+    m_sortBuffer.resize(count);
+    SortEntry* source = &m_entries[0];
+    SortEntry* destination = &m_sortBuffer[0];
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[256] = { 0 };
+        for (size_t i = 0; i < count; ++i) {
+            ++histogram[(source[i].m_key >> shift) & 0xFF];
+        }
+
+        // every key has the same byte here, so this pass wouldn't move anything
+        if (histogram[(source[0].m_key >> shift) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t bucket = histogram[b];
+            histogram[b] = offset;
+            offset += bucket;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            destination[histogram[(source[i].m_key >> shift) & 0xFF]++] = source[i];
+        }
+
+        std::swap(source, destination);
+    }
+
+    if (source != &m_entries[0])
+        memcpy(&m_entries[0], source, count * sizeof(SortEntry));
+}
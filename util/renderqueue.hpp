@@ -0,0 +1,155 @@
+#ifndef RENDERQUEUE_HPP
+#define RENDERQUEUE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include "uniformring.hpp"
+
+/** Everything needed to issue one indexed draw */
+struct DrawPacket {
+    uint64_t m_key;             // Sort key, see RenderQueue::makeKey
+    GLuint m_program;
+    GLuint m_depthProgram;      // Writes only depth, for the prepass, or 0 to draw the packet in the shading pass alone
+    GLuint m_vertexArray;
+    GLuint m_texture;           // GL_TEXTURE_2D, or 0 to leave the units alone, for bindless draws
+    GLuint m_textureUnit;
+    GLuint m_sampler;
+    GLenum m_indexType;
+    GLsizei m_indexCount;
+    size_t m_indexOffset;       // In bytes
+    GLsizei m_instanceCount;    // Drawn instanced if more than 1
+    size_t m_uniformOffset;     // Of the per-object block, as returned by DrawList::pushUniforms
+    size_t m_uniformSize;       // 0 if the draw has no per-object block
+};
+
+/**
+ * Collects draw packets and their per-object uniform blocks. Not thread safe: every thread
+ * submitting draws uses its own list, and the lists are merged when the queue executes.
+ * A list makes no GL calls, but the ids in a packet have to be resolved on the context thread
+ * before other threads submit them: Program::getId finishes a pending link, which calls GL.
+ */
+class DrawList {
+public:
+    /** Stage a per-object block and return its offset for DrawPacket::m_uniformOffset */
+    size_t pushUniforms(const void* data, size_t size);
+
+    template <class T>
+    size_t pushUniforms(const T& block) { return pushUniforms(&block, sizeof(T)); }
+
+    void submit(const DrawPacket& packet) { m_packets.push_back(packet); }
+
+    void clear();
+    size_t getPacketCount() const { return m_packets.size(); }
+private:
+    friend class RenderQueue;
+
+    std::vector<DrawPacket> m_packets;
+    std::vector<unsigned char> m_uniforms;
+};
+
+/**
+ * Sorts the packets of all draw lists by key and draws them, changing state only between
+ * packets that differ. The per-object blocks are copied to a uniform ring and bound by offset.
+ *
+ * Optionally the packets are drawn twice: first with their depth programs and color writes off,
+ * then shaded with GL_EQUAL depth testing, so every visible sample is shaded once whatever the
+ * order. Samples passing the depth test in each pass are counted with occlusion queries, read
+ * back a few frames late so the CPU never waits, to tell whether the prepass pays off.
+ */
+class RenderQueue {
+public:
+    enum Order {
+        ORDER_STATE = 0,        // By layer, then state, then depth, which changes the least state
+        ORDER_FRONT_TO_BACK     // By layer, then depth, then state, so early depth testing rejects the most
+    };
+
+    struct Stats {
+        size_t m_packets;
+        size_t m_instances;
+        size_t m_programChanges;        // Over both passes
+        size_t m_vertexArrayChanges;
+        size_t m_textureChanges;
+        size_t m_depthPackets;          // Drawn in the depth prepass
+        GLuint64 m_prepassSamples;      // Passed the depth test in the prepass, which is what shading would cost without it
+        GLuint64 m_shadedSamples;       // Passed the depth test in the shading pass, so were shaded
+
+        Stats() : m_packets(0), m_instances(0), m_programChanges(0), m_vertexArrayChanges(0), m_textureChanges(0),
+                  m_depthPackets(0), m_prepassSamples(0), m_shadedSamples(0) {}
+    };
+
+    /** The number of lists sets how many threads can submit at once */
+    explicit RenderQueue(size_t listCount = 1);
+    ~RenderQueue();
+
+    void setListCount(size_t listCount);
+    size_t getListCount() const { return m_lists.size(); }
+    DrawList& getList(size_t index) { return m_lists[index]; }
+
+    void setOrder(Order order) { m_order = order; }
+    Order getOrder() const { return m_order; }
+
+    void setDepthPrepass(bool depthPrepass) { m_depthPrepass = depthPrepass; }
+    bool hasDepthPrepass() const { return m_depthPrepass; }
+
+    /**
+     * Merge, sort and draw all lists, binding the per-object blocks to the binding point. Clears the lists.
+     * Expects GL_LESS depth testing with depth writes, and leaves it that way.
+     */
+    void execute(UniformRing& objectUniforms, GLuint objectBinding);
+
+    /** The stats of the last execute */
+    const Stats& getStats() const { return m_stats; }
+
+    /**
+     * Build a key that sorts by layer, then program, texture and vertex array, then depth (0 to 1, nearest first).
+     * Object names are truncated to 12 bits; names beyond that may interleave, which costs state changes but is still drawn correctly.
+     */
+    static uint64_t makeKey(unsigned int layer, GLuint program, GLuint texture, GLuint vertexArray, float depth);
+
+    /** Rearrange a key from makeKey to sort by layer, then depth, then state */
+    static uint64_t makeFrontToBackKey(uint64_t key);
+private:
+    struct SortEntry {
+        uint64_t m_key;
+        uint32_t m_packet;
+    };
+
+    enum QueryPass {
+        QUERY_PREPASS = 0,
+        QUERY_SHADING,
+        QUERY_PASS_COUNT
+    };
+
+    // frames before a query is reused, and its result read if it is available by then
+    static const size_t QUERY_LATENCY = 3;
+
+    std::vector<DrawList> m_lists;
+    std::vector<DrawPacket> m_packets;
+    std::vector<SortEntry> m_entries;
+    std::vector<SortEntry> m_sortBuffer;
+    Stats m_stats;
+
+    Order m_order;
+    bool m_depthPrepass;
+
+    GLuint m_queries[QUERY_LATENCY][QUERY_PASS_COUNT];      // Created at the first execute
+    bool m_queryIssued[QUERY_LATENCY][QUERY_PASS_COUNT];
+    size_t m_queryFrame;
+    GLuint64 m_samples[QUERY_PASS_COUNT];                   // The latest results
+
+    /** LSD radix sort on the keys, one byte per pass, skipping bytes that are the same in every key */
+    void sortEntries();
+
+    /** Draw the sorted packets, with their depth programs and without textures for the prepass */
+    void drawPackets(UniformRing& objectUniforms, GLuint objectBinding, bool depthOnly);
+
+    /** Collect the results of the queries about to be reused */
+    void readQueries();
+    void beginQuery(QueryPass pass);
+
+    RenderQueue(const RenderQueue&);
+    RenderQueue& operator=(const RenderQueue&);
+};
+
+#endif
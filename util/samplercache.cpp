@@ -0,0 +1,74 @@
+#include "samplercache.hpp"
+#include "glstate.hpp"
+#include <algorithm>
+
+std::map<SamplerState, GLuint> SamplerCache::s_samplers;
+
+SamplerState::SamplerState()
+    : m_minFilter(GL_LINEAR),
+      m_magFilter(GL_LINEAR),
+      m_wrapS(GL_REPEAT),
+      m_wrapT(GL_REPEAT),
+      m_maxAnisotropy(1.0f) {}
+
+bool SamplerState::operator<(const SamplerState& rhs) const {
+    if (m_minFilter != rhs.m_minFilter)
+        return m_minFilter < rhs.m_minFilter;
+    if (m_magFilter != rhs.m_magFilter)
+        return m_magFilter < rhs.m_magFilter;
+    if (m_wrapS != rhs.m_wrapS)
+        return m_wrapS < rhs.m_wrapS;
+    if (m_wrapT != rhs.m_wrapT)
+        return m_wrapT < rhs.m_wrapT;
+
+    return m_maxAnisotropy < rhs.m_maxAnisotropy;
+}
+
+SamplerState SamplerState::createTrilinear(GLenum wrap, float maxAnisotropy) {
+    SamplerState state;
+    state.m_minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    state.m_magFilter = GL_LINEAR;
+    state.m_wrapS = wrap;
+    state.m_wrapT = wrap;
+    state.m_maxAnisotropy = maxAnisotropy;
+
+    return state;
+}
+
+GLuint SamplerCache::get(const SamplerState& state) {
+    SamplerState key = state;
+    if (GLEW_EXT_texture_filter_anisotropic) {
+        GLfloat supported = 1.0f;
+        GLCheck(glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &supported));
+        key.m_maxAnisotropy = std::min(std::max(key.m_maxAnisotropy, 1.0f), supported);
+    } else {
+        key.m_maxAnisotropy = 1.0f;
+    }
+
+    std::map<SamplerState, GLuint>::iterator it = s_samplers.find(key);
+    if (it != s_samplers.end())
+        return it->second;
+
+    GLuint sampler;
+    GLCheck(glGenSamplers(1, &sampler));
+    GLCheck(glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, key.m_minFilter));
+    GLCheck(glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, key.m_magFilter));
+    GLCheck(glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, key.m_wrapS));
+    GLCheck(glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, key.m_wrapT));
+    if (key.m_maxAnisotropy > 1.0f) {
+        GLCheck(glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, key.m_maxAnisotropy));
+    }
+
+    s_samplers[key] = sampler;
+
+    return sampler;
+}
+
+void SamplerCache::clear() {
+    for (std::map<SamplerState, GLuint>::iterator it = s_samplers.begin(); it != s_samplers.end(); ++it) {
+        GLState::forgetSampler(it->second);
+        GLCheck(glDeleteSamplers(1, &it->second));
+    }
+
+    s_samplers.clear();
+}
@@ -0,0 +1,41 @@
+#ifndef SAMPLERCACHE_HPP
+#define SAMPLERCACHE_HPP
+
+#include <map>
+#include <GL/glew.h>
+
+/** The parameters of a sampler object */
+struct SamplerState {
+    GLenum m_minFilter;
+    GLenum m_magFilter;
+    GLenum m_wrapS;
+    GLenum m_wrapT;
+    float m_maxAnisotropy;      // 1 for none, clamped to what the context supports
+
+    SamplerState();
+
+    bool operator<(const SamplerState& rhs) const;
+
+    /** Trilinear filtering from a full mip chain */
+    static SamplerState createTrilinear(GLenum wrap = GL_REPEAT, float maxAnisotropy = 1.0f);
+};
+
+/**
+ * Shares one sampler object between all textures sampled with the same parameters, instead of
+ * every texture creating its own. The samplers live until clear, which LabApplication calls
+ * before the context goes away.
+ */
+class SamplerCache {
+public:
+    /** The sampler for the parameters, created on first use */
+    static GLuint get(const SamplerState& state);
+
+    /** Delete all samplers */
+    static void clear();
+
+    static size_t getCount() { return s_samplers.size(); }
+private:
+    static std::map<SamplerState, GLuint> s_samplers;
+};
+
+#endif
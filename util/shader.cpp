@@ -1,13 +1,114 @@
 #include "shader.hpp"
+#include "glextensions.hpp"
 #include <r2tk/r2-exception.hpp>
 #include <memory>
 #include <fstream>
+#include <sstream>
 #include <cstdio>
+#include <algorithm>
 
-Shader::Shader(const char* source, GLenum shaderType) {
+/** Orders uniforms by name, for binary searching */
+static bool compareUniformName(const Program::UniformInfo& uniform, const std::string& name) {
+    return uniform.m_name < name;
+}
+
+static bool compareUniforms(const Program::UniformInfo& a, const Program::UniformInfo& b) {
+    return a.m_name < b.m_name;
+}
+
+static bool isSamplerType(GLenum type) {
+    switch (type) {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_RECT:
+        case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/** Whether the line is an #include, and if so the file it names */
+static bool parseInclude(const std::string& line, const std::string& filename, std::string& includeFile) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        return false;
+
+    size_t open = line.find('"', start + 8);
+    size_t close = (open != std::string::npos) ? line.find('"', open + 1) : std::string::npos;
+    if (close == std::string::npos || close == open + 1)
+        throw r2ExceptionIOM("Malformed #include in shader: " + filename + ": " + line);
+
+    includeFile = line.substr(open + 1, close - open - 1);
+    return true;
+}
+
+/** Append the file to the source, splicing in its includes. Files lists every file read so far. */
+static void appendSource(const std::string& filename, std::vector<std::string>& files, std::string& source) {
+    std::ifstream file(filename.c_str());
+    if (!file.is_open()) {
+        throw r2ExceptionIOM("Failed to open shader: " + filename);
+    }
+
+    size_t fileIndex = files.size();
+    files.push_back(filename);
+
+    std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+
+        std::string includeFile;
+        if (!parseInclude(line, filename, includeFile)) {
+            source += line + "\n";
+            continue;
+        }
+
+        std::string includePath = directory + includeFile;
+        if (std::find(files.begin(), files.end(), includePath) != files.end())
+            continue;
+
+        std::stringstream ss;
+        ss << "#line 1 " << files.size() << "\n";
+        source += ss.str();
+
+        appendSource(includePath, files, source);
+
+        // the directive stands in for the #include line, so the next line keeps its number
+        ss.str("");
+        ss << "#line " << lineNumber + 1 << " " << fileIndex << "\n";
+        source += ss.str();
+    }
+}
+
+Shader::Shader(const char* source, GLenum shaderType)
+    : m_checked(false) {
     m_id = GLCheck(glCreateShader(shaderType));
     GLCheck(glShaderSource(m_id, 1, &source, NULL));
     GLCheck(glCompileShader(m_id));
+}
+
+Shader::~Shader() {
+    GLCheck(glDeleteShader(m_id));
+}
+
+bool Shader::isReady() const {
+    if (m_checked || !GLExtensions::hasParallelShaderCompile())
+        return true;
+
+    GLint completed;
+    GLCheck(glGetShaderiv(m_id, GL_COMPLETION_STATUS_KHR, &completed));
+
+    return completed == GL_TRUE;
+}
+
+void Shader::checkCompiled() const {
+    if (m_checked)
+        return;
 
     GLint compiled;
     GLCheck(glGetShaderiv(m_id, GL_COMPILE_STATUS, &compiled));
@@ -26,32 +127,48 @@ Shader::Shader(const char* source, GLenum shaderType) {
 
 		throw r2ExceptionIOM("Failed to compile shader: " + log);
     }
+
+    m_checked = true;
 }
 
-Shader::~Shader() {
-    GLCheck(glDeleteShader(m_id));
+std::shared_ptr<Shader> Shader::loadShader(const std::string& filename, GLenum shaderType, const ShaderDefines& defines) {
+	return std::shared_ptr<Shader>(new Shader(readSource(filename, defines).c_str(), shaderType));
 }
 
-std::shared_ptr<Shader> Shader::loadShader(const std::string& filename, GLenum shaderType) {
-	std::ifstream file(filename.c_str());
+std::string Shader::readSource(const std::string& filename, const ShaderDefines& defines) {
+	std::vector<std::string> files;
+	std::string source;
+	appendSource(filename, files, source);
+
+	if (defines.empty())
+		return source;
 
-	if (!file.is_open()) {
-        throw r2ExceptionIOM("Failed to open shader: " + filename);
-    }
+	// nothing but comments may come before #version, so the defines go right after it
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+		throw r2ExceptionIOM("Shader has no #version, so defines can't be added: " + filename);
 
-	std::string source;
-	while (!file.eof()) {
-		std::string line;
-		std::getline(file, line);
+	size_t versionEnd = source.find('\n', version);
+	versionEnd = (versionEnd == std::string::npos) ? source.size() : versionEnd + 1;
+	int nextLine = std::count(source.begin(), source.begin() + versionEnd, '\n') + 1;
 
-		source += line + "\n";
+	std::stringstream ss;
+	for (ShaderDefines::const_iterator it = defines.begin(); it != defines.end(); ++it) {
+		ss << "#define " << it->first;
+		if (!it->second.empty())
+			ss << " " << it->second;
+		ss << "\n";
 	}
+	ss << "#line " << nextLine << " 0\n";
 
-	return std::shared_ptr<Shader>(new Shader(source.c_str(), shaderType));
+	source.insert(versionEnd, ss.str());
+
+	return source;
 }
 
 
-Program::Program(const std::vector<std::shared_ptr<Shader> >& shaders) {
+Program::Program(const std::vector<std::shared_ptr<Shader> >& shaders, bool retrievable)
+    : m_linked(false) {
     m_id = GLCheck(glCreateProgram());
 
     for (int i = 0; i < shaders.size(); ++i) {
@@ -59,10 +176,144 @@ Program::Program(const std::vector<std::shared_ptr<Shader> >& shaders) {
         GLCheck(glAttachShader(m_id, shaders[i]->getId()));
 	}
 
+    if (retrievable && isBinarySupported()) {
+        GLCheck(glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
+
+    // the status is only asked for when the program is first used, asking now would wait for the compile
     GLCheck(glLinkProgram(m_id));
 }
 
+Program::Program(GLuint id)
+    : m_id(id)
+    , m_linked(true) {
+    readUniforms();
+}
+
+bool Program::isReady() const {
+    if (m_linked || !GLExtensions::hasParallelShaderCompile())
+        return true;
+
+    GLint completed;
+    GLCheck(glGetProgramiv(m_id, GL_COMPLETION_STATUS_KHR, &completed));
+
+    return completed == GL_TRUE;
+}
+
+bool Program::isLinked() const {
+    if (m_linked)
+        return true;
+
+    GLint linked;
+    GLCheck(glGetProgramiv(m_id, GL_LINK_STATUS, &linked));
+
+    return linked == GL_TRUE;
+}
+
+void Program::finishLink() const {
+    GLint linked;
+    GLCheck(glGetProgramiv(m_id, GL_LINK_STATUS, &linked));
+    if (linked == GL_FALSE) {
+        // a shader that didn't compile has the more useful log
+        for (size_t i = 0; i < m_shaders.size(); ++i) {
+            m_shaders[i]->checkCompiled();
+        }
+
+        throw r2ExceptionIOM("Failed to link program: " + getLog());
+    }
+
+    m_linked = true;
+    readUniforms();
+
+    for (size_t i = 0; i < m_pendingBindings.size(); ++i) {
+        applyBinding(m_pendingBindings[i]);
+    }
+    m_pendingBindings.clear();
+}
+
+bool Program::isBinarySupported() {
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+        return false;
+
+    GLint formatCount = 0;
+    GLCheck(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+
+    return formatCount > 0;
+}
+
+std::unique_ptr<Program> Program::createFromBinary(GLenum format, const std::vector<unsigned char>& binary) {
+    if (binary.empty() || !isBinarySupported())
+        return nullptr;
+
+    GLuint id = GLCheck(glCreateProgram());
+    GLCheck(glProgramBinary(id, format, &binary[0], binary.size()));
+
+    GLint linked;
+    GLCheck(glGetProgramiv(id, GL_LINK_STATUS, &linked));
+    if (linked == GL_FALSE) {
+        GLCheck(glDeleteProgram(id));
+        return nullptr;
+    }
+
+    return std::unique_ptr<Program>(new Program(id));
+}
+
+std::vector<unsigned char> Program::getBinary(GLenum& format) const {
+    GLint size = 0;
+    GLCheck(glGetProgramiv(getId(), GL_PROGRAM_BINARY_LENGTH, &size));
+
+    std::vector<unsigned char> binary(size);
+    if (size > 0) {
+        GLsizei written = 0;
+        GLCheck(glGetProgramBinary(m_id, size, &written, &format, &binary[0]));
+        binary.resize(written);
+    }
+
+    return binary;
+}
+
+std::string Program::getLog() const {
+    GLint logSize;
+    GLCheck(glGetProgramiv(m_id, GL_INFO_LOG_LENGTH, &logSize));
+    if (logSize <= 0)
+        return std::string();
+
+    std::vector<char> logBuffer(logSize);
+    GLCheck(glGetProgramInfoLog(m_id, logSize, NULL, &logBuffer[0]));
+
+    return &logBuffer[0];
+}
+
+void Program::readUniforms() const {
+    GLint uniformCount;
+    GLint maxNameLength;
+    GLCheck(glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &uniformCount));
+    GLCheck(glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength));
+
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+    for (GLint i = 0; i < uniformCount; ++i) {
+        UniformInfo uniform;
+        GLsizei nameLength;
+        GLCheck(glGetActiveUniform(m_id, i, nameBuffer.size(), &nameLength, &uniform.m_size, &uniform.m_type, &nameBuffer[0]));
+
+        uniform.m_name.assign(&nameBuffer[0], nameLength);
+        uniform.m_location = GLCheck(glGetUniformLocation(m_id, uniform.m_name.c_str()));
+
+        // members of uniform blocks have no location
+        if (uniform.m_location == -1)
+            continue;
+
+        if (uniform.m_name.size() > 3 && uniform.m_name.compare(uniform.m_name.size() - 3, 3, "[0]") == 0)
+            uniform.m_name.erase(uniform.m_name.size() - 3);
+
+        m_uniforms.push_back(uniform);
+    }
+
+    std::sort(m_uniforms.begin(), m_uniforms.end(), compareUniforms);
+}
+
 Program::~Program() {
+    GLState::forgetProgram(m_id);
     for (int i = 0; i < m_shaders.size(); ++i) {
         GLCheck(glDetachShader(m_id, m_shaders[i]->getId()));
 	}
@@ -70,3 +321,83 @@ Program::~Program() {
     GLCheck(glDeleteProgram(m_id));
 }
 
+const Program::UniformInfo* Program::getUniformInfo(const std::string& name) const {
+    getId();
+    std::vector<UniformInfo>::const_iterator it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), name, compareUniformName);
+    if (it == m_uniforms.end() || it->m_name != name)
+        return NULL;
+
+    return &*it;
+}
+
+GLint Program::getUniformLocation(const std::string& name) const {
+    const UniformInfo* info = getUniformInfo(name);
+    return (info != NULL) ? info->m_location : -1;
+}
+
+void Program::bindUniformBlock(const std::string& name, GLuint bindingPoint) {
+    PendingBinding binding = { name, (GLint) bindingPoint, true };
+    if (m_linked)
+        applyBinding(binding);
+    else
+        m_pendingBindings.push_back(binding);
+}
+
+void Program::setSamplerUnit(const std::string& name, GLint unit) {
+    PendingBinding binding = { name, unit, false };
+    if (m_linked)
+        applyBinding(binding);
+    else
+        m_pendingBindings.push_back(binding);
+}
+
+void Program::applyBinding(const PendingBinding& binding) const {
+    if (binding.m_block) {
+        GLuint index = GLCheck(glGetUniformBlockIndex(m_id, binding.m_name.c_str()));
+        if (index != GL_INVALID_INDEX) {
+            GLCheck(glUniformBlockBinding(m_id, index, binding.m_value));
+        }
+    } else {
+        GLState::useProgram(m_id);
+        Uniform<GLint>(*this, binding.m_name).set(binding.m_value);
+    }
+}
+
+
+void checkUniformType(const Program::UniformInfo& info, GLenum expectedType) {
+    if (info.m_type == expectedType)
+        return;
+    if (expectedType == GL_INT && isSamplerType(info.m_type))
+        return;
+
+    throw r2ExceptionArgumentM("Uniform has a different type than its handle: " + info.m_name);
+}
+
+template <> void Uniform<GLint>::upload(const GLint* values, GLsizei count) const {
+    GLCheck(glUniform1iv(m_location, count, values));
+}
+
+template <> void Uniform<GLfloat>::upload(const GLfloat* values, GLsizei count) const {
+    GLCheck(glUniform1fv(m_location, count, values));
+}
+
+template <> void Uniform<glm::vec2>::upload(const glm::vec2* values, GLsizei count) const {
+    GLCheck(glUniform2fv(m_location, count, &values[0][0]));
+}
+
+template <> void Uniform<glm::vec3>::upload(const glm::vec3* values, GLsizei count) const {
+    GLCheck(glUniform3fv(m_location, count, &values[0][0]));
+}
+
+template <> void Uniform<glm::vec4>::upload(const glm::vec4* values, GLsizei count) const {
+    GLCheck(glUniform4fv(m_location, count, &values[0][0]));
+}
+
+template <> void Uniform<glm::mat3>::upload(const glm::mat3* values, GLsizei count) const {
+    GLCheck(glUniformMatrix3fv(m_location, count, GL_FALSE, &values[0][0][0]));
+}
+
+template <> void Uniform<glm::mat4>::upload(const glm::mat4* values, GLsizei count) const {
+    GLCheck(glUniformMatrix4fv(m_location, count, GL_FALSE, &values[0][0][0]));
+}
+
@@ -1,24 +1,45 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <map>
 #include <memory>
 #include <vector>
 #include <string>
 #include <GL/glew.h>
+#include <glm/glm.hpp>
 #include "utility.hpp"
+#include "glstate.hpp"
+
+/** Preprocessor symbols to define in a shader, by name. An empty value defines the name alone. */
+typedef std::map<std::string, std::string> ShaderDefines;
 
 class Shader {
 public:
-    /** Expects the source as a NULL-terminated c-string */
+    /** Expects the source as a NULL-terminated c-string. Only issues the compile, checkCompiled waits for it. */
     Shader(const char* source, GLenum shaderType);
     ~Shader();
 
-    /** Load a shader from a file */
-    static std::shared_ptr<Shader> loadShader(const std::string& filename, GLenum shaderType);
+    /** Load a shader from a file, see readSource */
+    static std::shared_ptr<Shader> loadShader(const std::string& filename, GLenum shaderType, const ShaderDefines& defines = ShaderDefines());
+
+    /**
+     * Read the source of a shader file. Lines of the form #include "file" are replaced by the file, relative to the
+     * including one, unless it has been included already; they are spliced in whether or not they are inside an #if.
+     * The defines are inserted after the #version line. #line directives keep the compiler's line numbers pointing
+     * into the right file: the source string number is the order in which the files were first read, 0 being this one.
+     */
+    static std::string readSource(const std::string& filename, const ShaderDefines& defines = ShaderDefines());
 
     GLuint getId() const { return m_id; }
+
+    /** Whether the compile has finished, without waiting for it. Always true without parallel shader compilation. */
+    bool isReady() const;
+
+    /** Wait for the compile and throw with the info log if it failed */
+    void checkCompiled() const;
 private:
     GLuint m_id;
+    mutable bool m_checked;
 
     Shader(const Shader&);
     Shader& operator=(const Shader&);
@@ -26,22 +47,154 @@ private:
 
 class Program {
 public:
-    Program(const std::vector<std::shared_ptr<Shader> >& shaders);
+    /** An active uniform, as reported by the program after linking */
+    struct UniformInfo {
+        std::string m_name;     // Arrays without the [0] suffix
+        GLint m_location;
+        GLenum m_type;
+        GLint m_size;           // Number of array elements, 1 for non-arrays
+    };
+
+    /**
+     * Issues the link without waiting for it, so the driver can compile and link many programs at once.
+     * The link status is checked, and the active uniforms read back, when the program is first used.
+     * A retrievable program's binary can be read with getBinary.
+     */
+    Program(const std::vector<std::shared_ptr<Shader> >& shaders, bool retrievable = false);
     ~Program();
 
-    GLuint getId() const { return m_id; }
+    /** Whether programs can be saved and restored as driver specific binaries (GL 4.1 or ARB_get_program_binary) */
+    static bool isBinarySupported();
+
+    /** Restore a program from a binary, or return NULL if the driver rejects it, for example after an update */
+    static std::unique_ptr<Program> createFromBinary(GLenum format, const std::vector<unsigned char>& binary);
+
+    /** The linked binary of a retrievable program, in a format only the same driver can read */
+    std::vector<unsigned char> getBinary(GLenum& format) const;
+
+    /** Waits for the link, and throws if it or one of the shaders failed */
+    GLuint getId() const { if (!m_linked) finishLink(); return m_id; }
+
+    /** Whether the link has finished, without waiting for it. Always true without parallel shader compilation. */
+    bool isReady() const;
+
+    /** Whether the link succeeded. Waits for it, but unlike getId doesn't throw if it failed. */
+    bool isLinked() const;
+
+    /** The active uniform with the given name, or NULL if the program has none (it may have been optimized out) */
+    const UniformInfo* getUniformInfo(const std::string& name) const;
+
+    /** The location of the uniform, or -1 if it isn't active. Doesn't call into GL. */
+    GLint getUniformLocation(const std::string& name) const;
+
+    const std::vector<UniformInfo>& getUniforms() const { getId(); return m_uniforms; }
+
+    /**
+     * Bind a uniform block to a binding point (GLSL 4.00 has no layout(binding) for blocks). Inactive blocks are ignored.
+     * Doesn't wait for the link, the binding is applied once it has finished.
+     */
+    void bindUniformBlock(const std::string& name, GLuint bindingPoint);
+
+    /** Point a sampler uniform at a texture unit once the link has finished, which puts the program in use */
+    void setSamplerUnit(const std::string& name, GLint unit);
 private:
+    struct PendingBinding {
+        std::string m_name;
+        GLint m_value;
+        bool m_block;           // A uniform block binding point, otherwise a sampler unit
+    };
+
     GLuint m_id;
     std::vector<std::shared_ptr<Shader> > m_shaders;
+    mutable bool m_linked;                                  // The link has finished successfully
+    mutable std::vector<UniformInfo> m_uniforms;            // Sorted by name
+    mutable std::vector<PendingBinding> m_pendingBindings;  // Set before the link finished
+
+    /** Takes ownership of a program that has been linked successfully */
+    explicit Program(GLuint id);
+
+    /** Wait for the link, throw if it failed and otherwise read back the uniforms and apply the pending bindings */
+    void finishLink() const;
+
+    /** Read back the active uniforms once, so drawing never has to ask GL for a location */
+    void readUniforms() const;
+
+    void applyBinding(const PendingBinding& binding) const;
+
+    /** The info log of the program */
+    std::string getLog() const;
 
     Program(const Program&);
     Program& operator=(const Program&);
 };
 
+/** The GL type a uniform must have to be set from T. Samplers are set from GLint as well. */
+template <class T> struct UniformType;
+template <> struct UniformType<GLint> { static const GLenum TYPE = GL_INT; };
+template <> struct UniformType<GLfloat> { static const GLenum TYPE = GL_FLOAT; };
+template <> struct UniformType<glm::vec2> { static const GLenum TYPE = GL_FLOAT_VEC2; };
+template <> struct UniformType<glm::vec3> { static const GLenum TYPE = GL_FLOAT_VEC3; };
+template <> struct UniformType<glm::vec4> { static const GLenum TYPE = GL_FLOAT_VEC4; };
+template <> struct UniformType<glm::mat3> { static const GLenum TYPE = GL_FLOAT_MAT3; };
+template <> struct UniformType<glm::mat4> { static const GLenum TYPE = GL_FLOAT_MAT4; };
+
+/**
+ * A typed handle to a uniform of a program. The location is looked up once, when the handle is created,
+ * so setting it is a single glUniform* call. The program must be in use when setting it.
+ * Handles to inactive uniforms are valid, but setting them does nothing.
+ */
+template <class T>
+class Uniform {
+public:
+    Uniform() : m_location(-1), m_count(0) {}
+
+    /** Throws if the uniform is active but of another type */
+    Uniform(const Program& program, const std::string& name);
+
+    void set(const T& value) const { set(&value, 1); }
+
+    /** Set the first count elements of an array uniform. Elements beyond the array size are ignored. */
+    void set(const T* values, GLsizei count) const {
+        if (m_location != -1)
+            upload(values, (count < m_count) ? count : m_count);
+    }
+
+    GLint getLocation() const { return m_location; }
+    bool isActive() const { return m_location != -1; }
+private:
+    GLint m_location;
+    GLsizei m_count;
+
+    void upload(const T* values, GLsizei count) const;
+};
+
+/** Throws if the type of the uniform doesn't match */
+void checkUniformType(const Program::UniformInfo& info, GLenum expectedType);
+
+template <class T>
+Uniform<T>::Uniform(const Program& program, const std::string& name)
+    : m_location(-1)
+    , m_count(0) {
+    const Program::UniformInfo* info = program.getUniformInfo(name);
+    if (info != NULL) {
+        checkUniformType(*info, UniformType<T>::TYPE);
+        m_location = info->m_location;
+        m_count = info->m_size;
+    }
+}
+
+template <> void Uniform<GLint>::upload(const GLint* values, GLsizei count) const;
+template <> void Uniform<GLfloat>::upload(const GLfloat* values, GLsizei count) const;
+template <> void Uniform<glm::vec2>::upload(const glm::vec2* values, GLsizei count) const;
+template <> void Uniform<glm::vec3>::upload(const glm::vec3* values, GLsizei count) const;
+template <> void Uniform<glm::vec4>::upload(const glm::vec4* values, GLsizei count) const;
+template <> void Uniform<glm::mat3>::upload(const glm::mat3* values, GLsizei count) const;
+template <> void Uniform<glm::mat4>::upload(const glm::mat4* values, GLsizei count) const;
+
+/** Uses the program through the state cache. It stays in use after the scope, so using it again is free. */
 class glUseProgramState {
 public:
-    glUseProgramState(GLuint id) { GLCheck(glUseProgram(id)); }
-    ~glUseProgramState() { GLCheck(glUseProgram(0)); }
+    glUseProgramState(GLuint id) { GLState::useProgram(id); }
 };
 
 #endif
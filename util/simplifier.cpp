@@ -0,0 +1,354 @@
+#include "simplifier.hpp"
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+
+/** A symmetric 4x4 plane quadric, normalized by the accumulated area so it evaluates to a mean squared distance */
+struct Quadric {
+    double m_a00, m_a01, m_a02, m_a03;
+    double m_a11, m_a12, m_a13;
+    double m_a22, m_a23;
+    double m_a33;
+    double m_weight;
+
+    Quadric() {
+        memset(this, 0, sizeof(*this));
+    }
+
+    Quadric(const glm::vec3& n, float d, float weight) {
+        m_a00 = n.x * n.x * weight; m_a01 = n.x * n.y * weight; m_a02 = n.x * n.z * weight; m_a03 = n.x * d * weight;
+        m_a11 = n.y * n.y * weight; m_a12 = n.y * n.z * weight; m_a13 = n.y * d * weight;
+        m_a22 = n.z * n.z * weight; m_a23 = n.z * d * weight;
+        m_a33 = d * d * weight;
+        m_weight = weight;
+    }
+
+    void add(const Quadric& q) {
+        m_a00 += q.m_a00; m_a01 += q.m_a01; m_a02 += q.m_a02; m_a03 += q.m_a03;
+        m_a11 += q.m_a11; m_a12 += q.m_a12; m_a13 += q.m_a13;
+        m_a22 += q.m_a22; m_a23 += q.m_a23;
+        m_a33 += q.m_a33;
+        m_weight += q.m_weight;
+    }
+
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = m_a00 * x * x + 2 * m_a01 * x * y + 2 * m_a02 * x * z + 2 * m_a03 * x +
+                       m_a11 * y * y + 2 * m_a12 * y * z + 2 * m_a13 * y +
+                       m_a22 * z * z + 2 * m_a23 * z +
+                       m_a33;
+
+        return (m_weight > 0.0) ? std::fabs(error) / m_weight : 0.0;
+    }
+};
+
+// Weight of the squared edge length added to the cost, relative to the squared extent of the mesh. Breaks
+// ties between collapses on flat areas (which are all free) in favour of short edges, which keeps the
+// triangles well shaped instead of collapsing everything into a few fans.
+static const double EDGE_LENGTH_WEIGHT = 1e-4;
+
+struct Collapse {
+    GLuint m_from;
+    GLuint m_to;
+    double m_cost;          // m_error plus the edge length tie breaker, used for ordering
+    double m_error;
+    unsigned int m_fromVersion;
+    unsigned int m_toVersion;
+
+    bool operator>(const Collapse& other) const { return m_cost > other.m_cost; }
+};
+
+struct PositionKey {
+    glm::vec3 m_position;
+
+    bool operator==(const PositionKey& other) const { return m_position == other.m_position; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& key) const {
+        uint32_t bits[3];
+        memcpy(bits, &key.m_position[0], sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+static Collapse makeCollapse(GLuint from, GLuint to,
+                             const std::vector<Quadric>& quadrics,
+                             const std::vector<glm::vec3>& positions,
+                             double edgeWeight,
+                             const std::vector<unsigned int>& version) {
+    Quadric q = quadrics[from];
+    q.add(quadrics[to]);
+
+    glm::vec3 edge = positions[to] - positions[from];
+
+    Collapse collapse;
+    collapse.m_from = from;
+    collapse.m_to = to;
+    collapse.m_error = q.evaluate(positions[to]);
+    collapse.m_cost = collapse.m_error + edgeWeight * glm::dot(edge, edge);
+    collapse.m_fromVersion = version[from];
+    collapse.m_toVersion = version[to];
+
+    return collapse;
+}
+
+static glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    return glm::cross(b - a, c - a);
+}
+
+
+std::vector<GLuint> MeshSimplifier::simplify(const std::vector<GLuint>& indices,
+                                             const std::vector<glm::vec3>& positions,
+                                             size_t targetIndexCount,
+                                             float maxError,
+                                             float& resultError) {
+    resultError = 0.0f;
+
+    size_t vertexCount = positions.size();
+    size_t triangleCount = indices.size() / 3;
+    std::vector<GLuint> triangles(indices.begin(), indices.begin() + triangleCount * 3);
+
+    // vertices sharing a position with another vertex are on an attribute seam
+    std::vector<GLuint> wedge(vertexCount);
+    std::vector<unsigned int> wedgeCount(vertexCount, 0);
+    {
+        std::unordered_map<PositionKey, GLuint, PositionKeyHash> canonical;
+        for (size_t v = 0; v < vertexCount; ++v) {
+            PositionKey key = { positions[v] };
+            std::unordered_map<PositionKey, GLuint, PositionKeyHash>::iterator found = canonical.find(key);
+            if (found == canonical.end()) {
+                canonical[key] = v;
+                wedge[v] = v;
+            } else {
+                wedge[v] = found->second;
+            }
+
+            ++wedgeCount[wedge[v]];
+        }
+    }
+
+    // edges used by a single triangle (compared by position) are on an open border
+    std::vector<bool> lockedWedge(vertexCount, false);
+    {
+        std::unordered_map<uint64_t, unsigned int> edgeUse;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (size_t k = 0; k < 3; ++k) {
+                uint64_t a = wedge[triangles[t * 3 + k]];
+                uint64_t b = wedge[triangles[t * 3 + (k + 1) % 3]];
+                ++edgeUse[(std::min(a, b) << 32) | std::max(a, b)];
+            }
+        }
+
+        for (std::unordered_map<uint64_t, unsigned int>::iterator it = edgeUse.begin(); it != edgeUse.end(); ++it) {
+            if (it->second == 1) {
+                lockedWedge[it->first >> 32] = true;
+                lockedWedge[it->first & 0xFFFFFFFF] = true;
+            }
+        }
+    }
+
+    std::vector<bool> locked(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        locked[v] = lockedWedge[wedge[v]] || wedgeCount[wedge[v]] > 1;
+    }
+
+    // accumulate the area weighted plane quadrics and the vertex -> triangle adjacency
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<std::vector<GLuint> > vertexTriangles(vertexCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const glm::vec3& a = positions[triangles[t * 3 + 0]];
+        const glm::vec3& b = positions[triangles[t * 3 + 1]];
+        const glm::vec3& c = positions[triangles[t * 3 + 2]];
+
+        glm::vec3 normal = triangleNormal(a, b, c);
+        float area = glm::length(normal);
+        if (area > 0.0f) {
+            normal /= area;
+
+            Quadric q(normal, -glm::dot(normal, a), area);
+            for (size_t k = 0; k < 3; ++k) {
+                quadrics[triangles[t * 3 + k]].add(q);
+            }
+        }
+
+        for (size_t k = 0; k < 3; ++k) {
+            vertexTriangles[triangles[t * 3 + k]].push_back(t);
+        }
+    }
+
+    std::vector<bool> alive(triangleCount, true);
+    std::vector<unsigned int> version(vertexCount, 0);
+    std::vector<bool> removed(vertexCount, false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > queue;
+
+    glm::vec3 minimum(0.0f);
+    glm::vec3 maximum(0.0f);
+    if (vertexCount > 0) {
+        minimum = maximum = positions[0];
+        for (size_t v = 1; v < vertexCount; ++v) {
+            minimum = glm::min(minimum, positions[v]);
+            maximum = glm::max(maximum, positions[v]);
+        }
+    }
+    double extent = glm::length(maximum - minimum);
+    double edgeWeight = (extent > 0.0) ? EDGE_LENGTH_WEIGHT / (extent * extent) : 0.0;
+
+    // queue both directions of every edge that starts at an unlocked vertex
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (size_t k = 0; k < 3; ++k) {
+            GLuint from = triangles[t * 3 + k];
+            GLuint to = triangles[t * 3 + (k + 1) % 3];
+
+            for (int direction = 0; direction < 2; ++direction) {
+                if (!locked[from] && from != to) {
+                    queue.push(makeCollapse(from, to, quadrics, positions, edgeWeight, version));
+                }
+
+                std::swap(from, to);
+            }
+        }
+    }
+
+    size_t liveIndexCount = triangleCount * 3;
+    double maxCost = (double) maxError * maxError;
+    double resultCost = 0.0;
+
+    while (liveIndexCount > targetIndexCount && !queue.empty()) {
+        Collapse collapse = queue.top();
+        queue.pop();
+
+        // skip collapses queued before either end changed
+        if (removed[collapse.m_from] || removed[collapse.m_to] ||
+            version[collapse.m_from] != collapse.m_fromVersion || version[collapse.m_to] != collapse.m_toVersion)
+            continue;
+
+        if (collapse.m_error > maxCost)
+            break;
+
+        GLuint from = collapse.m_from;
+        GLuint to = collapse.m_to;
+
+        // reject the collapse if it would flip any of the remaining triangles
+        bool flips = false;
+        for (size_t i = 0; i < vertexTriangles[from].size() && !flips; ++i) {
+            GLuint t = vertexTriangles[from][i];
+            GLuint* triangle = &triangles[t * 3];
+            if (!alive[t] || triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                continue;
+
+            glm::vec3 corners[3];
+            for (size_t k = 0; k < 3; ++k) {
+                corners[k] = positions[triangle[k]];
+            }
+            glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+
+            for (size_t k = 0; k < 3; ++k) {
+                if (triangle[k] == from)
+                    corners[k] = positions[to];
+            }
+            glm::vec3 after = triangleNormal(corners[0], corners[1], corners[2]);
+
+            flips = glm::dot(before, after) <= 0.0f;
+        }
+
+        if (flips)
+            continue;
+
+        // collapse from onto to, dropping the triangles that become degenerate
+        for (size_t i = 0; i < vertexTriangles[from].size(); ++i) {
+            GLuint t = vertexTriangles[from][i];
+            GLuint* triangle = &triangles[t * 3];
+            if (!alive[t])
+                continue;
+
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                alive[t] = false;
+                liveIndexCount -= 3;
+                continue;
+            }
+
+            for (size_t k = 0; k < 3; ++k) {
+                if (triangle[k] == from)
+                    triangle[k] = to;
+            }
+            vertexTriangles[to].push_back(t);
+        }
+
+        quadrics[to].add(quadrics[from]);
+        removed[from] = true;
+        ++version[from];
+        ++version[to];
+        resultCost = std::max(resultCost, collapse.m_error);
+
+        // drop the dead triangles from the merged vertex, so its list doesn't keep growing
+        std::vector<GLuint>& toTriangles = vertexTriangles[to];
+        size_t liveCount = 0;
+        for (size_t i = 0; i < toTriangles.size(); ++i) {
+            if (alive[toTriangles[i]])
+                toTriangles[liveCount++] = toTriangles[i];
+        }
+        toTriangles.resize(liveCount);
+        std::vector<GLuint>().swap(vertexTriangles[from]);
+
+        // requeue the edges around the merged vertex with the new quadric
+        for (size_t i = 0; i < toTriangles.size(); ++i) {
+            GLuint t = toTriangles[i];
+
+            for (size_t k = 0; k < 3; ++k) {
+                GLuint other = triangles[t * 3 + k];
+                if (other == to)
+                    continue;
+
+                if (!locked[other])
+                    queue.push(makeCollapse(other, to, quadrics, positions, edgeWeight, version));
+                if (!locked[to])
+                    queue.push(makeCollapse(to, other, quadrics, positions, edgeWeight, version));
+            }
+        }
+    }
+
+    std::vector<GLuint> result;
+    result.reserve(liveIndexCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (alive[t])
+            result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+    }
+
+    resultError = (float) std::sqrt(resultCost);
+    return result;
+}
+
+void MeshSimplifier::generateLods(Mesh::GroupData& group, size_t maxLevels, float reduction) {
+    group.m_lods.clear();
+    if (group.m_vertices.empty())
+        return;
+
+    // never accept collapses with an error beyond a quarter of the group's extent
+    glm::vec3 minimum = group.m_vertices[0];
+    glm::vec3 maximum = group.m_vertices[0];
+    for (size_t i = 1; i < group.m_vertices.size(); ++i) {
+        minimum = glm::min(minimum, group.m_vertices[i]);
+        maximum = glm::max(maximum, group.m_vertices[i]);
+    }
+    float maxError = glm::length(maximum - minimum) * 0.25f;
+
+    size_t previousCount = group.m_indices.size();
+    for (size_t level = 1; level < maxLevels; ++level) {
+        size_t target = (size_t) (previousCount * reduction) / 3 * 3;
+
+        // simplify from the full resolution every time, so the error is relative to what is replaced
+        Mesh::LodData lod;
+        lod.m_indices = simplify(group.m_indices, group.m_vertices, target, maxError, lod.m_error);
+
+        // stop when the locked vertices or the error bound keep the level from getting smaller
+        if (lod.m_indices.empty() || lod.m_indices.size() > previousCount * 0.9f)
+            break;
+
+        previousCount = lod.m_indices.size();
+        group.m_lods.push_back(lod);
+    }
+}
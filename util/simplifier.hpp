@@ -0,0 +1,34 @@
+#ifndef SIMPLIFIER_HPP
+#define SIMPLIFIER_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include "mesh.hpp"
+
+/**
+ * Simplifies groups with quadric error metric edge collapses. Vertices are only ever collapsed
+ * onto existing vertices, so all levels of detail of a group share its vertex buffer.
+ * Vertices on open borders and attribute seams are locked to keep the mesh watertight.
+ */
+class MeshSimplifier {
+public:
+    /**
+     * Collapse edges until at most targetIndexCount indices remain or no collapse is cheaper than maxError.
+     * The error of the result, as an object space distance, is written to resultError.
+     */
+    static std::vector<GLuint> simplify(const std::vector<GLuint>& indices,
+                                        const std::vector<glm::vec3>& positions,
+                                        size_t targetIndexCount,
+                                        float maxError,
+                                        float& resultError);
+
+    /**
+     * Replace the levels of detail of the group with a chain where each level has roughly
+     * reduction times the triangles of the previous one. Stops early when a level no longer
+     * gets meaningfully smaller.
+     */
+    static void generateLods(Mesh::GroupData& group, size_t maxLevels = 4, float reduction = 0.5f);
+};
+
+#endif
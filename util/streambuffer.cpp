@@ -0,0 +1,147 @@
+#include "streambuffer.hpp"
+#include "glextensions.hpp"
+#include <r2tk/r2-exception.hpp>
+
+// How long to block at a time when waiting for a fence, in nanoseconds
+static const GLuint64 FENCE_TIMEOUT = 1000000;
+
+StreamBuffer::StreamBuffer(size_t regionSize, bool allowPersistent)
+    : m_regionSize(0)
+    , m_persistent(allowPersistent && GLExtensions::hasBufferStorage())
+    , m_region(0)
+    , m_head(0)
+    , m_mapped(NULL)
+    , m_mapOffset(0) {
+    for (size_t i = 0; i < REGION_COUNT; ++i) {
+        m_fences[i] = NULL;
+    }
+
+    create(regionSize);
+}
+
+StreamBuffer::~StreamBuffer() {
+    flush();
+
+    for (size_t i = 0; i < REGION_COUNT; ++i) {
+        if (m_fences[i] != NULL) {
+            GLCheck(glDeleteSync(m_fences[i]));
+        }
+    }
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(size_t size, size_t alignment) {
+    size_t offset = (m_head + alignment - 1) / alignment * alignment;
+    if (offset + size > m_regionSize) {
+        size_t regionSize = m_regionSize * 2;
+        while (regionSize < size) {
+            regionSize *= 2;
+        }
+
+        create(regionSize);
+        ++m_stats.m_reallocations;
+        offset = 0;
+    }
+
+    size_t bufferOffset = m_region * m_regionSize + offset;
+
+    // without persistent mapping, map what is left of the region; nothing in flight reads it
+    if (m_mapped == NULL) {
+        glBindBufferState bufferState(GL_COPY_WRITE_BUFFER, m_buffer->getId());
+        m_mapped = (unsigned char*) GLCheck(glMapBufferRange(GL_COPY_WRITE_BUFFER, bufferOffset, (m_region + 1) * m_regionSize - bufferOffset,
+                                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+        if (m_mapped == NULL)
+            throw r2ExceptionRuntimeM("Failed to map stream buffer");
+        m_mapOffset = bufferOffset;
+    }
+
+    m_head = offset + size;
+    m_stats.m_allocated += size;
+
+    Allocation allocation;
+    allocation.m_data = m_mapped + (bufferOffset - m_mapOffset);
+    allocation.m_buffer = m_buffer->getId();
+    allocation.m_offset = bufferOffset;
+
+    return allocation;
+}
+
+void StreamBuffer::flush() {
+    // coherent mappings need no flushing
+    if (m_persistent || m_mapped == NULL)
+        return;
+
+    glBindBufferState bufferState(GL_COPY_WRITE_BUFFER, m_buffer->getId());
+    GLCheck(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+    m_mapped = NULL;
+}
+
+void StreamBuffer::endFrame() {
+    flush();
+
+    if (m_persistent) {
+        m_fences[m_region] = GLCheck(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    }
+
+    m_retired.clear();
+    m_region = (m_region + 1) % REGION_COUNT;
+    m_head = 0;
+
+    if (m_persistent) {
+        waitForRegion(m_region);
+    } else if (m_region == 0) {
+        // every region of the storage has been used, so continue in new storage
+        glBindBufferState bufferState(GL_COPY_WRITE_BUFFER, m_buffer->getId());
+        GLCheck(glBufferData(GL_COPY_WRITE_BUFFER, m_regionSize * REGION_COUNT, NULL, GL_STREAM_DRAW));
+        ++m_stats.m_orphans;
+    }
+}
+
+void StreamBuffer::create(size_t regionSize) {
+    flush();
+
+    // the allocations made so far this frame stay valid until it ends, and the fences refer to the old buffer
+    if (m_buffer)
+        m_retired.push_back(std::move(m_buffer));
+
+    for (size_t i = 0; i < REGION_COUNT; ++i) {
+        if (m_fences[i] != NULL) {
+            GLCheck(glDeleteSync(m_fences[i]));
+            m_fences[i] = NULL;
+        }
+    }
+
+    m_buffer.reset(new VBO);
+    m_regionSize = regionSize;
+    m_region = 0;
+    m_head = 0;
+    m_mapped = NULL;
+    m_mapOffset = 0;
+
+    glBindBufferState bufferState(GL_COPY_WRITE_BUFFER, m_buffer->getId());
+    if (m_persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLCheck(GLExtensions::bufferStorage(GL_COPY_WRITE_BUFFER, m_regionSize * REGION_COUNT, NULL, flags));
+        m_mapped = (unsigned char*) GLCheck(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_regionSize * REGION_COUNT, flags));
+        if (m_mapped == NULL)
+            throw r2ExceptionRuntimeM("Failed to map stream buffer persistently");
+    } else {
+        GLCheck(glBufferData(GL_COPY_WRITE_BUFFER, m_regionSize * REGION_COUNT, NULL, GL_STREAM_DRAW));
+    }
+}
+
+void StreamBuffer::waitForRegion(size_t region) {
+    GLsync& fence = m_fences[region];
+    if (fence == NULL)
+        return;
+
+    GLenum result = GLCheck(glClientWaitSync(fence, 0, 0));
+    if (result == GL_TIMEOUT_EXPIRED) {
+        ++m_stats.m_fenceWaits;
+        do {
+            result = GLCheck(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT));
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+
+    GLCheck(glDeleteSync(fence));
+    fence = NULL;
+}
@@ -0,0 +1,78 @@
+#ifndef STREAMBUFFER_HPP
+#define STREAMBUFFER_HPP
+
+#include <vector>
+#include <memory>
+#include <GL/glew.h>
+#include "buffer.hpp"
+
+/**
+ * A ring of REGION_COUNT per-frame regions that data written by the CPU every frame (instance data,
+ * uniform blocks, debug geometry) is sub-allocated from. With buffer storage, the buffer is mapped
+ * once, persistently and coherently, and each region is fenced when its frame ends so it is only
+ * rewritten once the GPU is done with it. Without it, the unused part of the region is mapped
+ * unsynchronized when allocating and the buffer is orphaned whenever the ring wraps around.
+ *
+ * Fill an allocation before making the next one, and flush before drawing with them.
+ */
+class StreamBuffer {
+public:
+    static const size_t REGION_COUNT = 3;
+
+    struct Allocation {
+        void* m_data;
+        GLuint m_buffer;        // Growing the region replaces the buffer, so bind this rather than getId
+        size_t m_offset;        // In bytes, from the start of the buffer
+    };
+
+    struct Stats {
+        size_t m_allocated;     // Bytes
+        size_t m_fenceWaits;    // Regions the GPU was still reading when they came around again
+        size_t m_orphans;
+        size_t m_reallocations;
+
+        Stats() : m_allocated(0), m_fenceWaits(0), m_orphans(0), m_reallocations(0) {}
+    };
+
+    /** Persistent mapping is used if buffer storage is available, unless it is disallowed */
+    explicit StreamBuffer(size_t regionSize = 1024 * 1024, bool allowPersistent = true);
+    ~StreamBuffer();
+
+    /** Reserve space in this frame's region, doubling the regions if it doesn't fit */
+    Allocation allocate(size_t size, size_t alignment = 16);
+
+    /** Make everything written so far visible to GL */
+    void flush();
+
+    /** Fence this frame's region and move on to the next, waiting for the GPU if it is still in use */
+    void endFrame();
+
+    GLuint getId() const { return m_buffer->getId(); }
+    size_t getRegionSize() const { return m_regionSize; }
+    bool isPersistent() const { return m_persistent; }
+
+    const Stats& getStats() const { return m_stats; }
+    void resetStats() { m_stats = Stats(); }
+private:
+    std::unique_ptr<VBO> m_buffer;
+    std::vector<std::unique_ptr<VBO> > m_retired;   // Replaced this frame, still referenced by its allocations
+    size_t m_regionSize;
+    bool m_persistent;
+
+    size_t m_region;
+    size_t m_head;                  // From the start of the region
+    GLsync m_fences[REGION_COUNT];
+
+    unsigned char* m_mapped;        // The persistent mapping of the whole buffer, or the current unsynchronized mapping
+    size_t m_mapOffset;             // Where m_mapped points to in the buffer
+
+    Stats m_stats;
+
+    void create(size_t regionSize);
+    void waitForRegion(size_t region);
+
+    StreamBuffer(const StreamBuffer&);
+    StreamBuffer& operator=(const StreamBuffer&);
+};
+
+#endif
@@ -1,5 +1,8 @@
 #include "template.hpp"
 #include "utility.hpp"
+#include "glextensions.hpp"
+#include "samplercache.hpp"
+#include "programcache.hpp"
 #include <cstring>
 #include <sstream>
 #include <GL/glew.h>
@@ -50,6 +53,11 @@ LabApplication::LabApplication()
     ilInit();
 }
 
+LabApplication::~LabApplication() throw() {
+    m_lab.reset();
+    SamplerCache::clear();
+}
+
 void LabApplication::createContext(const ContextDescription& description) {
     m_windowTitle = description.m_windowTitle;
 
@@ -58,7 +66,11 @@ void LabApplication::createContext(const ContextDescription& description) {
     glfwOpenWindowHint(GLFW_OPENGL_VERSION_MINOR, description.m_openglVersionMinor);
     glfwOpenWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwOpenWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef UTIL_GL_DEBUG
+    glfwOpenWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#else
     glfwOpenWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_FALSE);
+#endif
 
     int mode = description.m_fullscreen ? GLFW_FULLSCREEN : GLFW_WINDOW;
     int windowOpened = glfwOpenWindow(description.m_windowWidth,
@@ -92,6 +104,18 @@ void LabApplication::createContext(const ContextDescription& description) {
         throw r2ExceptionRuntimeM(errorMessage.str());
     }
 
+    // Load what GLEW doesn't know about
+    GLExtensions::load();
+
+    // Let the driver compile on as many threads as it likes, the programs are only waited for when first used
+    if (GLExtensions::hasParallelShaderCompile())
+        GLExtensions::maxShaderCompilerThreads(0xFFFFFFFF);
+
+#ifdef UTIL_GL_DEBUG
+    if (!GLDebug::install())
+        std::cerr << "WARNING: The context supports neither KHR_debug nor ARB_debug_output, GL errors will not be reported" << std::endl;
+#endif
+
     // Setup default OpenGL state
     GLCheck(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
 
@@ -159,6 +183,9 @@ void LabApplication::run(int ticksPerSecond, int maxTicksPerFrame) {
 
         float interpolation = 1.0f + (glfwGetTime() - nextTick) / DT;
         onRenderWrapper(DT, interpolation);
+
+        // Save the programs that finished linking in the background
+        ProgramCache::update();
     }
 }
 
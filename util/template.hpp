@@ -62,6 +62,9 @@ public:
     /** Initialize GLFW and DevIL */
     LabApplication();
 
+    /** Release the lab and the shared GL objects while the context is still there */
+    ~LabApplication() throw();
+
     /** Create a window and an OpenGL context.  */
     void createContext(const ContextDescription& description);
 
@@ -1,59 +1,333 @@
 #include "texture.hpp"
 #include "utility.hpp"
+#include "glstate.hpp"
+#include "textureunits.hpp"
+#include "glextensions.hpp"
 #include <sstream>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
 #include <r2tk/r2-exception.hpp>
 #include <IL/il.h>
 
-GLuint Texture::s_nextUnitId = 1;
+std::mutex Texture::s_decodeMutex;
+
+static const char DDS_MAGIC[4] = { 'D', 'D', 'S', ' ' };
+
+// DDS header flags, only the ones needed for block compressed mip chains
+static const uint32_t DDSD_CAPS = 0x1;
+static const uint32_t DDSD_HEIGHT = 0x2;
+static const uint32_t DDSD_WIDTH = 0x4;
+static const uint32_t DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSCAPS_COMPLEX = 0x8;
+static const uint32_t DDSCAPS_TEXTURE = 0x1000;
+static const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+static const uint32_t FOURCC_DXT1 = 0x31545844;    // "DXT1"
+static const uint32_t FOURCC_DXT5 = 0x35545844;    // "DXT5"
+
+// the largest texture Direct3D 11 allows, which DDS files are written for; larger headers are taken as corrupt
+static const uint32_t DDS_MAX_SIZE = 16384;
+
+/** The DDS_HEADER that follows the magic */
+struct DDSHeader {
+    uint32_t m_size;
+    uint32_t m_flags;
+    uint32_t m_height;
+    uint32_t m_width;
+    uint32_t m_pitchOrLinearSize;
+    uint32_t m_depth;
+    uint32_t m_mipMapCount;
+    uint32_t m_reserved1[11];
+    uint32_t m_pixelFormatSize;
+    uint32_t m_pixelFormatFlags;
+    uint32_t m_fourCC;
+    uint32_t m_rgbBitCount;
+    uint32_t m_rBitMask;
+    uint32_t m_gBitMask;
+    uint32_t m_bBitMask;
+    uint32_t m_aBitMask;
+    uint32_t m_caps;
+    uint32_t m_caps2;
+    uint32_t m_caps3;
+    uint32_t m_caps4;
+    uint32_t m_reserved2;
+};
+
+/** The size of a level of an S3TC image, in whole 4x4 blocks */
+static size_t getCompressedSize(GLenum format, GLsizei width, GLsizei height) {
+    size_t blockSize = (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
+    return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+size_t Texture::Image::getSize() const {
+    size_t size = 0;
+    for (size_t i = 0; i < m_levels.size(); ++i) {
+        size += m_levels[i].m_data.size();
+    }
+
+    return size;
+}
 
 Texture::Texture() {
     GLCheck(glGenTextures(1, &m_id));
-    GLCheck(glGenSamplers(1, &m_samplerId));
-    m_unitId = s_nextUnitId++;
 }
 
 Texture::~Texture() {
+    releaseHandles(false);
+    GLState::forgetTexture(m_id);
     GLCheck(glDeleteTextures(1, &m_id));
-    GLCheck(glDeleteSamplers(1, &m_samplerId));
+}
+
+void Texture::upload(const Image& image, bool fromPixelBuffer) {
+    releaseHandles(true);
+
+    GLState::bindTexture(TextureUnits::UPLOAD_UNIT, GL_TEXTURE_2D, m_id);
+    GLState::activeTexture(TextureUnits::UPLOAD_UNIT);
+
+    // the rows are tightly packed, which RGB images of odd widths aren't by GL's default
+    GLCheck(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+    size_t offset = 0;
+    for (size_t i = 0; i < image.m_levels.size(); ++i) {
+        const Image::Level& level = image.m_levels[i];
+        const GLvoid* data = fromPixelBuffer ? (const GLvoid*) offset : (const GLvoid*) &level.m_data[0];
+
+        if (image.m_compressed) {
+            GLCheck(glCompressedTexImage2D(GL_TEXTURE_2D, i, image.m_format, level.m_width, level.m_height, 0, level.m_data.size(), data));
+        } else {
+            GLCheck(glTexImage2D(GL_TEXTURE_2D, i, image.m_format, level.m_width, level.m_height, 0, image.m_format, GL_UNSIGNED_BYTE, data));
+        }
+
+        offset += level.m_data.size();
+    }
+
+    // a replaced image may have fewer levels than the last one
+    GLCheck(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
+    if (image.m_levels.size() == 1 && !image.m_compressed) {
+        GLCheck(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000));
+        GLCheck(glGenerateMipmap(GL_TEXTURE_2D));
+    } else {
+        GLCheck(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.m_levels.size() - 1));
+    }
+}
+
+GLuint64 Texture::getBindlessHandle(GLuint sampler) {
+    for (size_t i = 0; i < m_handles.size(); ++i) {
+        if (m_handles[i].m_sampler == sampler)
+            return m_handles[i].m_handle;
+    }
+
+    BindlessHandle handle;
+    handle.m_sampler = sampler;
+    handle.m_handle = GLCheck(GLExtensions::getTextureSamplerHandle(m_id, sampler));
+    GLCheck(GLExtensions::makeTextureHandleResident(handle.m_handle));
+    m_handles.push_back(handle);
+
+    return handle.m_handle;
+}
+
+void Texture::releaseHandles(bool recreate) {
+    if (m_handles.empty())
+        return;
+
+    for (size_t i = 0; i < m_handles.size(); ++i) {
+        GLCheck(GLExtensions::makeTextureHandleNonResident(m_handles[i].m_handle));
+    }
+    m_handles.clear();
+
+    if (recreate) {
+        GLState::forgetTexture(m_id);
+        GLCheck(glDeleteTextures(1, &m_id));
+        GLCheck(glGenTextures(1, &m_id));
+    }
 }
 
 std::shared_ptr<Texture> Texture::loadTexture(const std::string& filename) {
+    Image image = readImage(filename);
+
     std::shared_ptr<Texture> texture(new Texture);
-    
+    texture->upload(image);
+
+    return texture;
+}
+
+std::shared_ptr<Texture> Texture::createPlaceholder() {
+    static const unsigned char GREY[] = { 128, 128, 128, 255 };
+
+    Image image;
+    image.m_format = GL_RGBA;
+    image.m_compressed = false;
+    image.m_levels.resize(1);
+    image.m_levels[0].m_width = 1;
+    image.m_levels[0].m_height = 1;
+    image.m_levels[0].m_data.assign(GREY, GREY + sizeof(GREY));
+
+    std::shared_ptr<Texture> texture(new Texture);
+    texture->upload(image);
+
+    return texture;
+}
+
+Texture::Image Texture::readImage(const std::string& filename) {
+    std::string bakedFile = getBakedFilename(filename);
+    if (GLEW_EXT_texture_compression_s3tc && std::ifstream(bakedFile.c_str()).is_open())
+        return readDDS(bakedFile);
+
+    return decodeImage(filename);
+}
+
+Texture::Image Texture::decodeImage(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(s_decodeMutex);
+
     ILuint imageName;
     ilGenImages(1, &imageName);
     ilBindImage(imageName);
     if (!ilLoadImage(filename.c_str())) {
+        ilBindImage(0);
+        ilDeleteImages(1, &imageName);
 		throw r2ExceptionIOM("Failed to load texture image: " + filename);
     }
 
-    GLCheck(glBindTexture(GL_TEXTURE_2D, texture->getId()));
-
     ILuint imageWidth = ilGetInteger(IL_IMAGE_WIDTH);
     ILuint imageHeight = ilGetInteger(IL_IMAGE_HEIGHT);
     ILuint imageBpp = ilGetInteger(IL_IMAGE_BPP);
     ILubyte* imageData = ilGetData();
-    GLenum format = (imageBpp == 3) ? GL_RGB : GL_RGBA;
 
     if (imageBpp != 3 && imageBpp != 4) {
+        ilBindImage(0);
+        ilDeleteImages(1, &imageName);
+
 		std::stringstream ss;
 		ss << "Texture image in bad format (bytes per pixel = " << imageBpp << "): " << filename;
 
 		throw r2ExceptionIOM(ss.str());
     }
 
-    GLCheck(glTexImage2D(GL_TEXTURE_2D,
-                0,
-                format,
-                imageWidth,
-                imageHeight,
-                0,
-                format,
-                GL_UNSIGNED_BYTE,
-                (const GLvoid*)imageData));
+    Image image;
+    image.m_format = (imageBpp == 3) ? GL_RGB : GL_RGBA;
+    image.m_compressed = false;
+    image.m_levels.resize(1);
+    image.m_levels[0].m_width = imageWidth;
+    image.m_levels[0].m_height = imageHeight;
+    image.m_levels[0].m_data.assign(imageData, imageData + imageWidth * imageHeight * imageBpp);
 
     ilBindImage(0);
     ilDeleteImages(1, &imageName);
 
-    return texture;
+    return image;
+}
+
+Texture::Image Texture::readDDS(const std::string& filename) {
+    std::ifstream fs(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!fs.is_open()) {
+        throw r2ExceptionIOM("Failed to open DDS file: " + filename);
+    }
+
+    char magic[sizeof(DDS_MAGIC)];
+    DDSHeader header;
+    fs.read(magic, sizeof(magic));
+    fs.read((char*) &header, sizeof(header));
+    if (fs.fail() || memcmp(magic, DDS_MAGIC, sizeof(DDS_MAGIC)) != 0 || header.m_size != sizeof(DDSHeader)) {
+        throw r2ExceptionIOM("Not a DDS file: " + filename);
+    }
+
+    if ((header.m_pixelFormatFlags & DDPF_FOURCC) == 0 || (header.m_fourCC != FOURCC_DXT1 && header.m_fourCC != FOURCC_DXT5)) {
+        throw r2ExceptionIOM("Unsupported DDS format, only DXT1 and DXT5 can be read: " + filename);
+    }
+
+    Image image;
+    image.m_format = (header.m_fourCC == FOURCC_DXT1) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    image.m_compressed = true;
+
+    if (header.m_width == 0 || header.m_height == 0 || header.m_width > DDS_MAX_SIZE || header.m_height > DDS_MAX_SIZE) {
+        throw r2ExceptionIOM("Invalid DDS dimensions: " + filename);
+    }
+
+    // a full mip chain goes down to 1x1, floor(log2(max(width, height))) + 1 levels
+    size_t maxLevelCount = 1;
+    for (uint32_t size = std::max(header.m_width, header.m_height); size > 1; size /= 2) {
+        ++maxLevelCount;
+    }
+
+    size_t levelCount = ((header.m_flags & DDSD_MIPMAPCOUNT) && header.m_mipMapCount > 0) ? header.m_mipMapCount : 1;
+    if (levelCount > maxLevelCount) {
+        throw r2ExceptionIOM("Too many mipmap levels in DDS file: " + filename);
+    }
+
+    // check the levels are all there before allocating them
+    GLsizei width = header.m_width;
+    GLsizei height = header.m_height;
+    size_t dataSize = 0;
+    for (size_t i = 0; i < levelCount; ++i) {
+        dataSize += getCompressedSize(image.m_format, std::max(width >> i, 1), std::max(height >> i, 1));
+    }
+
+    std::streampos dataStart = fs.tellg();
+    fs.seekg(0, std::ifstream::end);
+    std::streamoff remaining = fs.tellg() - dataStart;
+    fs.seekg(dataStart);
+    if (fs.fail() || remaining < (std::streamoff) dataSize) {
+        throw r2ExceptionIOM("Truncated DDS file: " + filename);
+    }
+
+    for (size_t i = 0; i < levelCount; ++i) {
+        Image::Level level;
+        level.m_width = width;
+        level.m_height = height;
+        level.m_data.resize(getCompressedSize(image.m_format, width, height));
+
+        fs.read((char*) &level.m_data[0], level.m_data.size());
+        if (fs.fail()) {
+            throw r2ExceptionIOM("Truncated DDS file: " + filename);
+        }
+
+        image.m_levels.push_back(level);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    return image;
+}
+
+void Texture::writeDDS(const std::string& filename, const Image& image) {
+    if (!image.m_compressed || image.m_levels.empty() ||
+        (image.m_format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && image.m_format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)) {
+        throw r2ExceptionArgumentM("Only DXT1 and DXT5 images can be written as DDS: " + filename);
+    }
+
+    DDSHeader header;
+    memset(&header, 0, sizeof(header));
+    header.m_size = sizeof(DDSHeader);
+    header.m_flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.m_height = image.m_levels[0].m_height;
+    header.m_width = image.m_levels[0].m_width;
+    header.m_pitchOrLinearSize = image.m_levels[0].m_data.size();
+    header.m_mipMapCount = image.m_levels.size();
+    header.m_pixelFormatSize = 32;
+    header.m_pixelFormatFlags = DDPF_FOURCC;
+    header.m_fourCC = (image.m_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? FOURCC_DXT1 : FOURCC_DXT5;
+    header.m_caps = DDSCAPS_TEXTURE | ((image.m_levels.size() > 1) ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    std::ofstream fs(filename.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!fs.is_open()) {
+        throw r2ExceptionIOM("Failed to open DDS file for writing: " + filename);
+    }
+
+    fs.write(DDS_MAGIC, sizeof(DDS_MAGIC));
+    fs.write((const char*) &header, sizeof(header));
+    for (size_t i = 0; i < image.m_levels.size(); ++i) {
+        fs.write((const char*) &image.m_levels[i].m_data[0], image.m_levels[i].m_data.size());
+    }
+
+    if (fs.fail()) {
+        throw r2ExceptionIOM("Failed to write DDS file: " + filename);
+    }
+}
+
+std::string Texture::getBakedFilename(const std::string& sourceFile) {
+    return sourceFile + ".dds";
 }
@@ -3,24 +3,79 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <mutex>
 #include <GL/glew.h>
 
 class Texture {
 public:
+    /** A decoded or block compressed image, with tightly packed rows */
+    struct Image {
+        struct Level {
+            GLsizei m_width;
+            GLsizei m_height;
+            std::vector<unsigned char> m_data;
+        };
+
+        GLenum m_format;            // GL_RGB or GL_RGBA, or an S3TC format if compressed
+        bool m_compressed;
+        std::vector<Level> m_levels;    // Full resolution first. A single uncompressed level gets its mipmaps generated on upload.
+
+        size_t getSize() const;
+    };
+
     Texture();
     ~Texture();
 
     GLuint getId() const { return m_id; }
-    GLuint getUnitId() const { return m_unitId; }
-    GLuint getSamplerId() const { return m_samplerId; }
 
+    /**
+     * Replace the image. The levels are read from client memory or, with fromPixelBuffer, from the buffer
+     * bound to GL_PIXEL_UNPACK_BUFFER, where they are expected one after the other from offset 0.
+     */
+    void upload(const Image& image, bool fromPixelBuffer = false);
+
+    /**
+     * A resident bindless handle for sampling the texture through the sampler, created on first use.
+     * Needs GLExtensions::hasBindlessTexture. A texture with handles can't change, so an upload after
+     * this replaces the texture object, releasing the handles and changing the id.
+     */
+    GLuint64 getBindlessHandle(GLuint sampler);
+
+    /** Load and upload an image on the calling thread, preferring its baked version */
     static std::shared_ptr<Texture> loadTexture(const std::string& filename);
+
+    /** A texture with a single grey texel, for use until the real image has been uploaded */
+    static std::shared_ptr<Texture> createPlaceholder();
+
+    /**
+     * Read the baked version of the image if there is one and the context can sample it, otherwise decode the source.
+     * Safe to call from any thread.
+     */
+    static Image readImage(const std::string& filename);
+
+    /** Decode an image with DevIL. Safe to call from any thread, but DevIL isn't thread safe, so decodes are serialized. */
+    static Image decodeImage(const std::string& filename);
+
+    /** Read and write block compressed images with their mip chains as DDS files */
+    static Image readDDS(const std::string& filename);
+    static void writeDDS(const std::string& filename, const Image& image);
+
+    /** Where texbake puts the baked version of a source image */
+    static std::string getBakedFilename(const std::string& sourceFile);
 private:
-    static GLuint s_nextUnitId;
+    struct BindlessHandle {
+        GLuint m_sampler;
+        GLuint64 m_handle;
+    };
+
+    static std::mutex s_decodeMutex;
 
     GLuint m_id;
-    GLuint m_unitId;
-    GLuint m_samplerId;
+    std::vector<BindlessHandle> m_handles;
+
+    /** Make the handles non-resident and, if there were any, replace the now immutable texture object */
+    void releaseHandles(bool recreate);
 };
 
 #endif
@@ -0,0 +1,186 @@
+#include "textureatlas.hpp"
+#include "blockcompressor.hpp"
+#include "glstate.hpp"
+#include "textureunits.hpp"
+#include <algorithm>
+
+static_assert(sizeof(TextureAtlas::Region) == sizeof(glm::vec4) + sizeof(GLuint), "Region must be tightly packed for the instance attributes");
+
+static GLsizei roundUp(GLsizei value, GLsizei multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+static GLsizei wrap(GLsizei value, GLsizei size) {
+    return ((value % size) + size) % size;
+}
+
+TextureAtlas::TextureAtlas(GLsizei padding)
+    : m_padding(1)
+    , m_layerSize(0)
+    , m_layerCount(0) {
+    while (m_padding < padding) {
+        m_padding *= 2;
+    }
+
+    GLCheck(glGenTextures(1, &m_id));
+}
+
+TextureAtlas::~TextureAtlas() {
+    GLState::forgetTexture(m_id);
+    GLCheck(glDeleteTextures(1, &m_id));
+}
+
+size_t TextureAtlas::add(const std::string& name, const Texture::Image& image) {
+    std::map<std::string, size_t>::const_iterator it = m_names.find(name);
+    if (it != m_names.end())
+        return it->second;
+
+    Entry entry;
+    entry.m_name = name;
+    entry.m_levels.push_back(BlockCompressor::toRGBA(image));
+    while (entry.m_levels.back().m_width > 1 || entry.m_levels.back().m_height > 1) {
+        entry.m_levels.push_back(BlockCompressor::downsample(entry.m_levels.back()));
+    }
+
+    m_names[name] = m_entries.size();
+    m_entries.push_back(entry);
+
+    return m_entries.size() - 1;
+}
+
+int TextureAtlas::find(const std::string& name) const {
+    std::map<std::string, size_t>::const_iterator it = m_names.find(name);
+
+    return (it != m_names.end()) ? (int) it->second : -1;
+}
+
+void TextureAtlas::build() {
+    if (m_entries.empty())
+        return;
+
+    pack();
+
+    size_t levelCount = 1;
+    while ((m_layerSize >> levelCount) > 0) {
+        ++levelCount;
+    }
+
+    GLState::bindTexture(TextureUnits::UPLOAD_UNIT, GL_TEXTURE_2D_ARRAY, m_id);
+    GLState::activeTexture(TextureUnits::UPLOAD_UNIT);
+    GLCheck(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+    std::vector<unsigned char> layers;
+    for (size_t level = 0; level < levelCount; ++level) {
+        GLsizei layerSize = m_layerSize >> level;
+        size_t layerBytes = layerSize * layerSize * 4;
+
+        layers.assign(layerBytes * m_layerCount, 0);
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            writeSlot(m_entries[i], level, &layers[m_entries[i].m_region.m_layer * layerBytes], layerSize);
+        }
+
+        GLCheck(glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, layerSize, layerSize, m_layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, &layers[0]));
+    }
+
+    GLCheck(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0));
+    GLCheck(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1));
+
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        std::vector<Texture::Image::Level>().swap(m_entries[i].m_levels);
+    }
+}
+
+void TextureAtlas::pack() {
+    GLsizei largest = 1;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        largest = std::max(largest, std::max(m_entries[i].m_levels[0].m_width, m_entries[i].m_levels[0].m_height));
+    }
+
+    m_layerSize = 1;
+    while (m_layerSize < largest) {
+        m_layerSize *= 2;
+    }
+
+    std::vector<size_t> order(m_entries.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+
+    // tallest first, so the shelves waste little height
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_entries[a].m_levels[0].m_height > m_entries[b].m_levels[0].m_height;
+    });
+
+    // shelves of padded slots, left to right and then bottom to top, in the current shared layer
+    int sharedLayer = -1;
+    GLsizei shelfX = 0;
+    GLsizei shelfY = 0;
+    GLsizei shelfHeight = 0;
+    m_layerCount = 0;
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        Entry& entry = m_entries[order[i]];
+        GLsizei width = entry.m_levels[0].m_width;
+        GLsizei height = entry.m_levels[0].m_height;
+        GLsizei slotWidth = roundUp(width + 2 * m_padding, m_padding);
+        GLsizei slotHeight = roundUp(height + 2 * m_padding, m_padding);
+
+        if (slotWidth > m_layerSize || slotHeight > m_layerSize) {
+            // too large to pad, the image repeats over a layer of its own
+            entry.m_slotX = 0;
+            entry.m_slotY = 0;
+            entry.m_slotWidth = m_layerSize;
+            entry.m_slotHeight = m_layerSize;
+            entry.m_padding = 0;
+            entry.m_region.m_layer = m_layerCount++;
+        } else {
+            if (sharedLayer >= 0 && shelfX + slotWidth > m_layerSize) {
+                shelfX = 0;
+                shelfY += shelfHeight;
+                shelfHeight = 0;
+            }
+
+            if (sharedLayer < 0 || shelfY + slotHeight > m_layerSize) {
+                sharedLayer = m_layerCount++;
+                shelfX = 0;
+                shelfY = 0;
+                shelfHeight = 0;
+            }
+
+            entry.m_slotX = shelfX;
+            entry.m_slotY = shelfY;
+            entry.m_slotWidth = slotWidth;
+            entry.m_slotHeight = slotHeight;
+            entry.m_padding = m_padding;
+            entry.m_region.m_layer = sharedLayer;
+
+            shelfX += slotWidth;
+            shelfHeight = std::max(shelfHeight, slotHeight);
+        }
+
+        entry.m_region.m_transform = glm::vec4((float) width, (float) height,
+                                               (float) (entry.m_slotX + entry.m_padding), (float) (entry.m_slotY + entry.m_padding)) / (float) m_layerSize;
+    }
+}
+
+void TextureAtlas::writeSlot(const Entry& entry, size_t level, unsigned char* layer, GLsizei layerSize) const {
+    GLsizei x0 = entry.m_slotX >> level;
+    GLsizei y0 = entry.m_slotY >> level;
+    GLsizei x1 = (entry.m_slotX + entry.m_slotWidth) >> level;
+    GLsizei y1 = (entry.m_slotY + entry.m_slotHeight) >> level;
+    GLsizei originX = (entry.m_slotX + entry.m_padding) >> level;
+    GLsizei originY = (entry.m_slotY + entry.m_padding) >> level;
+
+    // an image smaller than the layer runs out of levels before the layer does
+    const Texture::Image::Level& image = entry.m_levels[std::min(level, entry.m_levels.size() - 1)];
+
+    // the padding repeats the image, so repeating textures stay seamless where the shader wraps
+    for (GLsizei y = y0; y < y1; ++y) {
+        GLsizei sourceY = wrap(y - originY, image.m_height);
+        for (GLsizei x = x0; x < x1; ++x) {
+            GLsizei sourceX = wrap(x - originX, image.m_width);
+            const unsigned char* source = &image.m_data[(sourceY * image.m_width + sourceX) * 4];
+            std::copy(source, source + 4, layer + (y * layerSize + x) * 4);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef TEXTUREATLAS_HPP
+#define TEXTUREATLAS_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "texture.hpp"
+
+/**
+ * Packs images into the layers of one GL_TEXTURE_2D_ARRAY, so objects with different textures can be
+ * drawn by the same call. Images as large as a layer get a layer of their own; smaller ones are packed
+ * onto shelves of shared layers, surrounded by padding that repeats the image, so bilinear filtering and
+ * the first few mip levels never read a neighbour. Every region gets its own mip chain, filtered like
+ * BlockCompressor's, and a transform that maps the object's texture coordinates into it.
+ */
+class TextureAtlas {
+public:
+    /** Where an image ended up. Layout matches VertexFormat::setupInstanceTextureRegion. */
+    struct Region {
+        glm::vec4 m_transform;      // uv * xy + zw, with uv wrapped into [0, 1) first
+        GLuint m_layer;
+    };
+
+    /** The padding, in texels, is rounded up to a power of two; mip level log2(padding) is the last with a border */
+    explicit TextureAtlas(GLsizei padding = 8);
+    ~TextureAtlas();
+
+    /** Queue an uncompressed image under a name and return its region index. Adding a name twice returns the first. */
+    size_t add(const std::string& name, const Texture::Image& image);
+
+    /** The region index of a name, or -1 */
+    int find(const std::string& name) const;
+
+    /** Pack the queued images, upload the layers and their mip chains and release the images */
+    void build();
+
+    GLuint getId() const { return m_id; }
+    const Region& getRegion(size_t index) const { return m_entries[index].m_region; }
+    size_t getRegionCount() const { return m_entries.size(); }
+    GLsizei getLayerSize() const { return m_layerSize; }
+    GLsizei getLayerCount() const { return m_layerCount; }
+private:
+    struct Entry {
+        std::string m_name;
+        std::vector<Texture::Image::Level> m_levels;    // RGBA, the image and its mip chain
+        GLsizei m_slotX;            // The image and its padding, in texels of the first level
+        GLsizei m_slotY;
+        GLsizei m_slotWidth;
+        GLsizei m_slotHeight;
+        GLsizei m_padding;
+        Region m_region;
+    };
+
+    GLuint m_id;
+    GLsizei m_padding;
+    GLsizei m_layerSize;
+    GLsizei m_layerCount;
+    std::vector<Entry> m_entries;
+    std::map<std::string, size_t> m_names;
+
+    /** Assign every entry a layer and slot */
+    void pack();
+
+    /** Write the slot of the entry at a mip level into a layer of that level */
+    void writeSlot(const Entry& entry, size_t level, unsigned char* layer, GLsizei layerSize) const;
+
+    TextureAtlas(const TextureAtlas&);
+    TextureAtlas& operator=(const TextureAtlas&);
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "textureloader.hpp"
+#include "glstate.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+TextureLoader::TextureLoader(ThreadPool& pool, double budgetMs)
+    : m_pool(pool)
+    , m_budgetMs(budgetMs) {}
+
+std::shared_ptr<Texture> TextureLoader::load(const std::string& filename) {
+    std::shared_ptr<Texture> texture = Texture::createPlaceholder();
+
+    Pending pending;
+    pending.m_filename = filename;
+    pending.m_texture = texture;
+    pending.m_image = m_pool.submit([filename]() { return Texture::readImage(filename); });
+    m_pending.push_back(std::move(pending));
+
+    return texture;
+}
+
+void TextureLoader::update() {
+    m_stats.m_uploaded = 0;
+    m_stats.m_uploadMs = 0.0;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < m_pending.size(); ) {
+        if (m_stats.m_uploaded > 0 && std::chrono::duration<double, std::milli>(Clock::now() - start).count() > m_budgetMs)
+            break;
+
+        Pending& pending = m_pending[i];
+        if (pending.m_image.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++i;
+            continue;
+        }
+
+        if (upload(pending)) {
+            ++m_stats.m_uploaded;
+        } else {
+            ++m_stats.m_failed;
+        }
+
+        m_pending.erase(m_pending.begin() + i);
+    }
+
+    m_stats.m_uploadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    m_stats.m_pending = m_pending.size();
+}
+
+void TextureLoader::finish() {
+    for (size_t i = 0; i < m_pending.size(); ++i) {
+        if (upload(m_pending[i])) {
+            ++m_stats.m_uploaded;
+        } else {
+            ++m_stats.m_failed;
+        }
+    }
+
+    m_pending.clear();
+    m_stats.m_pending = 0;
+}
+
+bool TextureLoader::upload(Pending& pending) {
+    Texture::Image image;
+    try {
+        image = pending.m_image.get();
+    } catch (std::exception& e) {
+        // keep the placeholder rather than taking the frame down
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return false;
+    }
+
+    size_t size = image.getSize();
+
+    // orphan the buffer, so a transfer still reading the previous image doesn't have to finish first
+    glBindBufferState bufferState(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffer.getId());
+    GLCheck(glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW));
+
+    void* destination = GLCheck(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (destination != NULL) {
+        // the levels go back to back, which is where Texture::upload expects them
+        unsigned char* levelDestination = (unsigned char*) destination;
+        for (size_t i = 0; i < image.m_levels.size(); ++i) {
+            memcpy(levelDestination, &image.m_levels[i].m_data[0], image.m_levels[i].m_data.size());
+            levelDestination += image.m_levels[i].m_data.size();
+        }
+        GLCheck(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+
+        // the texture reads from the bound pixel buffer, so the image calls return without waiting for the copy
+        pending.m_texture->upload(image, true);
+    } else {
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pending.m_texture->upload(image);
+    }
+
+    // other uploads pass client pointers, which a bound pixel buffer would turn into offsets
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef TEXTURELOADER_HPP
+#define TEXTURELOADER_HPP
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <future>
+#include <GL/glew.h>
+#include "buffer.hpp"
+#include "texture.hpp"
+#include "threadpool.hpp"
+
+/**
+ * Loads textures without blocking the GL thread. Images are decoded on a thread pool while the
+ * returned texture holds a placeholder texel; update, called once per frame on the GL thread,
+ * copies finished images into pixel buffers and uploads them from there, within a time budget.
+ */
+class TextureLoader {
+public:
+    struct Stats {
+        size_t m_pending;       // Still decoding or waiting for upload
+        size_t m_uploaded;      // Since the last update
+        size_t m_failed;
+        double m_uploadMs;      // Spent uploading in the last update
+
+        Stats() : m_pending(0), m_uploaded(0), m_failed(0), m_uploadMs(0.0) {}
+    };
+
+    /** Uploads continue past the budget only to guarantee one upload per update */
+    explicit TextureLoader(ThreadPool& pool, double budgetMs = 2.0);
+
+    /** Start decoding and return the texture, which shows a placeholder until the image has been uploaded */
+    std::shared_ptr<Texture> load(const std::string& filename);
+
+    /** Upload the images that have finished decoding, until the budget runs out */
+    void update();
+
+    /** Block until everything queued has been uploaded */
+    void finish();
+
+    size_t getPendingCount() const { return m_pending.size(); }
+    const Stats& getStats() const { return m_stats; }
+private:
+    struct Pending {
+        std::string m_filename;
+        std::shared_ptr<Texture> m_texture;
+        std::future<Texture::Image> m_image;
+    };
+
+    ThreadPool& m_pool;
+    double m_budgetMs;
+    std::vector<Pending> m_pending;
+    VBO m_pixelBuffer;
+    Stats m_stats;
+
+    /** Upload through the pixel buffer, returning false if decoding failed */
+    bool upload(Pending& pending);
+};
+
+#endif
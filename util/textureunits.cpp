@@ -0,0 +1,23 @@
+#include "textureunits.hpp"
+#include <algorithm>
+#include <sstream>
+#include <r2tk/r2-exception.hpp>
+
+TextureUnits::TextureUnits(GLuint limit)
+    : m_next(0) {
+    GLint maxUnits = 0;
+    GLCheck(glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxUnits));
+
+    m_maxUnits = std::min(std::min((GLuint) maxUnits, limit), UPLOAD_UNIT);
+}
+
+GLuint TextureUnits::allocate() {
+    if (m_next >= m_maxUnits) {
+        std::stringstream ss;
+        ss << "Out of texture units, a draw can sample at most " << m_maxUnits << " textures below the fixed units";
+
+        throw r2ExceptionRuntimeM(ss.str());
+    }
+
+    return m_next++;
+}
@@ -0,0 +1,36 @@
+#ifndef TEXTUREUNITS_HPP
+#define TEXTUREUNITS_HPP
+
+#include <GL/glew.h>
+#include "glstate.hpp"
+
+/**
+ * Hands out texture units to the samplers of one draw or material, starting over at unit 0 for the next,
+ * so the units in use are bounded by what a single draw samples rather than by the number of textures.
+ * The textures themselves are bound to their units by whoever issues the draw.
+ */
+class TextureUnits {
+public:
+    /** Bound by Texture while it uploads, never handed out, so uploads don't disturb the units of a draw */
+    static const GLuint UPLOAD_UNIT = GLState::MAX_TEXTURE_UNITS - 1;
+
+    /**
+     * Needs a context, to query the number of units. Only units below the limit are handed out,
+     * those from it up are left to textures bound to fixed units.
+     */
+    explicit TextureUnits(GLuint limit = UPLOAD_UNIT);
+
+    /** The next free unit. Throws if the draw samples more textures than there are units below the limit. */
+    GLuint allocate();
+
+    /** Start handing out units from 0 again, for the next draw or material */
+    void reset() { m_next = 0; }
+
+    GLuint getCount() const { return m_next; }
+    GLuint getMaxUnits() const { return m_maxUnits; }
+private:
+    GLuint m_next;
+    GLuint m_maxUnits;
+};
+
+#endif
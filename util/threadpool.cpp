@@ -0,0 +1,54 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : m_stopping(false) {
+    if (threadCount == 0) {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = std::max(hardwareThreads, 2u) - 1;
+    }
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        m_threads.push_back(std::thread(&ThreadPool::run, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); ++i) {
+        m_threads[i].join();
+    }
+}
+
+void ThreadPool::enqueue(const std::function<void()>& task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push(task);
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::run() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stopping && m_tasks.empty()) {
+                m_condition.wait(lock);
+            }
+
+            if (m_tasks.empty())
+                return;
+
+            task = m_tasks.front();
+            m_tasks.pop();
+        }
+
+        task();
+    }
+}
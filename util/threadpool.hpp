@@ -0,0 +1,54 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <queue>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <type_traits>
+
+/** A fixed set of worker threads running submitted tasks in order. Tasks must not touch GL. */
+class ThreadPool {
+public:
+    /** Zero threads means one less than the hardware supports, but at least one */
+    explicit ThreadPool(size_t threadCount = 0);
+
+    /** Finishes the queued tasks before returning */
+    ~ThreadPool();
+
+    /** Queue a task. The future returns its result, or rethrows what it threw. */
+    template <class Function>
+    std::future<typename std::result_of<Function()>::type> submit(Function function);
+
+    size_t getThreadCount() const { return m_threads.size(); }
+private:
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()> > m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping;
+
+    void enqueue(const std::function<void()>& task);
+    void run();
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+template <class Function>
+std::future<typename std::result_of<Function()>::type> ThreadPool::submit(Function function) {
+    typedef typename std::result_of<Function()>::type Result;
+
+    // std::function needs a copyable target, so the task is shared
+    std::shared_ptr<std::packaged_task<Result()> > task(new std::packaged_task<Result()>(function));
+    std::future<Result> future = task->get_future();
+    enqueue([task]() { (*task)(); });
+
+    return future;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#include "uniformring.hpp"
+#include <cstring>
+
+UniformRing::UniformRing(StreamBuffer& stream)
+    : m_stream(stream)
+    , m_buffer(0)
+    , m_base(0) {
+    GLint alignment;
+    GLCheck(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+    m_alignment = (alignment > 0) ? alignment : 256;
+}
+
+size_t UniformRing::push(const void* data, size_t size) {
+    size_t offset = align(m_staging.size());
+    m_staging.resize(offset + size);
+    memcpy(&m_staging[offset], data, size);
+
+    return offset;
+}
+
+void UniformRing::flush() {
+    if (m_staging.empty())
+        return;
+
+    StreamBuffer::Allocation allocation = m_stream.allocate(m_staging.size(), m_alignment);
+    memcpy(allocation.m_data, &m_staging[0], m_staging.size());
+    m_stream.flush();
+
+    m_buffer = allocation.m_buffer;
+    m_base = allocation.m_offset;
+    m_staging.clear();
+}
+
+void UniformRing::bind(GLuint bindingPoint, size_t offset, size_t size) const {
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, m_buffer, m_base + offset, size);
+}
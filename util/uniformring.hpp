@@ -0,0 +1,42 @@
+#ifndef UNIFORMRING_HPP
+#define UNIFORMRING_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include "buffer.hpp"
+#include "streambuffer.hpp"
+
+/**
+ * Per-object uniform blocks, staged on the CPU with push and copied together into this frame's
+ * region of a stream buffer with flush, after which each one is bound to its binding point by offset.
+ */
+class UniformRing {
+public:
+    explicit UniformRing(StreamBuffer& stream);
+
+    /** Stage a block and return its offset within this batch, aligned for glBindBufferRange */
+    size_t push(const void* data, size_t size);
+
+    template <class T>
+    size_t push(const T& block) { return push(&block, sizeof(T)); }
+
+    /** Copy everything staged since the last flush to the stream buffer and flush it */
+    void flush();
+
+    /** Bind a block pushed before the last flush to a uniform block binding point */
+    void bind(GLuint bindingPoint, size_t offset, size_t size) const;
+private:
+    StreamBuffer& m_stream;
+    size_t m_alignment;     // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+    GLuint m_buffer;        // Where the last batch was copied to
+    size_t m_base;
+    std::vector<unsigned char> m_staging;
+
+    size_t align(size_t offset) const { return (offset + m_alignment - 1) / m_alignment * m_alignment; }
+
+    UniformRing(const UniformRing&);
+    UniformRing& operator=(const UniformRing&);
+};
+
+#endif
@@ -8,13 +8,34 @@
 #include <GL/glfw.h>
 #include <IL/il.h>
 
+#include "blockcompressor.hpp"
+#include "bounds.hpp"
 #include "buffer.hpp"
+#include "bvh.hpp"
 #include "camera.hpp"
+#include "glstate.hpp"
+#include "culling.hpp"
+#include "debugdraw.hpp"
+#include "gldebug.hpp"
+#include "glextensions.hpp"
+#include "lightgrid.hpp"
 #include "material.hpp"
+#include "meshpool.hpp"
 #include "mesh.hpp"
+#include "multidraw.hpp"
+#include "programcache.hpp"
+#include "renderqueue.hpp"
+#include "samplercache.hpp"
 #include "shader.hpp"
+#include "streambuffer.hpp"
 #include "template.hpp"
 #include "texture.hpp"
+#include "textureatlas.hpp"
+#include "textureloader.hpp"
+#include "textureunits.hpp"
+#include "threadpool.hpp"
+#include "uniformring.hpp"
 #include "utility.hpp"
+#include "vertexformat.hpp"
 
 #endif
\ No newline at end of file
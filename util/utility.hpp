@@ -2,19 +2,33 @@
 #define UTILITY_HPP
 
 #include <iostream>
+#include "gldebug.hpp"
 
 // Log an OpenGL error
 #define logError(code, line) \
     if (code != GL_NO_ERROR) \
         std::cerr << "ERROR (" << __FILE__ << ":" << line << "): " << gluErrorString(code) << std::endl; \
 
-// Check for errors in debug mode
-#define GLCheck(F) F; { int line = __LINE__; \
+// Record where each GL call is made from, for the debug callback and the call counter
+#if defined(UTIL_GL_DEBUG) || defined(UTIL_GL_CHECK)
+#define GLMark() GLDebug::markCall(__FILE__, __LINE__)
+#elif defined(UTIL_GL_PROFILE)
+#define GLMark() GLDebug::countCall()
+#endif
+
+// Wrap every GL call. Only UTIL_GL_CHECK calls glGetError, which synchronizes with the driver; without any option this is the bare call.
+#if defined(UTIL_GL_CHECK)
+#define GLCheck(F) (GLMark(), F); { int line = __LINE__; \
         int error = glGetError(); \
         if (error != GL_NO_ERROR) { \
             logError(error, line); \
         } \
     }
+#elif defined(GLMark)
+#define GLCheck(F) (GLMark(), F)
+#else
+#define GLCheck(F) F
+#endif
 
 
 #endif
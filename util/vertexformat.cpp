@@ -0,0 +1,148 @@
+#include "vertexformat.hpp"
+#include "utility.hpp"
+#include <cstring>
+#include <cmath>
+#include <r2tk/r2-exception.hpp>
+
+/** Pack a vector into a signed normalized 2_10_10_10 integer, leaving w at 0 */
+static GLuint packSnorm3x10(const glm::vec3& v) {
+    glm::vec3 clamped = glm::clamp(v, -1.0f, 1.0f);
+    GLuint packed = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        GLint value = (GLint) floor(clamped[i] * 511.0f + 0.5f);
+        packed |= ((GLuint) value & 0x3FF) << (i * 10);
+    }
+
+    return packed;
+}
+
+static GLsizei getAttributeSize(GLint components, GLenum type) {
+    switch (type) {
+    case GL_FLOAT:
+        return components * sizeof(GLfloat);
+    case GL_HALF_FLOAT:
+        return components * sizeof(GLhalf);
+    case GL_INT_2_10_10_10_REV:
+        return sizeof(GLuint);
+    default:
+        throw r2ExceptionArgumentM("Unsupported vertex attribute type");
+    }
+}
+
+/** Write the first components of value as the given attribute type */
+static void writeAttribute(unsigned char* destination, const VertexFormat::Attribute& attribute, const glm::vec4& value) {
+    switch (attribute.m_type) {
+    case GL_FLOAT:
+        memcpy(destination, &value[0], attribute.m_components * sizeof(GLfloat));
+        break;
+    case GL_HALF_FLOAT:
+        for (int i = 0; i < attribute.m_components; i += 2) {
+            GLuint packed = glm::packHalf2x16(glm::vec2(value[i], value[i + 1]));
+            memcpy(destination + i * sizeof(GLhalf), &packed, glm::min(attribute.m_components - i, 2) * sizeof(GLhalf));
+        }
+        break;
+    case GL_INT_2_10_10_10_REV: {
+        GLuint packed = packSnorm3x10(glm::vec3(value));
+        memcpy(destination, &packed, sizeof(packed));
+        break;
+    }
+    }
+}
+
+
+VertexFormat::VertexFormat()
+    : m_stride(0) {}
+
+void VertexFormat::addAttribute(Semantic semantic, GLint components, GLenum type, GLboolean normalized) {
+    Attribute attribute;
+    attribute.m_semantic = semantic;
+    attribute.m_components = components;
+    attribute.m_type = type;
+    attribute.m_normalized = normalized;
+    attribute.m_offset = m_stride;
+
+    m_stride += getAttributeSize(components, type);
+    m_attributes.push_back(attribute);
+}
+
+void VertexFormat::setupAttributes() const {
+    for (size_t i = 0; i < m_attributes.size(); ++i) {
+        const Attribute& attribute = m_attributes[i];
+
+        GLCheck(glEnableVertexAttribArray(attribute.m_semantic));
+        GLCheck(glVertexAttribPointer(attribute.m_semantic,
+                                      attribute.m_components,
+                                      attribute.m_type,
+                                      attribute.m_normalized,
+                                      m_stride,
+                                      (const GLvoid*) (size_t) attribute.m_offset));
+    }
+}
+
+void VertexFormat::setupInstanceMatrix(size_t offset) {
+    for (GLuint column = 0; column < 4; ++column) {
+        GLCheck(glEnableVertexAttribArray(INSTANCE_MATRIX + column));
+        GLCheck(glVertexAttribPointer(INSTANCE_MATRIX + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                      (const GLvoid*) (offset + column * sizeof(glm::vec4))));
+        GLCheck(glVertexAttribDivisor(INSTANCE_MATRIX + column, 1));
+    }
+}
+
+void VertexFormat::setupInstanceTextureRegion(size_t offset) {
+    GLsizei stride = sizeof(glm::vec4) + sizeof(GLuint);
+
+    GLCheck(glEnableVertexAttribArray(INSTANCE_TEXTURE_TRANSFORM));
+    GLCheck(glVertexAttribPointer(INSTANCE_TEXTURE_TRANSFORM, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*) offset));
+    GLCheck(glVertexAttribDivisor(INSTANCE_TEXTURE_TRANSFORM, 1));
+
+    GLCheck(glEnableVertexAttribArray(INSTANCE_TEXTURE_LAYER));
+    GLCheck(glVertexAttribIPointer(INSTANCE_TEXTURE_LAYER, 1, GL_UNSIGNED_INT, stride, (const GLvoid*) (offset + sizeof(glm::vec4))));
+    GLCheck(glVertexAttribDivisor(INSTANCE_TEXTURE_LAYER, 1));
+}
+
+void VertexFormat::writeVertex(unsigned char* destination, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoord) const {
+    for (size_t i = 0; i < m_attributes.size(); ++i) {
+        const Attribute& attribute = m_attributes[i];
+
+        glm::vec4 value;
+        switch (attribute.m_semantic) {
+        case POSITION:
+            value = glm::vec4(position, 1.0f);
+            break;
+        case NORMAL:
+            value = glm::vec4(normal, 0.0f);
+            break;
+        case TEXCOORD:
+            value = glm::vec4(texCoord, 0.0f, 0.0f);
+            break;
+        }
+
+        writeAttribute(destination + attribute.m_offset, attribute, value);
+    }
+}
+
+bool VertexFormat::operator==(const VertexFormat& other) const {
+    if (m_stride != other.m_stride || m_attributes.size() != other.m_attributes.size())
+        return false;
+
+    for (size_t i = 0; i < m_attributes.size(); ++i) {
+        const Attribute& a = m_attributes[i];
+        const Attribute& b = other.m_attributes[i];
+
+        if (a.m_semantic != b.m_semantic || a.m_components != b.m_components || a.m_type != b.m_type ||
+            a.m_normalized != b.m_normalized || a.m_offset != b.m_offset)
+            return false;
+    }
+
+    return true;
+}
+
+VertexFormat VertexFormat::createCompact(bool halfTexCoords) {
+    VertexFormat format;
+    format.addAttribute(POSITION, 3, GL_FLOAT, GL_FALSE);
+    format.addAttribute(NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE);
+    format.addAttribute(TEXCOORD, 2, halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE);
+
+    return format;
+}
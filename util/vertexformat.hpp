@@ -0,0 +1,66 @@
+#ifndef VERTEXFORMAT_HPP
+#define VERTEXFORMAT_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/** Describes the layout of a single interleaved vertex buffer. Shared by all mesh loaders. */
+class VertexFormat {
+public:
+    /** The semantic of an attribute, which is also its shader input location */
+    enum Semantic {
+        POSITION = 0,
+        NORMAL = 1,
+        TEXCOORD = 2
+    };
+
+    /** The first of the four locations of a per-instance model matrix, after the vertex attributes */
+    static const GLuint INSTANCE_MATRIX = TEXCOORD + 1;
+
+    /** The locations of a per-instance texture region, a vec4 transform and a uint layer, after the model matrix */
+    static const GLuint INSTANCE_TEXTURE_TRANSFORM = INSTANCE_MATRIX + 4;
+    static const GLuint INSTANCE_TEXTURE_LAYER = INSTANCE_TEXTURE_TRANSFORM + 1;
+
+    struct Attribute {
+        Semantic m_semantic;
+        GLint m_components;
+        GLenum m_type;          // GL_FLOAT, GL_HALF_FLOAT or GL_INT_2_10_10_10_REV
+        GLboolean m_normalized;
+        GLsizei m_offset;
+    };
+
+    VertexFormat();
+
+    /** Append an attribute to the end of the vertex */
+    void addAttribute(Semantic semantic, GLint components, GLenum type, GLboolean normalized);
+
+    /** Enable and set up the attributes for the buffer currently bound to GL_ARRAY_BUFFER */
+    void setupAttributes() const;
+
+    /** Enable and set up a tightly packed mat4 per instance, at INSTANCE_MATRIX, for the buffer bound to GL_ARRAY_BUFFER */
+    static void setupInstanceMatrix(size_t offset = 0);
+
+    /** Enable and set up tightly packed TextureAtlas::Regions per instance, for the buffer bound to GL_ARRAY_BUFFER */
+    static void setupInstanceTextureRegion(size_t offset = 0);
+
+    /** Encode one vertex into destination, which must have room for getStride() bytes */
+    void writeVertex(unsigned char* destination, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoord) const;
+
+    const std::vector<Attribute>& getAttributes() const { return m_attributes; }
+    GLsizei getStride() const { return m_stride; }
+
+    bool operator==(const VertexFormat& other) const;
+    bool operator!=(const VertexFormat& other) const { return !(*this == other); }
+
+    /**
+     * Float3 position, GL_INT_2_10_10_10_REV normal and a float2 or half2 texture coordinate,
+     * for a total of 24 or 20 bytes per vertex.
+     */
+    static VertexFormat createCompact(bool halfTexCoords = false);
+private:
+    std::vector<Attribute> m_attributes;
+    GLsizei m_stride;
+};
+
+#endif